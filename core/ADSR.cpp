@@ -129,7 +129,129 @@ void ADSR::setTargetRatioDR(float targetRatio) {
 }
 
 float *ADSR::processBuffer(int numOfSamples) {
-	for(int n=0; n<numOfSamples; n++)
-		buffer[n] = process();
+	renderSegments<false>(buffer, numOfSamples);
 	return buffer;
 }
+
+void ADSR::processBuffer(double *dest, int numOfSamples) {
+	renderSegments<false>(dest, numOfSamples);
+}
+
+void ADSR::applyBuffer(double *inout, int numOfSamples) {
+	renderSegments<true>(inout, numOfSamples);
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// the recursion output = base + output*coef has closed form output[n] = target + (output[0]-target)*coef^n, with target = base/(1-coef)
+// so we know in advance how many samples it takes to cross the threshold that ends the segment
+// returns the number of steps up to and including the one that crosses it, as process() would go
+int ADSR::getSegmentLength(double base, double coef, double threshold) {
+	if(coef <= 0)
+		return 1; // null rate, straight to threshold
+	if(coef >= 1)
+		return 0x7FFFFFFF; // never gets there
+
+	double target = base/(1-coef);
+	double ratio = (threshold-target)/(output-target);
+	if(ratio <= 0 || ratio >= 1) // already past threshold, or moving away from it
+		return 1;
+
+	double steps = ceil( log(ratio) / log(coef) );
+	if(steps < 1)
+		return 1;
+	if(steps > 0x7FFFFFFF)
+		return 0x7FFFFFFF;
+	return (int)steps;
+}
+
+template<bool apply, typename T>
+static inline void put(T *dest, double value) {
+	if(apply)
+		*dest *= value;
+	else
+		*dest = value;
+}
+
+// same as calling process() numOfSamples times, but one segment at a time
+// each segment is written by a loop with no branches nor dependencies between samples
+template<bool apply, typename T>
+void ADSR::renderSegments(T *dest, int numOfSamples) {
+	int n = 0;
+	while(n < numOfSamples) {
+		int remaining = numOfSamples-n;
+
+		// flat segments
+		if(state == env_idle || state == env_sustain) {
+			double value = output;
+			for(int i=0; i<remaining; i++)
+				put<apply>(dest+n+i, value);
+			return;
+		}
+
+		double base, coef, threshold;
+		env_state next;
+		if(state == env_attack) {
+			base = attackBase;
+			coef = attackCoef;
+			threshold = 1.0;
+			next = env_decay;
+		}
+		else if(state == env_decay) {
+			base = decayBase;
+			coef = decayCoef;
+			threshold = sustainLevel;
+			next = env_sustain;
+		}
+		else {
+			base = releaseBase;
+			coef = releaseCoef;
+			threshold = 0.0;
+			next = env_idle;
+		}
+
+		int len = getSegmentLength(base, coef, threshold);
+		bool ends = (len <= remaining);
+		int curveLen = ends ? len-1 : remaining; // last step of the segment is clamped to threshold
+
+		// closed form, 4 samples at a time with independent powers of coef
+		double target = base/(1-coef);
+		double coefPow[4];
+		coefPow[0] = coef;
+		for(int j=1; j<4; j++)
+			coefPow[j] = coefPow[j-1]*coef;
+		double diff = output-target;
+
+		// attack goes up, decay and release go down
+		// clamping covers rounding differences between closed form and log based segment length
+		bool up = (state == env_attack);
+		int i = 0;
+		for(; i+4<=curveLen; i+=4) {
+			for(int j=0; j<4; j++) {
+				double value = target + diff*coefPow[j];
+				put<apply>(dest+n+i+j, up ? fmin(value, threshold) : fmax(value, threshold));
+			}
+			diff *= coefPow[3];
+		}
+		for(int j=0; i<curveLen; i++, j++) {
+			double value = target + diff*coefPow[j];
+			put<apply>(dest+n+i, up ? fmin(value, threshold) : fmax(value, threshold));
+		}
+
+		if(curveLen > 0) {
+			double value = target + (output-target)*pow(coef, curveLen);
+			output = up ? fmin(value, threshold) : fmax(value, threshold);
+		}
+		n += curveLen;
+
+		if(ends) {
+			output = threshold;
+			state = next;
+			put<apply>(dest+n, threshold);
+			n++;
+		}
+	}
+}
+
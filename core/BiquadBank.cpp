@@ -0,0 +1,289 @@
+/*
+ * BiquadBank.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: same transposed direct form II sections as Biquad, laid out as structure of arrays
+ *                so that several sections run in parallel SIMD lanes [AVX, SSE2 or NEON, scalar fallback]
+ */
+
+#include "BiquadBank.h"
+
+#include <stdlib.h> // posix_memalign
+#include <stdio.h>
+#include <cstring>  // memset
+
+//----------------------------------------------------------------------------------
+// tiny SIMD layer, widest instruction set enabled at compile time wins
+//----------------------------------------------------------------------------------
+#if defined(__AVX__)
+#include <immintrin.h>
+#define BQ_WIDTH 4
+typedef __m256d bq_vec;
+#define bq_load(p)     _mm256_loadu_pd(p)
+#define bq_store(p, v) _mm256_storeu_pd(p, v)
+#define bq_add(a, b)   _mm256_add_pd(a, b)
+#define bq_sub(a, b)   _mm256_sub_pd(a, b)
+#define bq_mul(a, b)   _mm256_mul_pd(a, b)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BQ_WIDTH 2
+typedef __m128d bq_vec;
+#define bq_load(p)     _mm_loadu_pd(p)
+#define bq_store(p, v) _mm_storeu_pd(p, v)
+#define bq_add(a, b)   _mm_add_pd(a, b)
+#define bq_sub(a, b)   _mm_sub_pd(a, b)
+#define bq_mul(a, b)   _mm_mul_pd(a, b)
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BQ_WIDTH 2
+typedef float64x2_t bq_vec;
+#define bq_load(p)     vld1q_f64(p)
+#define bq_store(p, v) vst1q_f64(p, v)
+#define bq_add(a, b)   vaddq_f64(a, b)
+#define bq_sub(a, b)   vsubq_f64(a, b)
+#define bq_mul(a, b)   vmulq_f64(a, b)
+#else
+#define BQ_WIDTH 1
+typedef double bq_vec;
+#define bq_load(p)     (*(p))
+#define bq_store(p, v) (*(p) = (v))
+#define bq_add(a, b)   ((a)+(b))
+#define bq_sub(a, b)   ((a)-(b))
+#define bq_mul(a, b)   ((a)*(b))
+#endif
+
+// BQ_WIDTH lanes of Biquad::process(), reading in[] and writing out[] [which may overlap, all loads come first]
+static inline void sectionsStep(const double *in, double *out, const double *a0, const double *a1, const double *a2,
+								const double *b1, const double *b2, double *z1, double *z2) {
+	bq_vec x = bq_load(in);
+	bq_vec y = bq_add(bq_mul(x, bq_load(a0)), bq_load(z1));
+	bq_store(z1, bq_sub(bq_add(bq_mul(x, bq_load(a1)), bq_load(z2)), bq_mul(bq_load(b1), y)));
+	bq_store(z2, bq_sub(bq_mul(x, bq_load(a2)), bq_mul(bq_load(b2), y)));
+	bq_store(out, y);
+}
+
+// single lane version, for ramps and leftovers
+static inline void sectionStep(const double *in, double *out, const double *a0, const double *a1, const double *a2,
+							   const double *b1, const double *b2, double *z1, double *z2) {
+	double x = *in;
+	double y = x * *a0 + *z1;
+	*z1 = x * *a1 + *z2 - *b1 * y;
+	*z2 = x * *a2 - *b2 * y;
+	*out = y;
+}
+
+static double *allocateLanes(size_t num) {
+	void *ptr = NULL;
+	if(posix_memalign(&ptr, 32, num*sizeof(double)) != 0)
+		return NULL;
+	memset(ptr, 0, num*sizeof(double));
+	return (double *)ptr;
+}
+
+static int padToWidth(int num) {
+	return ((num+BQ_WIDTH-1)/BQ_WIDTH)*BQ_WIDTH;
+}
+
+
+
+BiquadBank::BiquadBank() {
+	channels = 0;
+	sections = 0;
+	maxNumOfSamples = 0;
+	paddedChannels = 0;
+	paddedSections = 0;
+	a0 = a1 = a2 = b1 = b2 = NULL;
+	z1 = z2 = NULL;
+	interleaved = NULL;
+	for(int i=0; i<5; i++)
+		cascCoefs[i] = NULL;
+	cascZ1 = cascZ2 = NULL;
+	pipe = NULL;
+}
+
+BiquadBank::~BiquadBank() {
+	deallocate();
+}
+
+int BiquadBank::init(unsigned short channels, unsigned short sections, unsigned int maxNumOfSamples) {
+	deallocate();
+
+	if(maxNumOfSamples == 0) {
+		printf("BiquadBank error! Max number of samples must be at least 1\n");
+		this->channels = 0;
+		this->sections = 0;
+		this->maxNumOfSamples = 0; // process() and processCascade() do nothing
+		return -1;
+	}
+
+	this->channels = channels;
+	this->sections = sections;
+	this->maxNumOfSamples = maxNumOfSamples;
+	paddedChannels = padToWidth(channels);
+	paddedSections = padToWidth(sections);
+
+	int lanes = sections*paddedChannels;
+	a0 = allocateLanes(lanes);
+	a1 = allocateLanes(lanes);
+	a2 = allocateLanes(lanes);
+	b1 = allocateLanes(lanes);
+	b2 = allocateLanes(lanes);
+	z1 = allocateLanes(lanes);
+	z2 = allocateLanes(lanes);
+
+	interleaved = allocateLanes(maxNumOfSamples*paddedChannels);
+
+	for(int i=0; i<5; i++)
+		cascCoefs[i] = allocateLanes(paddedSections);
+	cascZ1 = allocateLanes(paddedSections);
+	cascZ2 = allocateLanes(paddedSections);
+	pipe = allocateLanes(paddedSections+1);
+
+	// all sections start as pass through, like a default Biquad
+	for(int s=0; s<sections; s++) {
+		for(int c=0; c<channels; c++)
+			a0[s*paddedChannels+c] = 1.0;
+	}
+
+	return 0;
+}
+
+void BiquadBank::setBiquad(unsigned short channel, unsigned short section, int type, double Fc, double Q, double peakGainDB) {
+	if(channel>=channels || section>=sections) {
+		printf("BiquadBank has no section %d on channel %d!\n", section, channel);
+		return;
+	}
+
+	double coefs[5];
+	Biquad bq(type, Fc, Q, peakGainDB); // same exact formulas
+	bq.getCoefficients(coefs);
+
+	int k = section*paddedChannels + channel;
+	a0[k] = coefs[0];
+	a1[k] = coefs[1];
+	a2[k] = coefs[2];
+	b1[k] = coefs[3];
+	b2[k] = coefs[4];
+}
+
+void BiquadBank::setBiquad(unsigned short section, int type, double Fc, double Q, double peakGainDB) {
+	for(unsigned short c=0; c<channels; c++)
+		setBiquad(c, section, type, Fc, Q, peakGainDB);
+}
+
+void BiquadBank::reset() {
+	memset(z1, 0, sections*paddedChannels*sizeof(double));
+	memset(z2, 0, sections*paddedChannels*sizeof(double));
+}
+
+void BiquadBank::process(double **inout, int numOfSamples) {
+	if(maxNumOfSamples == 0)
+		return; // not inited
+	// longer buffers are split in chunks that fit in the interleaved work area
+	for(int start=0; start<numOfSamples; start+=maxNumOfSamples) {
+		int len = numOfSamples-start;
+		if(len > (int)maxNumOfSamples)
+			len = maxNumOfSamples;
+
+		// channels side by side, padded lanes are left at zero
+		for(int c=0; c<channels; c++) {
+			for(int n=0; n<len; n++)
+				interleaved[n*paddedChannels+c] = inout[c][start+n];
+		}
+
+		// each section on all channels at once, state is only touched through the lanes
+		for(int s=0; s<sections; s++) {
+			for(int c=0; c<paddedChannels; c+=BQ_WIDTH) {
+				int k = s*paddedChannels+c;
+				for(int n=0; n<len; n++) {
+					double *x = interleaved+n*paddedChannels+c;
+					sectionsStep(x, x, a0+k, a1+k, a2+k, b1+k, b2+k, z1+k, z2+k);
+				}
+			}
+		}
+
+		for(int c=0; c<channels; c++) {
+			for(int n=0; n<len; n++)
+				inout[c][start+n] = interleaved[n*paddedChannels+c];
+		}
+	}
+}
+
+// at time step t section s works on sample t-s, fed by what section s-1 output at step t-1
+// all the sections are busy at once except for the first and last sections-1 steps, which ramp the wavefront in and out within the same call
+void BiquadBank::processCascade(double *inout, int numOfSamples, unsigned short channel) {
+	if(channel>=channels) {
+		printf("BiquadBank has no channel %d!\n", channel);
+		return;
+	}
+	if(sections == 0)
+		return;
+
+	// gather this channel's sections in contiguous lanes
+	for(int s=0; s<sections; s++) {
+		int k = s*paddedChannels + channel;
+		cascCoefs[0][s] = a0[k];
+		cascCoefs[1][s] = a1[k];
+		cascCoefs[2][s] = a2[k];
+		cascCoefs[3][s] = b1[k];
+		cascCoefs[4][s] = b2[k];
+		cascZ1[s] = z1[k];
+		cascZ2[s] = z2[k];
+	}
+
+	int S = sections;
+	for(int t=0; t<numOfSamples+S-1; t++) {
+		pipe[0] = (t<numOfSamples) ? inout[t] : 0;
+
+		int lo = (t-numOfSamples+1 > 0) ? t-numOfSamples+1 : 0; // sections that already went through the whole buffer are idle
+		int hi = (t < S-1) ? t : S-1;							 // sections the wavefront has not reached yet too
+
+		// sections are stepped from last to first, so that each reads its input before the previous one overwrites it
+		if(lo==0 && hi==S-1) {
+			for(int s=paddedSections-BQ_WIDTH; s>=0; s-=BQ_WIDTH)
+				sectionsStep(pipe+s, pipe+s+1, cascCoefs[0]+s, cascCoefs[1]+s, cascCoefs[2]+s, cascCoefs[3]+s, cascCoefs[4]+s, cascZ1+s, cascZ2+s);
+		}
+		else {
+			for(int s=hi; s>=lo; s--)
+				sectionStep(pipe+s, pipe+s+1, cascCoefs[0]+s, cascCoefs[1]+s, cascCoefs[2]+s, cascCoefs[3]+s, cascCoefs[4]+s, cascZ1+s, cascZ2+s);
+		}
+
+		if(t >= S-1)
+			inout[t-S+1] = pipe[S]; // this sample went through all sections
+	}
+
+	// scatter state back
+	for(int s=0; s<sections; s++) {
+		int k = s*paddedChannels + channel;
+		z1[k] = cascZ1[s];
+		z2[k] = cascZ2[s];
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+void BiquadBank::deallocate() {
+	free(a0);
+	free(a1);
+	free(a2);
+	free(b1);
+	free(b2);
+	free(z1);
+	free(z2);
+	free(interleaved);
+	for(int i=0; i<5; i++) {
+		free(cascCoefs[i]);
+		cascCoefs[i] = NULL;
+	}
+	free(cascZ1);
+	free(cascZ2);
+	free(pipe);
+
+	a0 = a1 = a2 = b1 = b2 = NULL;
+	z1 = z2 = NULL;
+	interleaved = NULL;
+	cascZ1 = cascZ2 = NULL;
+	pipe = NULL;
+}
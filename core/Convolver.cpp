@@ -0,0 +1,245 @@
+/*
+ * Convolver.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: multichannel convolution module, for cabinet and room impulse responses
+ */
+
+#include "Convolver.h"
+#include "Waveforms.h"		// AudioFile
+#include "priority_utils.h"
+
+#include <stdio.h>
+
+// workers are joined by the audio thread at each period, so they must not be preempted by anything less important
+int Convolver::prioWorkers = 1;
+
+
+Convolver::Convolver() {
+	channels = 0;
+	convolutions = NULL;
+	nuConvolutions = NULL;
+	workers = NULL;
+	numOfWorkers = 0;
+	stopWorkers = false;
+	currentInput = NULL;
+	currentNumOfSamples = 0;
+}
+
+Convolver::~Convolver() {
+	deallocate();
+}
+
+int Convolver::init(std::string filename, int rate, unsigned int periodSize, unsigned short chns, unsigned short inChnOffset, unsigned short outChnOffset,
+					unsigned short numOfThreads, bool normalize, bool nonUniform) {
+	AudioFile file;
+	if(file.init(filename, rate, periodSize) != 0) // average of all channels
+		return -1;
+
+	int irLen = file.getWaveformLen();
+	double **irs = new double *[chns];
+
+	std::vector<SamplePtr> chnData; // keeps responses alive until init is done
+	if(chns > 1 && file.getFileChannelsNum() == chns) {
+		// one response per channel, file decoded once for all of them
+		if(AudioFile::loadChannels(filename, rate, chnData) != 0) {
+			delete[] irs;
+			return -1;
+		}
+		for(int c=0; c<chns; c++)
+			irs[c] = chnData[c]->samples;
+	}
+	else {
+		for(int c=0; c<chns; c++)
+			irs[c] = file.getWaveform();
+	}
+
+	int retval = initChannels(irs, irLen, periodSize, chns, inChnOffset, outChnOffset, numOfThreads, normalize, nonUniform);
+
+	delete[] irs;
+
+	return retval;
+}
+
+int Convolver::init(double *ir, int irLen, unsigned int periodSize, unsigned short chns, unsigned short inChnOffset, unsigned short outChnOffset,
+					unsigned short numOfThreads, bool normalize, bool nonUniform) {
+	double **irs = new double *[chns];
+	for(int c=0; c<chns; c++)
+		irs[c] = ir;
+
+	int retval = initChannels(irs, irLen, periodSize, chns, inChnOffset, outChnOffset, numOfThreads, normalize, nonUniform);
+
+	delete[] irs;
+	return retval;
+}
+
+double **Convolver::getFrameBuffer(int numOfSamples, double **input) {
+	currentInput = input;
+	currentNumOfSamples = numOfSamples;
+
+	// fork
+	for(int w=0; w<numOfWorkers; w++)
+		sem_post(&workers[w].start);
+
+	// audio thread takes care of channels before first worker's
+	processChannels(0, (numOfWorkers>0) ? workers[0].firstChn : channels);
+
+	// join
+	for(int w=0; w<numOfWorkers; w++)
+		sem_wait(&workers[w].done);
+
+	return framebuffer;
+}
+
+void Convolver::retrigger() {
+	for(int c=0; c<channels; c++) {
+		if(nuConvolutions != NULL)
+			nuConvolutions[c].reset();
+		else
+			convolutions[c].reset();
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+int Convolver::initChannels(double **irs, int irLen, unsigned int periodSize, unsigned short chns, unsigned short inChnOffset, unsigned short outChnOffset,
+							unsigned short numOfThreads, bool normalize, bool nonUniform) {
+	if(irLen <= 0) {
+		printf("Convolver error! Impulse response is empty\n");
+		return -1;
+	}
+	if(chns == 0) {
+		printf("Convolver error! It needs at least one channel\n");
+		return -1;
+	}
+
+	deallocate();
+
+	AudioModuleInOut::init(periodSize, chns, inChnOffset, chns, outChnOffset);
+	channels = chns;
+
+	// AudioFile scales float files to a fixed peak, so unity energy is a more reliable reference
+	// same gain on all channels, to keep their balance
+	double gain = 1;
+	if(normalize) {
+		double maxEnergy = 0;
+		for(int c=0; c<chns; c++) {
+			double energy = 0;
+			for(int n=0; n<irLen; n++)
+				energy += irs[c][n]*irs[c][n];
+			if(energy > maxEnergy)
+				maxEnergy = energy;
+		}
+		if(maxEnergy > 0)
+			gain = 1/sqrt(maxEnergy);
+	}
+
+	if(nonUniform)
+		nuConvolutions = new NonUniformConvolution[chns];
+	else
+		convolutions = new PartitionedConvolution[chns];
+	double *scaled = new double[irLen];
+	for(int c=0; c<chns; c++) {
+		for(int n=0; n<irLen; n++)
+			scaled[n] = irs[c][n]*gain;
+		int ret = nonUniform ? nuConvolutions[c].init(scaled, irLen, periodSize) : convolutions[c].init(scaled, irLen, periodSize);
+		if(ret != 0) {
+			delete[] scaled;
+			return -1;
+		}
+	}
+	delete[] scaled;
+
+	startWorkers(numOfThreads);
+
+	return 0;
+}
+
+void Convolver::processChannels(unsigned short firstChn, unsigned short lastChn) {
+	for(int c=firstChn; c<lastChn; c++) {
+		double *out = framebuffer[out_chn_offset+c];
+		if(nuConvolutions != NULL)
+			nuConvolutions[c].process(currentInput[in_chn_offset+c], out, currentNumOfSamples);
+		else
+			convolutions[c].process(currentInput[in_chn_offset+c], out, currentNumOfSamples);
+		if(level != 1) {
+			for(int n=0; n<currentNumOfSamples; n++)
+				out[n] *= level;
+		}
+	}
+}
+
+// channels are split in numOfThreads+1 groups, the first one stays on the audio thread
+void Convolver::startWorkers(unsigned short numOfThreads) {
+	int maxWorkers = (int)channels-1; // at least one channel each, signed so that no channels means no workers
+	int workersNum = numOfThreads;
+	if(workersNum > maxWorkers)
+		workersNum = maxWorkers;
+	if(workersNum < 0)
+		workersNum = 0;
+	numOfWorkers = workersNum;
+	if(numOfWorkers == 0)
+		return;
+
+	stopWorkers = false;
+	workers = new ConvolverWorker[numOfWorkers];
+
+	int groups = numOfWorkers+1;
+	for(int w=0; w<numOfWorkers; w++) {
+		workers[w].convolver = this;
+		workers[w].firstChn = (channels*(w+1))/groups;
+		workers[w].lastChn = (channels*(w+2))/groups;
+		sem_init(&workers[w].start, 0, 0);
+		sem_init(&workers[w].done, 0, 0);
+		pthread_create(&workers[w].thread, NULL, workerLoop, &workers[w]);
+	}
+}
+
+void Convolver::stopAndDeleteWorkers() {
+	if(workers == NULL)
+		return;
+
+	stopWorkers = true;
+	for(int w=0; w<numOfWorkers; w++) {
+		sem_post(&workers[w].start);
+		pthread_join(workers[w].thread, NULL);
+		sem_destroy(&workers[w].start);
+		sem_destroy(&workers[w].done);
+	}
+	delete[] workers;
+	workers = NULL;
+	numOfWorkers = 0;
+}
+
+void Convolver::deallocate() {
+	stopAndDeleteWorkers();
+
+	if(convolutions != NULL) {
+		delete[] convolutions;
+		convolutions = NULL;
+	}
+	if(nuConvolutions != NULL) {
+		delete[] nuConvolutions;
+		nuConvolutions = NULL;
+	}
+	channels = 0;
+}
+
+void *Convolver::workerLoop(void *arg) {
+	ConvolverWorker *worker = (ConvolverWorker *)arg;
+	Convolver *convolver = worker->convolver;
+
+	if(prioWorkers >= 0)
+		set_priority(prioWorkers);
+
+	while(true) {
+		sem_wait(&worker->start);
+		if(convolver->stopWorkers)
+			break;
+		convolver->processChannels(worker->firstChn, worker->lastChn);
+		sem_post(&worker->done);
+	}
+	return (void *)0;
+}
@@ -0,0 +1,230 @@
+/*
+ * DiskRecorder.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: multitrack recorder, audio thread only copies blocks into a lock-free ring and a writer thread puts them on disk
+ */
+
+#include "DiskRecorder.h"
+#include "priority_utils.h"
+
+#include <stdio.h>
+#include <string.h> // memset
+#include <fcntl.h>	// open, fallocate
+#include <unistd.h> // truncate
+#include <sys/stat.h>
+
+
+// lowest of the helper threads, the ring covers for its latency
+int DiskRecorder::prioWriter = 6;
+
+DiskRecorder::DiskRecorder() {
+	sndfile = NULL;
+	channels = 0;
+	periodSize = 0;
+	blockMemory = NULL;
+	current = NULL;
+	blockStarted = false;
+	batch = NULL;
+	batchFrames = 0;
+	writtenFrames = 0;
+	droppedBlocks = 0;
+	stopWriter = false;
+	writerStarted = false;
+}
+
+DiskRecorder::~DiskRecorder() {
+	close();
+}
+
+int DiskRecorder::init(std::string filename, int rate, unsigned short channels, unsigned int periodSize, recorderFormat format, int subformat,
+					   double ringSeconds, double preallocSeconds) {
+	close();
+
+	SF_INFO sfinfo;
+	memset(&sfinfo, 0, sizeof(sfinfo));
+	sfinfo.samplerate = rate;
+	sfinfo.channels = channels;
+	if(format == rec_w64_)
+		sfinfo.format = SF_FORMAT_W64 | subformat;
+	else if(format == rec_caf_)
+		sfinfo.format = SF_FORMAT_CAF | subformat;
+	else if(format == rec_rf64_)
+		sfinfo.format = SF_FORMAT_RF64 | subformat;
+	else
+		sfinfo.format = SF_FORMAT_WAV | subformat;
+
+	if(!sf_format_check(&sfinfo)) {
+		printf("DiskRecorder %s error! Unsupported format 0x%x for %d channels at %d Hz\n", filename.c_str(), sfinfo.format, channels, rate);
+		return -1;
+	}
+
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		printf("DiskRecorder error! Can't create file %s\n", filename.c_str());
+		return -1;
+	}
+
+	// reserves space without changing file size, what is not used is given back in close()
+	// not all file systems support it, recording works anyway
+	int bytesPerSample = 4;
+	if(subformat == SF_FORMAT_PCM_16)
+		bytesPerSample = 2;
+	else if(subformat == SF_FORMAT_PCM_24)
+		bytesPerSample = 3;
+	else if(subformat == SF_FORMAT_DOUBLE)
+		bytesPerSample = 8;
+	off_t preallocBytes = (off_t)(preallocSeconds*rate)*channels*bytesPerSample;
+	if(preallocBytes > 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, preallocBytes) != 0)
+		printf("DiskRecorder warning! Can't preallocate %ld bytes for file %s\n", (long)preallocBytes, filename.c_str());
+
+	if( !(sndfile = sf_open_fd(fd, SFM_WRITE, &sfinfo, 1)) ) {
+		printf("DiskRecorder error! Can't open file %s for writing: %s\n", filename.c_str(), sf_strerror(NULL)); // descriptor is closed by libsndfile
+		return -1;
+	}
+	if(format == rec_rf64_)
+		sf_command(sndfile, SFC_RF64_AUTO_DOWNGRADE, NULL, SF_TRUE); // header is fixed in close(), when size is known
+
+	this->filename = filename;
+	this->channels = channels;
+	this->periodSize = periodSize;
+
+	// all blocks in one allocation
+	int blocksNum = (ringSeconds*rate + periodSize-1)/periodSize;
+	if(blocksNum < 2)
+		blocksNum = 2;
+	blocksNum = ring.init(blocksNum);
+	blockMemory = new float[blocksNum*channels*periodSize];
+	for(int b=0; b<blocksNum; b++) {
+		ring.getSlot(b)->samples = blockMemory + b*channels*periodSize;
+		ring.getSlot(b)->frames = 0;
+	}
+	current = NULL;
+	blockStarted = false;
+
+	// one extra period, the batch is written as soon as it goes past RECORDER_BATCH_FRAMES
+	batch = new float[(RECORDER_BATCH_FRAMES+periodSize)*channels];
+	batchFrames = 0;
+
+	writtenFrames = 0;
+	droppedBlocks = 0;
+	stopWriter = false;
+	sem_init(&writerSem, 0, 0);
+	pthread_create(&writerThread, NULL, writerLoop, this);
+	writerStarted = true;
+
+	return 0;
+}
+
+void DiskRecorder::close() {
+	if(writerStarted) {
+		stopWriter = true;
+		sem_post(&writerSem);
+		pthread_join(writerThread, NULL); // writer empties ring before leaving
+		sem_destroy(&writerSem);
+		writerStarted = false;
+	}
+
+	if(sndfile != NULL) {
+		sf_write_sync(sndfile);
+		sf_close(sndfile);
+		sndfile = NULL;
+
+		// gives back reserved space that was not used
+		struct stat st;
+		if(stat(filename.c_str(), &st) == 0 && truncate(filename.c_str(), st.st_size) != 0)
+			printf("DiskRecorder warning! Can't release unused space of file %s\n", filename.c_str());
+	}
+
+	deallocate();
+}
+
+void DiskRecorder::push(int numOfSamples) {
+	if(!blockStarted)
+		startBlock();
+	blockStarted = false;
+	if(current == NULL)
+		return; // already counted as dropped
+
+	current->frames = numOfSamples;
+	current = NULL;
+	ring.push();
+	sem_post(&writerSem);
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// audio thread, first tap of the period
+void DiskRecorder::startBlock() {
+	blockStarted = true;
+	if(blockMemory == NULL) {
+		current = NULL; // not recording
+		return;
+	}
+	current = ring.getWriteSlot();
+	if(current == NULL) {
+		droppedBlocks++;
+		return;
+	}
+	memset(current->samples, 0, channels*periodSize*sizeof(float));
+}
+
+// writer thread, interleaves what is in the ring and writes in big batches
+void DiskRecorder::writeBlocks(bool flush) {
+	while(true) {
+		RecorderBlock *block = ring.getReadSlot();
+		if(block != NULL) {
+			float *dst = batch + batchFrames*channels;
+			for(int c=0; c<channels; c++) {
+				const float *src = block->samples + c*periodSize;
+				for(int n=0; n<block->frames; n++)
+					dst[n*channels+c] = src[n];
+			}
+			batchFrames += block->frames;
+			ring.pop();
+		}
+
+		// partial batches wait for next wake up, unless recording is over
+		if(batchFrames >= RECORDER_BATCH_FRAMES || (block == NULL && flush && batchFrames > 0)) {
+			sf_count_t written = sf_writef_float(sndfile, batch, batchFrames);
+			if(written != batchFrames)
+				printf("DiskRecorder %s error! Wrote %ld frames out of %d: %s\n", filename.c_str(), (long)written, batchFrames, sf_strerror(sndfile));
+			writtenFrames += written;
+			batchFrames = 0;
+		}
+
+		if(block == NULL)
+			return;
+	}
+}
+
+void *DiskRecorder::writerLoop(void *arg) {
+	DiskRecorder *that = (DiskRecorder *)arg;
+	if(prioWriter >= 0)
+		set_priority(prioWriter);
+
+	while(!that->stopWriter) {
+		sem_wait(&that->writerSem);
+		// after a slow write, one wake up drains all blocks that piled up
+		that->writeBlocks(false);
+	}
+	that->writeBlocks(true); // leftovers
+
+	return NULL;
+}
+
+void DiskRecorder::deallocate() {
+	current = NULL;
+	blockStarted = false;
+	if(blockMemory != NULL) {
+		delete[] blockMemory;
+		blockMemory = NULL;
+	}
+	if(batch != NULL) {
+		delete[] batch;
+		batch = NULL;
+	}
+	channels = 0;
+}
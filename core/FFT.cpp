@@ -30,83 +30,212 @@
  *
  */
 
-#include <fftw3.h> // fft stuff
+#include "FFT.h"
+
+#include <stdio.h>
 #include <cstring> // memcpy...seems like it is my best friend, always with me...
+#include <map>
+#include <tuple>
+#include <mutex>
 
 /*i set up the following code so that fftw3 will try to use SSE. it's gonna be a transparent process*/
 
+enum plan_kind {
+	plan_r2c_inplace = 0, // FFT objects, on their own aligned buffers
+	plan_c2r_inplace,
+	plan_r2c_unaligned,   // one shot functions, on whatever arrays the caller passes
+	plan_c2r_unaligned
+};
+
+// planner is not thread safe [only execution is], so all planning and wisdom goes through this mutex
+static std::mutex plansMutex;
+static std::map<std::tuple<int, int, unsigned>, fftw_plan> plans;		// size, kind, flags
+static std::map<std::tuple<int, int, unsigned>, fftwf_plan> plansFloat;
+
+static unsigned planningFlags[] = {FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT};
+
+
+// plans are created on temporary arrays and then only used with new array execute functions
+static fftw_plan getPlan(int size, plan_kind kind, unsigned flags) {
+	std::lock_guard<std::mutex> lock(plansMutex);
+
+	std::tuple<int, int, unsigned> key(size, kind, flags);
+	auto it = plans.find(key);
+	if(it != plans.end())
+		return it->second;
+
+	fftw_complex *bins = fftw_alloc_complex(size/2+1);
+	double *samples = fftw_alloc_real(size);
+	fftw_plan p = NULL;
+	switch(kind) {
+		case plan_r2c_inplace:
+			p = fftw_plan_dft_r2c_1d(size, (double *)bins, bins, flags);
+			break;
+		case plan_c2r_inplace:
+			p = fftw_plan_dft_c2r_1d(size, bins, (double *)bins, flags);
+			break;
+		case plan_r2c_unaligned:
+			p = fftw_plan_dft_r2c_1d(size, samples, bins, flags | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+			break;
+		case plan_c2r_unaligned:
+			p = fftw_plan_dft_c2r_1d(size, bins, samples, flags | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+			break;
+	}
+	fftw_free(bins);
+	fftw_free(samples);
+
+	if(p == NULL)
+		printf("FFT error! Cannot create plan for size %d\n", size);
+	else
+		plans[key] = p;
+	return p;
+}
 
-void calculateFFT(float samples[], int numOfFFTsamples, float outputSamples[][2]) {
-	/* test
-	memset(samples, 0, numOfFFTsamples*sizeof(float));
-	numOfFFTsamples = 8;
-	for(int i=0;i<6;i++)
-		samples[i] = i+1;*/
+static fftwf_plan getPlanFloat(int size, plan_kind kind, unsigned flags) {
+	std::lock_guard<std::mutex> lock(plansMutex);
+
+	std::tuple<int, int, unsigned> key(size, kind, flags);
+	auto it = plansFloat.find(key);
+	if(it != plansFloat.end())
+		return it->second;
+
+	fftwf_complex *bins = fftwf_alloc_complex(size/2+1);
+	float *samples = fftwf_alloc_real(size);
+	fftwf_plan p = NULL;
+	switch(kind) {
+		case plan_r2c_inplace:
+			p = fftwf_plan_dft_r2c_1d(size, (float *)bins, bins, flags);
+			break;
+		case plan_c2r_inplace:
+			p = fftwf_plan_dft_c2r_1d(size, bins, (float *)bins, flags);
+			break;
+		case plan_r2c_unaligned:
+			p = fftwf_plan_dft_r2c_1d(size, samples, bins, flags | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+			break;
+		case plan_c2r_unaligned:
+			p = fftwf_plan_dft_c2r_1d(size, bins, samples, flags | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+			break;
+	}
+	fftwf_free(bins);
+	fftwf_free(samples);
+
+	if(p == NULL)
+		printf("FFT error! Cannot create float plan for size %d\n", size);
+	else
+		plansFloat[key] = p;
+	return p;
+}
 
-	int numOfOutputSamples = ((float)numOfFFTsamples)/2.0 + 1;
-	// prepare working structure, memory aligned to 16 bytes [to work on sse]
-	float *fftIn = fftwf_alloc_real(numOfFFTsamples);
-	fftwf_complex *fftOut = fftwf_alloc_complex(numOfOutputSamples);
-	fftwf_plan p = fftwf_plan_dft_r2c_1d(numOfFFTsamples, fftIn, fftOut, FFTW_ESTIMATE);
 
-	// fill input, after instantiating plan [just in caaase]
-	memcpy(fftIn, samples, numOfFFTsamples*sizeof(float)); // can use memcpy even if alignment is different in the 2 arrays, cos in both cases all elements are contiguous
 
-	// do fft
-	fftwf_execute(p);
+FFT::FFT() {
+	size = 0;
+	buffer = NULL;
+	forwardPlan = NULL;
+	inversePlan = NULL;
+	norm = 1;
+}
 
-	//fftwf_print_plan(p); // check if we're using sse [look for 'v' subscript in printed text]
+FFT::~FFT() {
+	if(buffer != NULL)
+		fftw_free(buffer);
+}
+
+int FFT::init(int size, fft_planning planning) {
+	if(size <= 0) {
+		printf("FFT error! Size %d is not valid\n", size);
+		return -1;
+	}
 
-	// copy fft output to return array
-	memcpy(outputSamples, fftOut, numOfOutputSamples*2*sizeof(float));
+	if(buffer != NULL)
+		fftw_free(buffer);
 
-	// get rid of stuff
-	fftwf_destroy_plan(p);
-	fftwf_free(fftOut);
+	this->size = size;
+	norm = 1.0/size;
+	buffer = fftw_alloc_complex(size/2+1); // fftw alignment, same as the arrays plans were created on
+	memset(buffer, 0, (size/2+1)*sizeof(fftw_complex));
 
-	/* slower complex version, not useful for audio
-  	fftwf_complex *in = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex) * numOfFFTsamples);
-	fftwf_complex *out = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex) * numOfFFTsamples);
-	fftwf_plan p2 = fftwf_plan_dft_1d(numOfFFTsamples, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
+	forwardPlan = getPlan(size, plan_r2c_inplace, planningFlags[planning]);
+	inversePlan = getPlan(size, plan_c2r_inplace, planningFlags[planning]);
+	if(forwardPlan == NULL || inversePlan == NULL)
+		return -1;
 
-	for(int i=0; i<numOfFFTsamples; i++) {
-	   in[i][0] = samples[i];
-	   in[i][1] = 0;
+	return 0;
+}
+
+int FFT::loadWisdom(const char *filename, const char *filenameFloat) {
+	std::lock_guard<std::mutex> lock(plansMutex);
+
+	int retval = 0;
+	if(filename != NULL && fftw_import_wisdom_from_filename(filename) == 0) {
+		printf("FFT wisdom file %s can't be loaded\n", filename);
+		retval = -1;
+	}
+	if(filenameFloat != NULL && fftwf_import_wisdom_from_filename(filenameFloat) == 0) {
+		printf("FFT wisdom file %s can't be loaded\n", filenameFloat);
+		retval = -1;
 	}
+	return retval;
+}
+
+int FFT::saveWisdom(const char *filename, const char *filenameFloat) {
+	std::lock_guard<std::mutex> lock(plansMutex);
+
+	int retval = 0;
+	if(filename != NULL && fftw_export_wisdom_to_filename(filename) == 0) {
+		printf("FFT wisdom file %s can't be saved\n", filename);
+		retval = -1;
+	}
+	if(filenameFloat != NULL && fftwf_export_wisdom_to_filename(filenameFloat) == 0) {
+		printf("FFT wisdom file %s can't be saved\n", filenameFloat);
+		retval = -1;
+	}
+	return retval;
+}
+
 
-	fftwf_execute(p2);
 
-	// get rid of stuff
-	fftwf_destroy_plan(p2);
-	fftwf_free(in);
-	fftwf_free(out);*/
+void calculateFFT(float samples[], int numOfFFTsamples, float outputSamples[][2]) {
+	fftwf_plan p = getPlanFloat(numOfFFTsamples, plan_r2c_unaligned, FFTW_ESTIMATE); // still uses any measured wisdom for this size
+	if(p == NULL)
+		return;
+
+	// straight from caller's arrays, input is preserved
+	fftwf_execute_dft_r2c(p, samples, outputSamples);
+
+	//fftwf_print_plan(p); // check if we're using sse [look for 'v' subscript in printed text]
 }
 
 void calculateFFT(double samples[], int numOfFFTsamples, double outputSamples[][2]) {
-	/* test
-	memset(samples, 0, numOfFFTsamples*sizeof(float));
-	numOfFFTsamples = 8;
-	for(int i=0;i<6;i++)
-		samples[i] = i+1;*/
+	fftw_plan p = getPlan(numOfFFTsamples, plan_r2c_unaligned, FFTW_ESTIMATE);
+	if(p == NULL)
+		return;
 
-	int numOfOutputSamples = ((double)numOfFFTsamples)/2.0 + 1;
-	// prepare working structure, memory aligned to 16 bytes [to work on sse]
-	double *fftIn = fftw_alloc_real(numOfFFTsamples);
-	fftw_complex *fftOut = fftw_alloc_complex(numOfOutputSamples);
-	fftw_plan p = fftw_plan_dft_r2c_1d(numOfFFTsamples, fftIn, fftOut, FFTW_ESTIMATE);
+	fftw_execute_dft_r2c(p, samples, outputSamples);
+}
+
+void calculateIFFT(float inputSamples[][2], int numOfFFTsamples, float outputSamples[]) {
+	fftwf_plan p = getPlanFloat(numOfFFTsamples, plan_c2r_unaligned, FFTW_ESTIMATE);
+	if(p == NULL)
+		return;
 
-	// fill input, after instantiating plan [just in caaase]
-	memcpy(fftIn, samples, numOfFFTsamples*sizeof(double)); // can use memcpy even if alignment is different in the 2 arrays, cos in both cases all elements are contiguous
+	// plan preserves input, so caller's array is untouched
+	fftwf_execute_dft_c2r(p, inputSamples, outputSamples);
 
-	// do fft
-	fftw_execute(p);
+	// fftw does not normalize, so we do it here
+	float norm = 1.0/numOfFFTsamples;
+	for(int i=0; i<numOfFFTsamples; i++)
+		outputSamples[i] *= norm;
+}
 
-	//fftw_print_plan(p); // check if we're using sse [look for 'v' subscript in printed text]
+void calculateIFFT(double inputSamples[][2], int numOfFFTsamples, double outputSamples[]) {
+	fftw_plan p = getPlan(numOfFFTsamples, plan_c2r_unaligned, FFTW_ESTIMATE);
+	if(p == NULL)
+		return;
 
-	// copy fft output to return array
-	memcpy(outputSamples, fftOut, numOfOutputSamples*2*sizeof(double));
+	fftw_execute_dft_c2r(p, inputSamples, outputSamples);
 
-	// get rid of stuff
-	fftw_destroy_plan(p);
-	fftw_free(fftOut);
+	double norm = 1.0/numOfFFTsamples;
+	for(int i=0; i<numOfFFTsamples; i++)
+		outputSamples[i] *= norm;
 }
@@ -0,0 +1,311 @@
+/*
+ * Granulator.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: granular synthesis over shared samples, thousands of grains from a fixed pool
+ */
+
+#include "Granulator.h"
+#include "Waveforms.h" // AudioFile::loadSamples()
+
+#include <stdio.h>
+#include <math.h>
+#include <mutex> // call_once
+#include <algorithm> // min
+
+
+// shared by all Granulators and computed only once, they live as long as the application
+static double windowTables[grain_windowsNum_][GRANULATOR_WINDOW_LEN+1];
+static std::once_flag windowTablesFlag;
+
+static void computeWindowTables() {
+	const double gaussSigma = 0.15;
+	const double gaussEdge = exp(-0.5*(0.5/gaussSigma)*(0.5/gaussSigma));
+	const double tukeyAlpha = 0.5; // part of the window that fades
+
+	for(int i=0; i<=GRANULATOR_WINDOW_LEN; i++) {
+		double x = (double)i/GRANULATOR_WINDOW_LEN;
+
+		windowTables[grain_hann_][i] = 0.5 - 0.5*cos(2*M_PI*x);
+
+		double g = exp(-0.5*((x-0.5)/gaussSigma)*((x-0.5)/gaussSigma));
+		windowTables[grain_gauss_][i] = (g-gaussEdge)/(1-gaussEdge); // zero at edges, no clicks
+
+		if(x < tukeyAlpha/2)
+			windowTables[grain_tukey_][i] = 0.5 - 0.5*cos(2*M_PI*x/tukeyAlpha);
+		else if(x > 1-tukeyAlpha/2)
+			windowTables[grain_tukey_][i] = 0.5 - 0.5*cos(2*M_PI*(1-x)/tukeyAlpha);
+		else
+			windowTables[grain_tukey_][i] = 1;
+
+		windowTables[grain_triangle_][i] = 1 - fabs(2*x-1);
+	}
+}
+
+
+Granulator::Granulator() {
+	rate = -1;
+	grains = NULL;
+	maxGrains = 0;
+	activeGrains = 0;
+	activeGrainsShared = 0;
+	skippedGrains = 0;
+	retriggerPending = false;
+	nextOnset = 0;
+
+	density.reset(20);
+	position.reset(0);
+	jitter.reset(0);
+	pitch.reset(1);
+	duration.reset(0.1);
+	spread.reset(0);
+	window = grain_hann_;
+	smoothTime = GRANULATOR_DEFAULT_SMOOTHING;
+	smoothCoeff = 0;
+}
+
+Granulator::~Granulator() {
+	deallocate();
+}
+
+int Granulator::init(SamplePtr data, int rate, unsigned int periodSize, double level, unsigned short outChannels, unsigned short outChnOffset, int maxGrains) {
+	if(data == NULL || data->frames < 2) {
+		printf("Granulator error! No samples to play\n");
+		return -1;
+	}
+	if(outChannels != 1 && outChannels != 2) {
+		printf("Granulator error! Output can be mono or stereo, %d channels were requested\n", outChannels);
+		return -1;
+	}
+
+	deallocate();
+	std::call_once(windowTablesFlag, computeWindowTables);
+
+	this->data = data;
+	this->rate = rate;
+	this->maxGrains = maxGrains;
+	grains = new Grain[maxGrains];
+	activeGrains = 0;
+	activeGrainsShared = 0;
+	skippedGrains = 0;
+	retriggerPending = false;
+	nextOnset = 0;
+
+	// settings passed before init are kept, but with no glide
+	density.reset(density.target);
+	position.reset(position.target);
+	jitter.reset(jitter.target);
+	pitch.reset(pitch.target);
+	duration.reset(duration.target);
+	spread.reset(spread.target);
+	setSmoothingTime(smoothTime);
+
+	AudioModuleOut::init(periodSize, outChannels, outChnOffset);
+	setLevel(level);
+
+	return 0;
+}
+
+int Granulator::init(std::string filename, int rate, unsigned int periodSize, double level, int chnIndex, unsigned short outChannels, unsigned short outChnOffset, int maxGrains) {
+	SamplePtr data;
+	int retval = AudioFile::loadSamples(filename, rate, chnIndex, data); // same samples as AudioFiles that play this file
+	if(retval != 0)
+		return retval;
+	return init(data, rate, periodSize, level, outChannels, outChnOffset, maxGrains);
+}
+
+double **Granulator::getFrameBuffer(int numOfSamples) {
+	double *outL = framebuffer[out_chn_offset];
+	double *outR = (out_channels > 1) ? framebuffer[out_chn_offset+1] : NULL;
+	memset(outL, 0, period_size*sizeof(double));
+	if(outR != NULL)
+		memset(outR, 0, period_size*sizeof(double));
+	if(data == NULL)
+		return framebuffer;
+
+	if(retriggerPending.exchange(false)) {
+		activeGrains = 0;
+		activeGrainsShared = 0;
+		nextOnset = 0;
+	}
+
+	// onsets whose first sample falls in this period, each grain reads parameters exactly where it starts
+	while(nextOnset <= numOfSamples-1) {
+		int offset = (int)ceil(nextOnset);
+		double smoothPow = pow(smoothCoeff, offset);
+		double grainsPerSecond = density.getAt(smoothPow);
+		if(grainsPerSecond <= 0) {
+			nextOnset = numOfSamples; // checked again next period
+			break;
+		}
+		double interval = std::max(1.0, rate/grainsPerSecond); // at most one onset per sample
+
+		// grains end only while mixing, so a full pool stays full for the rest of the period: remaining onsets are skipped in one go
+		if(activeGrains == maxGrains) {
+			int skipped = (int)((numOfSamples-1-nextOnset)/interval) + 1;
+			skippedGrains += skipped;
+			nextOnset += skipped*interval;
+			break;
+		}
+
+		spawnGrain(offset, offset-nextOnset, smoothPow);
+		nextOnset += interval;
+	}
+	nextOnset -= numOfSamples; // fraction is carried over, so it can be slightly negative
+
+	// ended grains are replaced by last active one, pool stays packed
+	for(int i=0; i<activeGrains; ) {
+		mixGrain(grains[i], outL, outR, numOfSamples);
+		if(grains[i].remaining <= 0)
+			grains[i] = grains[--activeGrains];
+		else
+			i++;
+	}
+	activeGrainsShared = activeGrains;
+
+	for(int n=0; n<numOfSamples; n++)
+		outL[n] *= level;
+	if(outR != NULL) {
+		for(int n=0; n<numOfSamples; n++)
+			outR[n] *= level;
+	}
+
+	// glides go on from where they are at end of period
+	double endPow = pow(smoothCoeff, numOfSamples);
+	density.current = density.getAt(endPow);
+	position.current = position.getAt(endPow);
+	jitter.current = jitter.getAt(endPow);
+	pitch.current = pitch.getAt(endPow);
+	duration.current = duration.getAt(endPow);
+	spread.current = spread.getAt(endPow);
+
+	return framebuffer;
+}
+
+void Granulator::retrigger() {
+	retriggerPending = true;
+}
+
+void Granulator::setSmoothingTime(double seconds) {
+	smoothTime = seconds;
+	if(rate > 0)
+		smoothCoeff = (seconds > 0) ? exp(-1.0/(seconds*rate)) : 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// grain starts between two samples, delay is how late its first sample is [0 to 1], the grain is advanced accordingly
+void Granulator::spawnGrain(int offset, double delay, double smoothPow) {
+	if(activeGrains == maxGrains) {
+		skippedGrains++;
+		return;
+	}
+
+	double ratio = pitch.getAt(smoothPow);
+	int len = (int)(duration.getAt(smoothPow)*rate);
+	long frames = data->frames;
+
+	// whole grain must fit within samples, long grains on short samples are shortened
+	double span = len*ratio;
+	if(span > frames-1) {
+		len = (int)((frames-1)/ratio);
+		span = len*ratio;
+	}
+	if(len < 2 || ratio <= 0)
+		return;
+
+	double start = (position.getAt(smoothPow) + jitter.getAt(smoothPow)*random.uniformBipolar())*frames;
+	if(start > frames-1-span)
+		start = frames-1-span;
+	if(start < 0)
+		start = 0;
+
+	Grain &g = grains[activeGrains++];
+	g.pos = (int64_t)((start + delay*ratio)*(1LL<<GRANULATOR_FRAC_BITS));
+	g.inc = (int64_t)llround(ratio*(1LL<<GRANULATOR_FRAC_BITS));
+	g.winInc = ((int64_t)GRANULATOR_WINDOW_LEN<<GRANULATOR_FRAC_BITS)/len;
+	g.winPos = (int64_t)(delay*g.winInc); // last sample still reads within window table
+	g.remaining = len;
+	g.offset = offset;
+	g.window = getWindowTable((grainWindow)window.load(std::memory_order_relaxed));
+
+	// equal power pan
+	if(out_channels > 1) {
+		double pan = 0.5 + 0.5*spread.getAt(smoothPow)*random.uniformBipolar();
+		pan = std::min(1.0, std::max(0.0, pan));
+		g.gainL = cos(pan*M_PI*0.5);
+		g.gainR = sin(pan*M_PI*0.5);
+	}
+	else {
+		g.gainL = 1;
+		g.gainR = 0;
+	}
+}
+
+// each output sample of a grain is computed independently of the others, so 4 at a time can be unrolled and vectorized
+void Granulator::mixGrain(Grain &g, double *outL, double *outR, int numOfSamples) {
+	int len = std::min(g.remaining, numOfSamples-g.offset);
+	const double *src = data->samples;
+	const double *win = g.window;
+	double *L = outL + g.offset;
+	double *R = (outR != NULL) ? outR + g.offset : NULL;
+
+	int n = 0;
+	for(; n+4<=len; n+=4) {
+		double v[4];
+		for(int k=0; k<4; k++) {
+			int64_t p = g.pos + k*g.inc;
+			int i = (int)(p>>GRANULATOR_FRAC_BITS);
+			double frac = (p & GRANULATOR_FRAC_MASK)*GRANULATOR_FRAC_SCALE;
+			int64_t w = g.winPos + k*g.winInc;
+			int wi = (int)(w>>GRANULATOR_FRAC_BITS);
+			double wfrac = (w & GRANULATOR_FRAC_MASK)*GRANULATOR_FRAC_SCALE;
+			double s = src[i] + frac*(src[i+1]-src[i]);
+			double env = win[wi] + wfrac*(win[wi+1]-win[wi]);
+			v[k] = s*env;
+		}
+		for(int k=0; k<4; k++)
+			L[n+k] += v[k]*g.gainL;
+		if(R != NULL) {
+			for(int k=0; k<4; k++)
+				R[n+k] += v[k]*g.gainR;
+		}
+		g.pos += 4*g.inc;
+		g.winPos += 4*g.winInc;
+	}
+
+	// leftovers
+	for(; n<len; n++) {
+		int i = (int)(g.pos>>GRANULATOR_FRAC_BITS);
+		double frac = (g.pos & GRANULATOR_FRAC_MASK)*GRANULATOR_FRAC_SCALE;
+		int wi = (int)(g.winPos>>GRANULATOR_FRAC_BITS);
+		double wfrac = (g.winPos & GRANULATOR_FRAC_MASK)*GRANULATOR_FRAC_SCALE;
+		double v = (src[i] + frac*(src[i+1]-src[i])) * (win[wi] + wfrac*(win[wi+1]-win[wi]));
+		L[n] += v*g.gainL;
+		if(R != NULL)
+			R[n] += v*g.gainR;
+		g.pos += g.inc;
+		g.winPos += g.winInc;
+	}
+
+	g.remaining -= len;
+	g.offset = 0;
+}
+
+void Granulator::deallocate() {
+	if(grains != NULL) {
+		delete[] grains;
+		grains = NULL;
+	}
+	activeGrains = 0;
+	activeGrainsShared = 0;
+	data.reset();
+}
+
+const double *Granulator::getWindowTable(grainWindow window) {
+	if(window < 0 || window >= grain_windowsNum_)
+		window = grain_hann_;
+	return windowTables[window];
+}
@@ -0,0 +1,363 @@
+/*
+ * Looper.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: live looper, records input into memory allocated and locked at init
+ */
+
+#include "Looper.h"
+
+#include <stdio.h>
+#include <sys/mman.h> // mlock
+#include <algorithm> // min
+
+
+Looper::Looper() {
+	channels = 0;
+	rate = -1;
+	memory = NULL;
+	memoryBytes = 0;
+	locked = false;
+	loop = NULL;
+	tail = NULL;
+	capacity = 0;
+	crossfadeMax = 0;
+	crossfadeLen = 0;
+	tailFilled = 0;
+	mode = looper_stop_;
+	loopLen = 0;
+	pos = 0;
+	baseLen = 0;
+	multiplyArmed = false;
+	multiplyEnding = false;
+	afterMultiply = looper_play_;
+	request = LOOPER_NO_REQUEST;
+	punch = -1;
+	feedback = 1;
+	modeShared = looper_stop_;
+	loopLenShared = 0;
+	posShared = 0;
+}
+
+Looper::~Looper() {
+	deallocate();
+}
+
+int Looper::init(double maxSeconds, int rate, unsigned int periodSize, unsigned short channels, unsigned short inChnOffset, unsigned short outChnOffset,
+				 double level, double crossfadeSeconds) {
+	if(maxSeconds <= 0 || channels == 0) {
+		printf("Looper error! It needs at least one channel and some room to record\n");
+		return -1;
+	}
+
+	deallocate();
+
+	this->channels = channels;
+	this->rate = rate;
+	capacity = maxSeconds*rate;
+	crossfadeMax = (crossfadeSeconds > 0) ? crossfadeSeconds*rate : 0;
+
+	// one block, touched now and locked, so that recording never page faults
+	long chnFrames = capacity+crossfadeMax;
+	memoryBytes = channels*chnFrames*sizeof(double);
+	memory = new double[channels*chnFrames];
+	memset(memory, 0, memoryBytes);
+	locked = (mlock(memory, memoryBytes) == 0);
+	if(!locked)
+		printf("Looper warning! Can't lock %zu bytes in memory, check RLIMIT_MEMLOCK\n", memoryBytes);
+
+	loop = new double *[channels];
+	tail = new double *[channels];
+	for(int c=0; c<channels; c++) {
+		loop[c] = memory + c*chnFrames;
+		tail[c] = loop[c] + capacity;
+	}
+
+	AudioModuleInOut::init(periodSize, channels, inChnOffset, channels, outChnOffset);
+	setLevel(level);
+
+	mode = looper_stop_;
+	loopLen = 0;
+	pos = 0;
+	baseLen = 0;
+	crossfadeLen = 0;
+	tailFilled = 0;
+	multiplyArmed = false;
+	multiplyEnding = false;
+	request = LOOPER_NO_REQUEST;
+	modeShared = mode;
+	loopLenShared = 0;
+	posShared = 0;
+
+	return 0;
+}
+
+double **Looper::getFrameBuffer(int numOfSamples, double **input) {
+	if(memory == NULL)
+		return framebuffer;
+
+	// period is split where mode changes, then each run goes until next edge [loop end, crossfade, punch point...]
+	int n = 0;
+	while(n < numOfSamples) {
+		int len = numOfSamples-n;
+		int req = request.load(std::memory_order_acquire);
+		if(req != LOOPER_NO_REQUEST) {
+			int offset = req>>8;
+			if(offset <= n) {
+				if(request.compare_exchange_strong(req, LOOPER_NO_REQUEST)) {
+					if((req & 0xFF) == LOOPER_RETRIGGER)
+						restart();
+					else
+						applyMode((looperMode)(req & 0xFF));
+				}
+				continue; // if it failed, there is a newer request
+			}
+			len = std::min(len, offset-n);
+		}
+		n += processRun(input, n, len);
+	}
+
+	// requests for later periods get closer
+	int req = request.load(std::memory_order_acquire);
+	while(req != LOOPER_NO_REQUEST && (req>>8) >= numOfSamples) {
+		int moved = (((req>>8)-numOfSamples)<<8) | (req & 0xFF);
+		if(request.compare_exchange_weak(req, moved))
+			break;
+	}
+
+	for(int c=0; c<channels; c++) {
+		double *out = framebuffer[out_chn_offset+c];
+		for(int i=0; i<numOfSamples; i++)
+			out[i] *= level;
+		memset(out+numOfSamples, 0, (period_size-numOfSamples)*sizeof(double)); // reset part of buffer that has been potentially left untouched
+	}
+
+	modeShared = mode;
+	loopLenShared = loopLen;
+	posShared = pos;
+
+	return framebuffer;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+void Looper::applyMode(looperMode newMode) {
+	if(mode == looper_record_ && newMode != looper_record_)
+		finishRecording();
+
+	switch(newMode) {
+		case looper_record_:
+			loopLen = 0;
+			pos = 0;
+			baseLen = 0;
+			crossfadeLen = 0;
+			tailFilled = 0;
+			multiplyArmed = false;
+			multiplyEnding = false;
+			mode = looper_record_;
+			break;
+		case looper_multiply_:
+			if(loopLen == 0)
+				break; // nothing to multiply
+			if(mode == looper_multiply_) {
+				multiplyEnding = false; // changed our mind
+				break;
+			}
+			multiplyArmed = true;
+			mode = looper_multiply_;
+			break;
+		default:
+			// cycle being multiplied is completed first
+			if(mode == looper_multiply_ && !multiplyArmed) {
+				multiplyEnding = true;
+				afterMultiply = newMode;
+				break;
+			}
+			multiplyArmed = false;
+			mode = newMode;
+			break;
+	}
+}
+
+// audio thread side of retrigger()
+void Looper::restart() {
+	// multiply is cut to cycles that have been completed
+	if(mode == looper_multiply_ && !multiplyArmed) {
+		loopLen = std::max(baseLen, (pos/baseLen)*baseLen);
+		multiplyEnding = false;
+		mode = looper_play_;
+	}
+	pos = 0;
+	if(mode == looper_record_)
+		tailFilled = 0;
+}
+
+void Looper::finishRecording() {
+	loopLen = pos;
+	pos = 0;
+	tailFilled = 0;
+	crossfadeLen = std::min((long)crossfadeMax, loopLen/2);
+	mode = (loopLen > 0) ? looper_play_ : looper_stop_;
+}
+
+int Looper::processRun(double **input, int n, int len) {
+	if(mode == looper_record_)
+		return runRecord(input, n, len);
+
+	if(mode == looper_stop_ || loopLen == 0) {
+		captureTail(input, n, len);
+		for(int c=0; c<channels; c++)
+			memset(framebuffer[out_chn_offset+c]+n, 0, len*sizeof(double));
+		return len;
+	}
+
+	return runLoop(input, n, len);
+}
+
+int Looper::runRecord(double **input, int n, int len) {
+	len = std::min((long)len, capacity-pos);
+	for(int c=0; c<channels; c++) {
+		memcpy(loop[c]+pos, input[in_chn_offset+c]+n, len*sizeof(double));
+		memset(framebuffer[out_chn_offset+c]+n, 0, len*sizeof(double)); // monitoring is up to the user
+	}
+	pos += len;
+	if(pos == capacity)
+		finishRecording(); // full, starts playing
+	return len;
+}
+
+int Looper::runLoop(double **input, int n, int len) {
+	// while multiplying, cycles after the first one are copies of the first one
+	bool extending = (mode == looper_multiply_ && !multiplyArmed);
+	long x = extending ? pos%baseLen : pos;
+
+	len = std::min((long)len, loopLen-pos);
+	if(extending)
+		len = std::min((long)len, baseLen-x);
+	if(x < crossfadeLen)
+		len = std::min((long)len, crossfadeLen-x);
+
+	bool write = false;
+	if(mode == looper_overdub_ || (extending && !multiplyEnding))
+		len = limitToPunch(x, len, write);
+
+	captureTail(input, n, len);
+	bool fade = (x < crossfadeLen && x+len <= tailFilled);
+	double fb = feedback.load(std::memory_order_relaxed);
+	double fadeStep = (crossfadeLen > 0) ? 1.0/crossfadeLen : 0;
+
+	for(int c=0; c<channels; c++) {
+		double *out = framebuffer[out_chn_offset+c]+n;
+		const double *in = input[in_chn_offset+c]+n;
+		double *src = loop[c]+x;
+		double *t = tail[c]+x;
+
+		// loop fades in over tail, which is what followed loop end when it was recorded
+		if(fade) {
+			for(int j=0; j<len; j++) {
+				double w = (x+j)*fadeStep;
+				out[j] = t[j] + w*(src[j]-t[j]);
+			}
+		}
+		else
+			memcpy(out, src, len*sizeof(double));
+
+		if(extending) {
+			double *dst = loop[c]+pos; // never overlaps src, at least one cycle ahead
+			if(write) {
+				for(int j=0; j<len; j++)
+					dst[j] = out[j] + in[j];
+			}
+			else
+				memcpy(dst, out, len*sizeof(double));
+		}
+		else if(write) {
+			// into tail too, so that crossfade keeps overdubs at full level
+			for(int j=0; j<len; j++)
+				src[j] = src[j]*fb + in[j];
+			if(fade) {
+				for(int j=0; j<len; j++)
+					t[j] = t[j]*fb + in[j];
+			}
+		}
+	}
+
+	pos += len;
+	if(pos < loopLen)
+		return len;
+
+	// loop end
+	if(mode == looper_multiply_) {
+		if(multiplyArmed) {
+			multiplyArmed = false;
+			baseLen = loopLen; // goes on to first copy, no wrap
+		}
+		else if(multiplyEnding) {
+			multiplyEnding = false;
+			mode = afterMultiply;
+			pos = 0;
+			return len;
+		}
+
+		if(loopLen+baseLen <= capacity)
+			loopLen += baseLen;
+		else {
+			mode = looper_play_; // full
+			pos = 0;
+		}
+		return len;
+	}
+
+	pos = 0;
+	return len;
+}
+
+// first frames that follow recording, by time and not by playhead
+void Looper::captureTail(double **input, int n, int len) {
+	if(tailFilled >= crossfadeLen)
+		return;
+	int num = std::min(len, crossfadeLen-tailFilled);
+	for(int c=0; c<channels; c++)
+		memcpy(tail[c]+tailFilled, input[in_chn_offset+c]+n, num*sizeof(double));
+	tailFilled += num;
+}
+
+int Looper::limitToPunch(long x, int len, bool &write) {
+	int64_t p = punch.load(std::memory_order_relaxed);
+	if(p < 0) {
+		write = true;
+		return len;
+	}
+	long punchIn = p>>32;
+	long punchOut = p & 0xFFFFFFFF;
+	if(x < punchIn) {
+		write = false;
+		return std::min((long)len, punchIn-x);
+	}
+	if(x < punchOut) {
+		write = true;
+		return std::min((long)len, punchOut-x);
+	}
+	write = false;
+	return len;
+}
+
+void Looper::deallocate() {
+	if(memory != NULL) {
+		if(locked)
+			munlock(memory, memoryBytes);
+		delete[] memory;
+		memory = NULL;
+	}
+	locked = false;
+	if(loop != NULL) {
+		delete[] loop;
+		loop = NULL;
+	}
+	if(tail != NULL) {
+		delete[] tail;
+		tail = NULL;
+	}
+}
@@ -0,0 +1,161 @@
+/*
+ * MultiAudioFile.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: multichannel audio file player, each file channel goes to its own output
+ */
+
+#include "MultiAudioFile.h"
+
+#include <stdio.h>
+#include <algorithm> // min
+
+
+MultiAudioFile::MultiAudioFile() {
+	planes = NULL;
+	fileChannels = 0;
+	frameNum = 0;
+	advType = adv_loop_;
+	currentFrame = 0;
+	direction = 1;
+	isPlaying = false;
+	segments = NULL;
+	segmentsNum = 0;
+}
+
+MultiAudioFile::MultiAudioFile(advanceType adv) : MultiAudioFile() {
+	advType = adv;
+}
+
+MultiAudioFile::~MultiAudioFile() {
+	deallocate();
+}
+
+int MultiAudioFile::init(std::string filename, int rate, unsigned int periodSize, double level, unsigned short outChannels, unsigned short outChnOffset) {
+	deallocate();
+
+	int retval = AudioFile::loadChannels(filename, rate, channels);
+	if(retval != 0)
+		return retval;
+
+	fileChannels = channels.size();
+	frameNum = channels[0]->frames;
+	planes = new double *[fileChannels];
+	for(int c=0; c<fileChannels; c++)
+		planes[c] = channels[c]->samples;
+
+	if(outChannels == 0)
+		outChannels = fileChannels;
+	AudioModuleOut::init(periodSize, outChannels, outChnOffset);
+	setLevel(level);
+
+	// worst case, file shorter than period
+	segments = new PlaybackSegment[periodSize+2];
+
+	direction = 1;
+	currentFrame = 0;
+	isPlaying = true; // starts playing
+
+	return 0;
+}
+
+double **MultiAudioFile::getFrameBuffer(int numOfSamples) {
+	if(!isPlaying) {
+		for(int chn=0; chn<out_channels; chn++)
+			memset(framebuffer[out_chn_offset+chn], 0, period_size*sizeof(double));
+		return framebuffer;
+	}
+
+	computeSegments(numOfSamples);
+
+	// same path on every channel, single pass per channel
+	for(int chn=0; chn<out_channels; chn++) {
+		double *out = framebuffer[out_chn_offset+chn];
+		const double *plane = planes[chn%fileChannels];
+		int n = 0;
+		for(int s=0; s<segmentsNum; s++) {
+			const PlaybackSegment &seg = segments[s];
+			if(seg.direction == 1) {
+				const double *src = plane+seg.start;
+				for(int i=0; i<seg.len; i++)
+					out[n+i] = src[i]*level;
+			}
+			else if(seg.direction == -1) {
+				const double *src = plane+seg.start;
+				for(int i=0; i<seg.len; i++)
+					out[n+i] = src[-i]*level;
+			}
+			else
+				memset(out+n, 0, seg.len*sizeof(double));
+			n += seg.len;
+		}
+		memset(out+numOfSamples, 0, (period_size-numOfSamples)*sizeof(double)); // reset part of buffer that has been potentially left untouched
+	}
+
+	return framebuffer;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// moves playhead through period, same turns that Waveform takes at the edges
+void MultiAudioFile::computeSegments(int numOfSamples) {
+	segmentsNum = 0;
+	int remaining = numOfSamples;
+	while(remaining > 0) {
+		PlaybackSegment &seg = segments[segmentsNum++];
+
+		if(advType == adv_oneShot_) {
+			if(currentFrame >= frameNum) {
+				seg.start = 0;
+				seg.len = remaining;
+				seg.direction = 0;
+				isPlaying = false;
+				break;
+			}
+			seg.start = currentFrame;
+			seg.len = std::min((long)remaining, frameNum-currentFrame);
+			seg.direction = 1;
+			currentFrame += seg.len;
+		}
+		else if(advType == adv_backAndForth_ && direction == -1) {
+			seg.start = currentFrame;
+			seg.len = std::min((long)remaining, currentFrame+1);
+			seg.direction = -1;
+			currentFrame -= seg.len;
+			if(currentFrame < 0) {
+				currentFrame = (frameNum > 1) ? 1 : 0;
+				direction = 1;
+			}
+		}
+		else {
+			seg.start = currentFrame;
+			seg.len = std::min((long)remaining, frameNum-currentFrame);
+			seg.direction = 1;
+			currentFrame += seg.len;
+			if(currentFrame >= frameNum) {
+				if(advType == adv_loop_)
+					currentFrame = 0;
+				else {
+					currentFrame = (frameNum > 1) ? frameNum-2 : 0; // last frame is not repeated
+					direction = -1;
+				}
+			}
+		}
+		remaining -= seg.len;
+	}
+}
+
+void MultiAudioFile::deallocate() {
+	if(planes != NULL) {
+		delete[] planes;
+		planes = NULL;
+	}
+	if(segments != NULL) {
+		delete[] segments;
+		segments = NULL;
+	}
+	channels.clear();
+	isPlaying = false;
+}
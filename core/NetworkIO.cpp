@@ -0,0 +1,221 @@
+/*
+ * NetworkIO.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: one network thread for all receiving sockets, epoll plus batched reads
+ */
+
+#include "NetworkIO.h"
+#include "priority_utils.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h> // memset
+#include <unistd.h> // close
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <pthread.h>
+#include <map>
+#include <mutex>
+#include <atomic>
+
+
+// same default as OSC threads
+int NetworkIO::prioNetwork = 10;
+
+// shared by all sockets
+struct NetworkState {
+	int epollFd;
+	int wakeFd; // eventfd, tells thread to stop
+	pthread_t thread;
+	int prio; // copied when thread starts
+	bool running;
+	std::mutex handlersMutex; // held by network thread while it dispatches, so that handlers can be safely removed
+	std::map<int, NetworkHandler *> handlers;
+	std::atomic<unsigned int> droppedPackets;
+
+	// network thread only
+	char batchBuffers[NETWORK_IO_BATCH][NETWORK_IO_MAX_DATAGRAM];
+	struct iovec batchIovecs[NETWORK_IO_BATCH];
+	struct mmsghdr batchHeaders[NETWORK_IO_BATCH];
+};
+
+// built on first use and never destroyed, servers may remove their sockets during static destruction
+static NetworkState &getState() {
+	static NetworkState *state = NULL;
+	static std::once_flag created;
+	std::call_once(created, [] {
+		state = new NetworkState();
+		state->epollFd = -1;
+		state->wakeFd = -1;
+		state->running = false;
+		state->droppedPackets = 0;
+		for(int i=0; i<NETWORK_IO_BATCH; i++) {
+			state->batchIovecs[i].iov_base = state->batchBuffers[i];
+			state->batchIovecs[i].iov_len = NETWORK_IO_MAX_DATAGRAM;
+		}
+	});
+	return *state;
+}
+
+
+int NetworkIO::addSocket(int fd, NetworkHandler *handler) {
+	if(fd < 0 || handler == NULL) {
+		printf("NetworkIO error! Socket %d or its handler is not valid\n", fd);
+		return -1;
+	}
+
+	NetworkState &state = getState();
+	std::lock_guard<std::mutex> lock(state.handlersMutex);
+
+	if(!state.running && startThread() != 0)
+		return -1;
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+	if(epoll_ctl(state.epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+		printf("NetworkIO error! Can't watch socket %d, errno: %d\n", fd, errno);
+		return -1;
+	}
+	state.handlers[fd] = handler;
+
+	return 0;
+}
+
+void NetworkIO::removeSocket(int fd) {
+	NetworkState &state = getState();
+	std::lock_guard<std::mutex> lock(state.handlersMutex);
+	if(state.handlers.erase(fd) == 0)
+		return;
+	epoll_ctl(state.epollFd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+void NetworkIO::setPriority(int prio) {
+	NetworkState &state = getState();
+	std::lock_guard<std::mutex> lock(state.handlersMutex);
+	prioNetwork = prio;
+}
+
+void NetworkIO::shutdown() {
+	NetworkState &state = getState();
+	{
+		std::lock_guard<std::mutex> lock(state.handlersMutex);
+		if(!state.running)
+			return;
+		state.running = false;
+	}
+
+	uint64_t one = 1;
+	if(write(state.wakeFd, &one, sizeof(one)) != sizeof(one))
+		printf("NetworkIO error! Can't wake up network thread, errno: %d\n", errno);
+	pthread_join(state.thread, NULL);
+
+	std::lock_guard<std::mutex> lock(state.handlersMutex);
+	state.handlers.clear();
+	close(state.epollFd); // sockets are not watched anymore
+	close(state.wakeFd);
+	state.epollFd = -1;
+	state.wakeFd = -1;
+}
+
+unsigned int NetworkIO::getDroppedPackets() {
+	return getState().droppedPackets.load();
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// with handlers locked
+int NetworkIO::startThread() {
+	NetworkState &state = getState();
+
+	state.epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if(state.epollFd < 0) {
+		printf("NetworkIO error! Can't create epoll instance, errno: %d\n", errno);
+		return -1;
+	}
+	state.wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = state.wakeFd;
+	if(state.wakeFd < 0 || epoll_ctl(state.epollFd, EPOLL_CTL_ADD, state.wakeFd, &event) != 0) {
+		printf("NetworkIO error! Can't create wake up event, errno: %d\n", errno);
+		if(state.wakeFd >= 0)
+			close(state.wakeFd);
+		close(state.epollFd);
+		state.epollFd = state.wakeFd = -1;
+		return -1;
+	}
+
+	state.prio = prioNetwork;
+	state.running = true;
+	if(pthread_create(&state.thread, NULL, networkLoop, &state) != 0) {
+		printf("NetworkIO error! Can't start network thread\n");
+		state.running = false;
+		close(state.wakeFd);
+		close(state.epollFd);
+		state.epollFd = state.wakeFd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+// reads whole batches until socket is empty, or it has had its share
+void NetworkIO::drainSocket(int fd, NetworkHandler *handler) {
+	NetworkState &state = getState();
+	for(int b=0; b<NETWORK_IO_MAX_BATCHES; b++) {
+		for(int i=0; i<NETWORK_IO_BATCH; i++) {
+			memset(&state.batchHeaders[i].msg_hdr, 0, sizeof(state.batchHeaders[i].msg_hdr));
+			state.batchHeaders[i].msg_hdr.msg_iov = &state.batchIovecs[i];
+			state.batchHeaders[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int received = recvmmsg(fd, state.batchHeaders, NETWORK_IO_BATCH, MSG_DONTWAIT, NULL);
+		if(received <= 0)
+			return; // empty [EAGAIN] or error, epoll tells us if there is more
+
+		for(int i=0; i<received; i++) {
+			if(state.batchHeaders[i].msg_hdr.msg_flags & MSG_TRUNC)
+				state.droppedPackets++;
+			else
+				handler->receivePacket(state.batchBuffers[i], state.batchHeaders[i].msg_len);
+		}
+
+		if(received < NETWORK_IO_BATCH)
+			return;
+	}
+}
+
+void *NetworkIO::networkLoop(void *arg) {
+	NetworkState &state = *(NetworkState *)arg;
+	if(state.prio >= 0)
+		set_priority(state.prio);
+
+	struct epoll_event events[NETWORK_IO_MAX_EVENTS];
+	while(true) {
+		int ready = epoll_wait(state.epollFd, events, NETWORK_IO_MAX_EVENTS, -1);
+		if(ready < 0) {
+			if(errno == EINTR)
+				continue;
+			printf("NetworkIO error! Network thread stops, epoll failed with errno: %d\n", errno);
+			return NULL;
+		}
+
+		std::lock_guard<std::mutex> lock(state.handlersMutex);
+		if(!state.running)
+			return NULL; // shutdown() woke us up
+		for(int i=0; i<ready; i++) {
+			// socket may have been removed after epoll_wait returned
+			std::map<int, NetworkHandler *>::iterator it = state.handlers.find(events[i].data.fd);
+			if(it != state.handlers.end())
+				drainSocket(it->first, it->second);
+		}
+	}
+
+	return NULL;
+}
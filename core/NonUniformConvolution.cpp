@@ -0,0 +1,264 @@
+/*
+ * NonUniformConvolution.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: non uniformly partitioned convolution, head on the caller's thread and tail stages on background threads
+ *                partitioning follows the classic scheme by W. G. Gardner, "Efficient convolution without input-output delay", 1995
+ */
+
+#include "NonUniformConvolution.h"
+#include "priority_utils.h"
+
+#include <stdio.h>
+#include <cstring> // memcpy, memset
+
+#define NUC_MAX_STAGES 16
+
+// below the audio thread, stage s runs at prioTail+s [longer deadlines, lower priority]
+int NonUniformConvolution::prioTail = 5;
+
+
+NonUniformConvolution::NonUniformConvolution() {
+	blockSize = 0;
+	stages = NULL;
+	stagesNum = 0;
+	time = 0;
+	stopStages = false;
+	missedDeadlines = 0;
+	droppedBlocks = 0;
+}
+
+NonUniformConvolution::~NonUniformConvolution() {
+	deallocate();
+}
+
+int NonUniformConvolution::init(double *ir, int irLen, int blockSize, fft_planning planning) {
+	if(blockSize <= 0 || irLen <= 0) {
+		printf("NonUniformConvolution error! Block size %d and impulse response length %d must be positive\n", blockSize, irLen);
+		return -1;
+	}
+
+	deallocate();
+
+	this->blockSize = blockSize;
+	time = 0;
+	missedDeadlines = 0;
+	droppedBlocks = 0;
+
+	// head covers up to where first stage starts, i.e., twice its partition
+	int headLen = 2*NUC_GROWTH*blockSize;
+	if(headLen > irLen || NUC_GROWTH*blockSize > NUC_MAX_BLOCK)
+		headLen = irLen; // short response or long blocks, no tail
+	if(head.init(ir, headLen, blockSize, planning) != 0)
+		return -1;
+
+	// lay out stages, each starts at twice its partition and ends where next one starts
+	int stageBlocks[NUC_MAX_STAGES];
+	int stageOffsets[NUC_MAX_STAGES];
+	int stageEnds[NUC_MAX_STAGES];
+	int offset = headLen;
+	int stageBlock = NUC_GROWTH*blockSize;
+	stagesNum = 0;
+	while(offset < irLen && stagesNum < NUC_MAX_STAGES) {
+		bool last = (stageBlock*NUC_GROWTH > NUC_MAX_BLOCK);
+		int end = last ? irLen : 2*NUC_GROWTH*stageBlock;
+		if(end > irLen)
+			end = irLen;
+
+		stageBlocks[stagesNum] = stageBlock;
+		stageOffsets[stagesNum] = offset;
+		stageEnds[stagesNum] = end;
+		stagesNum++;
+
+		offset = end;
+		stageBlock *= NUC_GROWTH;
+	}
+	if(stagesNum == 0)
+		return 0;
+
+	stopStages = false;
+	stages = new NonUniformStage[stagesNum];
+	for(int s=0; s<stagesNum; s++) {
+		NonUniformStage *stage = &stages[s];
+		stage->owner = this;
+		stage->blockSize = stageBlocks[s];
+		stage->offset = stageOffsets[s];
+		if(stage->convolution.init(ir+stageOffsets[s], stageEnds[s]-stageOffsets[s], stageBlocks[s], planning) != 0) {
+			stagesNum = s; // only these have threads to stop
+			deallocate();
+			return -1;
+		}
+
+		for(int i=0; i<NUC_SLOTS; i++) {
+			stage->inSlots[i] = new double[stage->blockSize];
+			stage->outSlots[i] = new double[stage->blockSize];
+			memset(stage->inSlots[i], 0, stage->blockSize*sizeof(double));
+			memset(stage->outSlots[i], 0, stage->blockSize*sizeof(double));
+			stage->slotBlock[i] = -1;
+		}
+		stage->zeros = new double[stage->blockSize];
+		memset(stage->zeros, 0, stage->blockSize*sizeof(double));
+		stage->handedOff = 0;
+		stage->completed = 0;
+		stage->resetFrom = 0;
+		stage->fill = 0;
+		stage->writable = true;
+		stage->lastMissed = -1;
+		stage->prio = (prioTail >= 0) ? prioTail+s : -1;
+
+		sem_init(&stage->start, 0, 0);
+		pthread_create(&stage->thread, NULL, stageLoop, stage);
+	}
+
+	return 0;
+}
+
+void NonUniformConvolution::process(double *in, double *out, int numOfSamples) {
+	head.process(in, out, numOfSamples);
+
+	for(int s=0; s<stagesNum; s++) {
+		readStage(&stages[s], out, numOfSamples);
+		feedStage(&stages[s], in, numOfSamples);
+	}
+
+	time += numOfSamples;
+}
+
+// meant to be called from the audio thread, like process()
+void NonUniformConvolution::reset() {
+	head.reset();
+
+	for(int s=0; s<stagesNum; s++) {
+		NonUniformStage *stage = &stages[s];
+		long block = time/stage->blockSize;
+
+		// block being filled restarts from silence, older blocks in flight are ignored
+		// stage's thread clears the convolution state before processing this block
+		if(stage->writable)
+			memset(stage->inSlots[block%NUC_SLOTS], 0, stage->fill*sizeof(double));
+		stage->resetFrom.store(block, std::memory_order_release);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// accumulates input and hands off complete blocks, never waits
+void NonUniformConvolution::feedStage(NonUniformStage *stage, double *in, int numOfSamples) {
+	int done = 0;
+	while(done < numOfSamples) {
+		long block = (time+done)/stage->blockSize;
+		int slot = block%NUC_SLOTS;
+
+		// slot is still in use if thread did not get to the block that used it last
+		if(stage->fill == 0)
+			stage->writable = (block - stage->completed.load(std::memory_order_acquire) < NUC_SLOTS);
+
+		int len = stage->blockSize - stage->fill;
+		if(len > numOfSamples-done)
+			len = numOfSamples-done;
+		if(stage->writable)
+			memcpy(stage->inSlots[slot]+stage->fill, in+done, len*sizeof(double));
+		stage->fill += len;
+		done += len;
+
+		if(stage->fill == stage->blockSize) {
+			if(stage->writable)
+				stage->slotBlock[slot].store(block, std::memory_order_release);
+			else
+				droppedBlocks++; // thread will use silence in its place, to stay aligned
+			stage->handedOff.store(block+1, std::memory_order_release);
+			sem_post(&stage->start);
+			stage->fill = 0;
+		}
+	}
+}
+
+// adds stage's output, if ready
+void NonUniformConvolution::readStage(NonUniformStage *stage, double *out, int numOfSamples) {
+	int done = 0;
+	if(time < stage->offset) {
+		done = stage->offset - time; // nothing from this stage yet
+		if(done >= numOfSamples)
+			return;
+	}
+
+	long resetFrom = stage->resetFrom.load(std::memory_order_relaxed); // only written by this thread
+	while(done < numOfSamples) {
+		long pos = time + done - stage->offset;
+		long block = pos/stage->blockSize;
+		int blockPos = pos%stage->blockSize;
+		int len = stage->blockSize - blockPos;
+		if(len > numOfSamples-done)
+			len = numOfSamples-done;
+
+		if(block >= resetFrom) {
+			if(stage->completed.load(std::memory_order_acquire) > block) {
+				double *result = stage->outSlots[block%NUC_SLOTS] + blockPos;
+				for(int n=0; n<len; n++)
+					out[done+n] += result[n];
+			}
+			else if(stage->lastMissed != block) {
+				missedDeadlines++;
+				stage->lastMissed = block;
+			}
+		}
+		done += len;
+	}
+}
+
+void NonUniformConvolution::deallocate() {
+	if(stages != NULL) {
+		stopStages = true;
+		for(int s=0; s<stagesNum; s++) {
+			sem_post(&stages[s].start);
+			pthread_join(stages[s].thread, NULL);
+			sem_destroy(&stages[s].start);
+		}
+		for(int s=0; s<stagesNum; s++) {
+			for(int i=0; i<NUC_SLOTS; i++) {
+				delete[] stages[s].inSlots[i];
+				delete[] stages[s].outSlots[i];
+			}
+			delete[] stages[s].zeros;
+		}
+		delete[] stages;
+		stages = NULL;
+	}
+	stagesNum = 0;
+}
+
+// processes handed off blocks in order, as soon as they come
+void *NonUniformConvolution::stageLoop(void *arg) {
+	NonUniformStage *stage = (NonUniformStage *)arg;
+	NonUniformConvolution *owner = stage->owner;
+
+	if(stage->prio >= 0)
+		set_priority(stage->prio);
+
+	long next = 0;
+	long appliedReset = 0;
+	while(true) {
+		sem_wait(&stage->start);
+		if(owner->stopStages)
+			break;
+
+		long handedOff = stage->handedOff.load(std::memory_order_acquire);
+		while(next < handedOff && !owner->stopStages) {
+			long resetFrom = stage->resetFrom.load(std::memory_order_acquire);
+			if(next >= resetFrom && appliedReset < resetFrom) {
+				stage->convolution.reset();
+				appliedReset = resetFrom;
+			}
+
+			int slot = next%NUC_SLOTS;
+			double *in = (stage->slotBlock[slot].load(std::memory_order_acquire) == next) ? stage->inSlots[slot] : stage->zeros;
+			stage->convolution.process(in, stage->outSlots[slot], stage->blockSize);
+
+			stage->completed.store(next+1, std::memory_order_release);
+			next++;
+		}
+	}
+	return (void *)0;
+}
@@ -29,9 +29,27 @@
 //VIC
 #include "priority_utils.h"
 
-bool OSCClient::shouldStop = false;
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <time.h>
+#include <math.h>
+
 int OSCClient::prioSendThread = -1;
 
+static double monotonicSeconds(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// FNV-1a
+static unsigned int hashAddress(const char *address){
+    unsigned int h = 2166136261u;
+    for (; *address; address++)
+        h = (h ^ (unsigned char)*address) * 16777619u;
+    return h;
+}
+
 
 OSCClient::OSCClient(){
 	//VIC
@@ -39,41 +57,87 @@ OSCClient::OSCClient(){
 	port = -1;
 	address = NULL;
 	sendThread = -1;
+	sendThreadStarted = false;
 	verbose = 0;
+	shouldStop = false;
+	wakePending = false;
+	wakeFd = -1;
+	rateWindow = OSC_CLIENT_DEFAULT_WINDOW;
+	droppedMessages = 0;
+	addresses = NULL;
+	bundleSize = 0;
 }
 
 //VIC
 OSCClient::~OSCClient() {
-	shouldStop = true;
+	if (sendThreadStarted){
+		shouldStop = true;
+		uint64_t one = 1;
+		if (::write(wakeFd, &one, sizeof(one)) < 0)
+			printf("OSCClient: can't wake up send thread\n");
+		pthread_join(sendThread, NULL); // last queued messages are sent
+	}
+	if (wakeFd >= 0)
+		::close(wakeFd);
+	if (addresses != NULL)
+		delete[] addresses;
 }
 
+// sleeps until something is queued or a coalesced address is due, no polling
 void *OSCClient::sendQueue(void* ptr){
 	OSCClient *instance = (OSCClient*)ptr;
 
 	//VIC Set Priority
 	set_priority(prioSendThread, instance->verbose);
 
+	int timeout = -1;
+	while(!instance->shouldStop){
+		struct pollfd pfd;
+		pfd.fd = instance->wakeFd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		poll(&pfd, 1, timeout);
 
-    while(!shouldStop){
-        instance->queueSend();
-        usleep(1000);
-    }
-    return (void *)0;
+		uint64_t count;
+		if (::read(instance->wakeFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+			printf("OSCClient: error while reading wake up event, errno: %d\n", errno);
+		instance->wakePending = false; // before draining, so that later messages wake us up again
+
+		timeout = instance->queueSend();
+	}
+	instance->rateWindow = 0;
+	instance->queueSend(); // leftovers
+	return (void *)0;
 }
 
-void OSCClient::setup(int _port, const char* _address/*, bool scheduleTask VIC*/, int prio){
+void OSCClient::setup(int _port, const char* _address/*, bool scheduleTask VIC*/, int prio, int slots){
     address = _address;
     port = _port;
 
     socket.setServer(address);
 	socket.setPort(port);
 
+	outQueue.init(slots); // all memory allocated here, nothing is allocated when sending
+	addresses = new OSCCoalescedAddress[OSC_CLIENT_MAX_ADDRESSES];
+	for (int i=0; i<OSC_CLIENT_MAX_ADDRESSES; i++){
+		addresses[i].used = false;
+		addresses[i].pending = false;
+	}
+	bundleSize = 0;
+
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wakeFd < 0){
+		printf("OSCClient error! Can't create wake up event, errno: %d\n", errno);
+		return;
+	}
+
 	/*VIC
 	 if (scheduleTask)
     	createAuxTasks();*/
 	prioSendThread = prio; //VIC
+	shouldStop = false;
 	pthread_create(&sendThread, NULL, sendQueue, this);
-
+	sendThreadStarted = true;
 }
 
 /*VIC
@@ -84,21 +148,28 @@ void OSCClient::createAuxTasks(){
     Bela_scheduleAuxiliaryTask(OSCSendTask);
 }*/
 
-void OSCClient::queueMessage(oscpkt::Message msg){
-    outQueue.push(msg);
-}
+bool OSCClient::queueMessage(const OSCOutMessage &msg, bool coalesce){
+    int size = msg.getSize();
+    if (size < 0 || size > OSC_OUT_MESSAGE_MAX_BYTES)
+        return false;
 
-void OSCClient::queueSend(){
-    if (!outQueue.empty()){
-        pw.init().startBundle();
-        while(!outQueue.empty()){
-            pw.addMessage(outQueue.front());
-            outQueue.pop();
-        }
-        pw.endBundle();
-        outBuffer = pw.packetData();
-        socket.send(outBuffer, pw.packetSize());
+    unsigned int ticket;
+    OSCOutSlot *slot = outQueue.getWriteSlot(ticket);
+    if (slot == NULL){
+        droppedMessages++;
+        return false;
     }
+    slot->size = msg.serialize(slot->data, OSC_OUT_MESSAGE_MAX_BYTES); // straight into the slot
+    slot->coalesce = coalesce;
+    outQueue.push(ticket);
+    wake();
+    return true;
+}
+
+bool OSCClient::queueMessage(oscpkt::Message msg, bool coalesce){
+    oscpkt::PacketWriter writer;
+    writer.init().addMessage(msg);
+    return queueBinary(writer.packetData(), writer.packetSize(), coalesce);
 }
 
 void OSCClient::sendMessageNow(oscpkt::Message msg){
@@ -107,6 +178,205 @@ void OSCClient::sendMessageNow(oscpkt::Message msg){
     socket.send(outBuffer, pw.packetSize());
 }
 
+//----------------------------------------------------------------------------------------------------------------------------
+// private methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+bool OSCClient::queueBinary(const char *data, int size, bool coalesce){
+    if (data == NULL || size <= 0 || size > OSC_OUT_MESSAGE_MAX_BYTES)
+        return false;
+
+    unsigned int ticket;
+    OSCOutSlot *slot = outQueue.getWriteSlot(ticket);
+    if (slot == NULL){
+        droppedMessages++;
+        return false;
+    }
+    memcpy(slot->data, data, size);
+    slot->size = size;
+    slot->coalesce = coalesce;
+    outQueue.push(ticket);
+    wake();
+    return true;
+}
+
+// one system call until the send thread runs again, however many messages are queued
+void OSCClient::wake(){
+    if (wakeFd < 0 || wakePending.exchange(true))
+        return;
+    uint64_t one = 1;
+    if (::write(wakeFd, &one, sizeof(one)) < 0)
+        wakePending = false;
+}
+
+// send thread, drains queue then sends addresses whose window is over
+int OSCClient::queueSend(){
+    double now = monotonicSeconds();
+    double window = rateWindow;
+
+    OSCOutSlot *slot;
+    while ((slot = outQueue.getReadSlot()) != NULL){
+        if (slot->coalesce && window > 0)
+            coalesce(slot, now);
+        else
+            addToBundle(slot->data, slot->size);
+        outQueue.pop();
+    }
+
+    double next = -1;
+    for (int i=0; i<OSC_CLIENT_MAX_ADDRESSES; i++){
+        OSCCoalescedAddress &entry = addresses[i];
+        if (!entry.pending)
+            continue;
+        if (entry.nextSend <= now || window == 0){
+            addToBundle(entry.data, entry.size);
+            entry.pending = false;
+            entry.nextSend = now + window;
+        }
+        else if (next < 0 || entry.nextSend < next)
+            next = entry.nextSend;
+    }
+    sendBundle();
+
+    return (next < 0) ? -1 : (int)ceil((next-now)*1000);
+}
+
+// keeps only latest message to each address, new addresses can be sent right away
+void OSCClient::coalesce(const OSCOutSlot *slot, double now){
+    unsigned int h = hashAddress(slot->data);
+    for (int probe=0; probe<OSC_CLIENT_MAX_ADDRESSES; probe++){
+        OSCCoalescedAddress &entry = addresses[(h+probe) % OSC_CLIENT_MAX_ADDRESSES];
+        if (entry.used && strcmp(entry.data, slot->data) != 0)
+            continue;
+        if (!entry.used){
+            entry.used = true;
+            entry.nextSend = now;
+        }
+        memcpy(entry.data, slot->data, slot->size);
+        entry.size = slot->size;
+        entry.pending = true;
+        return;
+    }
+    addToBundle(slot->data, slot->size); // table is full, no coalescing
+}
+
+void OSCClient::addToBundle(const char *data, int size){
+    // bundle header is 16 bytes, each element has its size in front
+    if (16+4+size > OSC_CLIENT_MTU){
+        socket.send((void *)data, size); // too big to share a datagram
+        return;
+    }
+    if (bundleSize+4+size > OSC_CLIENT_MTU)
+        sendBundle();
+    if (bundleSize == 0){
+        memcpy(bundle, "#bundle", 8);
+        oscpkt::pod2bytes<uint64_t>(1, bundle+8); // immediately
+        bundleSize = 16;
+    }
+    oscpkt::pod2bytes<int32_t>(size, bundle+bundleSize);
+    memcpy(bundle+bundleSize+4, data, size);
+    bundleSize += 4+size;
+}
+
+void OSCClient::sendBundle(){
+    if (bundleSize == 0)
+        return;
+    if (socket.send(bundle, bundleSize) < 0 && verbose)
+        printf("OSCClient: error while sending to %s:%d, errno: %d\n", address, port, errno);
+    bundleSize = 0;
+}
+
+// OSCOutMessage
+OSCOutMessage::OSCOutMessage(){
+    addressLen = 0;
+    argsNum = 0;
+    argsSize = 0;
+    ok = false;
+}
+
+OSCOutMessage& OSCOutMessage::to(const char *addr){
+    addressLen = strlen(addr);
+    ok = (addressLen > 0 && addressLen < OSC_OUT_MESSAGE_MAX_BYTES && addr[0] == '/');
+    if (ok)
+        memcpy(address, addr, addressLen);
+    argsNum = 0;
+    argsSize = 0;
+    return *this;
+}
+
+bool OSCOutMessage::reserve(int size){
+    if (!ok || argsNum == OSC_OUT_MAX_ARGS || argsSize+size > OSC_OUT_MESSAGE_MAX_BYTES)
+        ok = false;
+    return ok;
+}
+
+OSCOutMessage& OSCOutMessage::add(int in){
+    if (reserve(4)){
+        typeTags[argsNum++] = 'i';
+        oscpkt::pod2bytes<int32_t>(in, args+argsSize);
+        argsSize += 4;
+    }
+    return *this;
+}
+
+OSCOutMessage& OSCOutMessage::add(float in){
+    if (reserve(4)){
+        typeTags[argsNum++] = 'f';
+        oscpkt::pod2bytes<float>(in, args+argsSize);
+        argsSize += 4;
+    }
+    return *this;
+}
+
+OSCOutMessage& OSCOutMessage::add(double in){
+    return add((float)in);
+}
+
+OSCOutMessage& OSCOutMessage::add(bool in){
+    if (reserve(0))
+        typeTags[argsNum++] = in ? 'T' : 'F';
+    return *this;
+}
+
+OSCOutMessage& OSCOutMessage::add(const char *in){
+    int len = strlen(in);
+    int padded = oscpkt::ceil4(len+1);
+    if (reserve(padded)){
+        typeTags[argsNum++] = 's';
+        memcpy(args+argsSize, in, len);
+        memset(args+argsSize+len, 0, padded-len);
+        argsSize += padded;
+    }
+    return *this;
+}
+
+int OSCOutMessage::getSize() const{
+    if (!ok)
+        return -1;
+    return oscpkt::ceil4(addressLen+1) + oscpkt::ceil4(argsNum+2) + argsSize;
+}
+
+// address and type tags are zero terminated and padded to 4 bytes
+int OSCOutMessage::serialize(char *dest, int maxSize) const{
+    int size = getSize();
+    if (size < 0 || size > maxSize)
+        return -1;
+    int pos = 0;
+    int padded = oscpkt::ceil4(addressLen+1);
+    memcpy(dest, address, addressLen);
+    memset(dest+addressLen, 0, padded-addressLen);
+    pos += padded;
+
+    padded = oscpkt::ceil4(argsNum+2);
+    dest[pos] = ',';
+    memcpy(dest+pos+1, typeTags, argsNum);
+    memset(dest+pos+1+argsNum, 0, padded-1-argsNum);
+    pos += padded;
+
+    memcpy(dest+pos, args, argsSize);
+    return size;
+}
+
 // OSCMessageFactory
 OSCMessageFactory& OSCMessageFactory::to(std::string addr){
     msg.init(addr);
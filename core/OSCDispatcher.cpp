@@ -0,0 +1,204 @@
+/*
+ * OSCDispatcher.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: routes received OSC messages to module parameters, off the audio thread
+ */
+
+#include "OSCDispatcher.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm> // lower_bound
+
+
+OSCParamQueue::OSCParamQueue() {
+	droppedEvents = 0;
+	init();
+}
+
+int OSCParamQueue::init(int slots) {
+	if(slots < 1) {
+		printf("OSCParamQueue error! It needs at least one slot, %d were requested\n", slots);
+		return -1;
+	}
+	ring.init(slots);
+	droppedEvents = 0;
+	return 0;
+}
+
+bool OSCParamQueue::push(int paramId, double value, uint64_t timeTag) {
+	OSCParamEvent *event = ring.getWriteSlot();
+	if(event == NULL) {
+		droppedEvents++;
+		return false;
+	}
+	event->paramId = paramId;
+	event->value = value;
+	event->timeTag = timeTag;
+	ring.push();
+	return true;
+}
+
+
+OSCRouteNode::~OSCRouteNode() {
+	for(OSCRouteNode *child : literals)
+		delete child;
+	for(OSCRouteNode *child : patterns)
+		delete child;
+}
+
+
+// for binary search among literal children
+static bool segmentLess(const OSCRouteNode *node, const char *segment) {
+	return strcmp(node->segment.c_str(), segment) < 0;
+}
+
+OSCDispatcher::OSCDispatcher() {
+}
+
+OSCDispatcher::~OSCDispatcher() {
+	clearRoutes();
+}
+
+int OSCDispatcher::addRoute(std::string address, OSCParamQueue *target, int paramId, int argIndex) {
+	if(target == NULL || argIndex < 0) {
+		printf("OSCDispatcher error! Route %s needs a target and a valid argument index\n", address.c_str());
+		return -1;
+	}
+	if(address.size() < 2 || address[0] != '/' || address.back() == '/' || address.find("//") != std::string::npos) {
+		printf("OSCDispatcher error! Address %s is not valid, it must start with a slash and have no empty parts\n", address.c_str());
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lock(routesMutex);
+
+	// walks down the trie, adding missing parts
+	OSCRouteNode *node = &root;
+	size_t start = 1;
+	while(start <= address.size()) {
+		size_t end = address.find('/', start);
+		if(end == std::string::npos)
+			end = address.size();
+		std::string segment = address.substr(start, end-start);
+		if(segment.size() >= OSC_SEGMENT_MAX_LEN) {
+			printf("OSCDispatcher error! Part %s of address %s is too long\n", segment.c_str(), address.c_str());
+			return -1;
+		}
+
+		std::vector<OSCRouteNode *> &children = hasWildcards(segment.c_str()) ? node->patterns : node->literals;
+		std::vector<OSCRouteNode *>::iterator it = std::lower_bound(children.begin(), children.end(), segment.c_str(), segmentLess);
+		if(it == children.end() || (*it)->segment != segment) {
+			OSCRouteNode *child = new OSCRouteNode();
+			child->segment = segment;
+			it = children.insert(it, child);
+		}
+		node = *it;
+		start = end+1;
+	}
+
+	OSCRoute route;
+	route.target = target;
+	route.paramId = paramId;
+	route.argIndex = argIndex;
+	node->routes.push_back(route);
+
+	return 0;
+}
+
+void OSCDispatcher::clearRoutes() {
+	std::lock_guard<std::mutex> lock(routesMutex);
+	for(OSCRouteNode *child : root.literals)
+		delete child;
+	for(OSCRouteNode *child : root.patterns)
+		delete child;
+	root.literals.clear();
+	root.patterns.clear();
+}
+
+int OSCDispatcher::dispatch(const OSCMessageView &message) {
+	const char *address = message.getAddress();
+	if(address[0] != '/')
+		return 0;
+
+	std::lock_guard<std::mutex> lock(routesMutex);
+	return matchNode(&root, address+1, message);
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// path starts right after a slash, its first part is matched against children of node
+// part is copied on the stack, so nothing is allocated
+int OSCDispatcher::matchNode(const OSCRouteNode *node, const char *path, const OSCMessageView &message) {
+	const char *slash = strchr(path, '/');
+	size_t len = (slash != NULL) ? (size_t)(slash-path) : strlen(path);
+	if(len == 0 || len >= OSC_SEGMENT_MAX_LEN)
+		return 0;
+	char segment[OSC_SEGMENT_MAX_LEN];
+	memcpy(segment, path, len);
+	segment[len] = 0;
+	const char *rest = (slash != NULL) ? slash+1 : NULL;
+
+	int matched = 0;
+	if(!hasWildcards(segment)) {
+		std::vector<OSCRouteNode *>::const_iterator it = std::lower_bound(node->literals.begin(), node->literals.end(), segment, segmentLess);
+		if(it != node->literals.end() && strcmp((*it)->segment.c_str(), segment) == 0)
+			matched += matchChild(*it, rest, message);
+		for(const OSCRouteNode *child : node->patterns) {
+			if(segmentMatch(child->segment.c_str(), segment))
+				matched += matchChild(child, rest, message);
+		}
+	}
+	else {
+		// received pattern is matched against registered parts, patterns only if identical
+		for(const OSCRouteNode *child : node->literals) {
+			if(segmentMatch(segment, child->segment.c_str()))
+				matched += matchChild(child, rest, message);
+		}
+		for(const OSCRouteNode *child : node->patterns) {
+			if(strcmp(child->segment.c_str(), segment) == 0)
+				matched += matchChild(child, rest, message);
+		}
+	}
+	return matched;
+}
+
+int OSCDispatcher::matchChild(const OSCRouteNode *child, const char *rest, const OSCMessageView &message) {
+	if(rest != NULL)
+		return matchNode(child, rest, message);
+	return deliver(child, message);
+}
+
+// arguments are decoded here, audio thread only gets numbers
+// returns how many events made it into their queue
+int OSCDispatcher::deliver(const OSCRouteNode *node, const OSCMessageView &message) {
+	int pushed = 0;
+	for(const OSCRoute &route : node->routes) {
+		double value;
+		if(message.getArgsNum() == 0)
+			value = 1; // trigger
+		else {
+			switch(message.getArgType(route.argIndex)) {
+				case 'i': case 'h': case 'f': case 'd': case 'T': case 'F':
+					value = message.getNumber(route.argIndex);
+					break;
+				default:
+					continue; // not a number, or missing
+			}
+		}
+		if(route.target->push(route.paramId, value, message.getTimeTag()))
+			pushed++;
+	}
+	return pushed;
+}
+
+bool OSCDispatcher::hasWildcards(const char *segment) {
+	return strpbrk(segment, "?*[]{}") != NULL;
+}
+
+bool OSCDispatcher::segmentMatch(const char *pattern, const char *segment) {
+	const char *end = oscpkt::internalPatternMatch(pattern, segment);
+	return end != NULL && *end == 0;
+}
@@ -44,43 +44,41 @@
  */
 
 #include <OSCServer.h>
-
-//VIC
-#include "priority_utils.h"
-
-bool OSCServer::shouldStop = false;
-int OSCServer::prioReceiveThread = -1;
+#include "OSCDispatcher.h"
 
 // constructor
 OSCServer::OSCServer(){
 	port = -1;
-	receiveThread = -1;
+	registered = false;
 	verbose = 0;
+	messagePopped = false;
+	droppedMessages = 0;
+	dispatcher = NULL;
 }
 
-// static method for checking messages
-// called by messageCheckTask with pointer to OSCServer instance as argument
-void *OSCServer::checkMessages(void* ptr){
-    OSCServer *instance = (OSCServer*)ptr;
-
-    //VIC Set Priority
-    set_priority(prioReceiveThread, instance->verbose);
-
-    while(!shouldStop){
-        instance->messageCheck();
-        usleep(1000);
-    }
-    return (void *)0;
+OSCServer::~OSCServer(){
+    // network thread must be done with us before socket is closed
+    if (registered)
+        NetworkIO::removeSocket(socket.getSocket());
 }
 
-void OSCServer::setup(int _port, /*VIC added*/int prio){
+void OSCServer::setup(int _port, /*VIC added*/int prio, int slots){
     port = _port;
-    if(!socket.init(port))
+    inRing.init(slots); // all slots allocated here, nothing is allocated when receiving
+    messagePopped = false;
+    droppedMessages = 0;
+    if (registered){
+        NetworkIO::removeSocket(socket.getSocket());
+        registered = false;
+    }
+    if(!socket.init(port)){
         printf("socket not initialised\n");
+        return;
+    }
     //createAuxTasks(); //VIC
 
-    prioReceiveThread = prio; //VIC
-    pthread_create(&receiveThread, NULL, checkMessages, this);
+    NetworkIO::setPriority(prio); //VIC
+    registered = (NetworkIO::addSocket(socket.getSocket(), this) == 0);
 }
 
 /*VIC
@@ -91,41 +89,137 @@ void OSCServer::createAuxTasks(){
     Bela_scheduleAuxiliaryTask(OSCReceiveTask);
 }*/
 
-void OSCServer::messageCheck(){
-    if (socket.waitUntilReady(true, UDP_RECEIVE_TIMEOUT_MS)){
-        int msgLength = socket.read(&inBuffer, UDP_RECEIVE_MAX_LENGTH, false);
-        pr.init(inBuffer, msgLength);
-        oscpkt::Message *inmsg;
-        while (pr.isOk() && (inmsg = pr.popMessage()) != 0) {
-            inQueue.push(*inmsg);
-        }
-    }
+// network thread, packet is parsed where it was received
+void OSCServer::receivePacket(const char *data, int size){
+    std::lock_guard<std::mutex> lock(receiveMutex);
+    parsePacket(data, size, 1, 0); // 1 is immediately
 }
 
-bool OSCServer::messageWaiting(){
-    return !inQueue.empty();
+const OSCMessageView *OSCServer::popMessage(){
+    if (!messageWaiting())
+        return NULL;
+    messagePopped = true; // slot is given back on next call
+    return inRing.getReadSlot();
 }
 
-oscpkt::Message OSCServer::popMessage(){
-    if (!inQueue.empty()){
-        poppedMessage = inQueue.front();
-        inQueue.pop();
-    } else {
-        poppedMessage.init("/error");
-    }
-    return poppedMessage;
+void OSCServer::receiveMessageNow(int timeout){
+    receive(timeout);
 }
 
-void OSCServer::receiveMessageNow(int timeout){
-    if (socket.waitUntilReady(true, timeout)){
-        int msgLength = socket.read(&inBuffer, UDP_RECEIVE_MAX_LENGTH, false);
-        pr.init(inBuffer, msgLength);
-        oscpkt::Message *inmsg;
-        while (pr.isOk() && (inmsg = pr.popMessage()) != 0) {
-            inQueue.push(*inmsg);
-        }
-    }
+// receiveMessageNow(), messages are parsed straight from the receive buffer into ring slots
+void OSCServer::receive(int timeout){
+    std::lock_guard<std::mutex> lock(receiveMutex);
+    if (socket.waitUntilReady(true, timeout) <= 0)
+        return;
+    // drains all datagrams that are there, bursts do not wait for next wake up
+    do {
+        int msgLength = socket.read(inBuffer, UDP_RECEIVE_MAX_LENGTH, false);
+        if (msgLength <= 0)
+            break;
+        parsePacket(inBuffer, msgLength, 1, 0); // 1 is immediately
+    } while (socket.waitUntilReady(true, 0) > 0);
 }
 
+// unpacks nested bundles, each message inherits time tag of the bundle it is in
+void OSCServer::parsePacket(const char *packet, int size, uint64_t timeTag, int depth){
+    if (size >= 16 && memcmp(packet, "#bundle", 8) == 0){
+        if (depth >= 8){
+            droppedMessages++;
+            return;
+        }
+        timeTag = oscpkt::bytes2pod<uint64_t>(packet+8);
+        int pos = 16;
+        while (pos+4 <= size){
+            int len = oscpkt::bytes2pod<int32_t>(packet+pos);
+            pos += 4;
+            if (len <= 0 || (len&3) != 0 || len > size-pos){
+                droppedMessages++; // rest of bundle can't be trusted
+                return;
+            }
+            parsePacket(packet+pos, len, timeTag, depth+1);
+            pos += len;
+        }
+        return;
+    }
 
+    // parsed where it would be queued, so that it is not copied if no route takes it
+    OSCMessageView *slot = inRing.getWriteSlot();
+    OSCMessageView *msg = (slot != NULL) ? slot : &scratchMessage;
+    if ((slot == NULL && dispatcher == NULL) || !msg->parse(packet, size, timeTag)){
+        droppedMessages++;
+        if (verbose)
+            printf("OSCServer on port %d: message dropped, %s\n", port, (slot == NULL) ? "queue is full" : "malformed or too big");
+        return;
+    }
+    if (dispatcher != NULL && dispatcher->dispatch(*msg) > 0)
+        return;
+    if (slot == NULL){
+        droppedMessages++;
+        if (verbose)
+            printf("OSCServer on port %d: message dropped, queue is full\n", port);
+        return;
+    }
+    inRing.push();
+}
 
+// OSCMessageView
+bool OSCMessageView::parse(const char *message, int size, uint64_t timeTag){
+    if (size <= 0 || size > OSC_MESSAGE_MAX_BYTES || (size&3) != 0 || message[0] != '/')
+        return false;
+    memcpy(data, message, size);
+    this->size = size;
+    this->timeTag = timeTag;
+
+    // address and type tags are zero terminated and padded to 4 bytes
+    const char *end = (const char *)memchr(data, 0, size);
+    if (end == NULL)
+        return false;
+    typeTagsOffset = oscpkt::ceil4(end-data+1);
+    if (typeTagsOffset >= size || data[typeTagsOffset] != ',')
+        return false;
+    const char *tags = data+typeTagsOffset;
+    end = (const char *)memchr(tags, 0, size-typeTagsOffset);
+    if (end == NULL)
+        return false;
+    argsNum = end-tags-1;
+    if (argsNum > OSC_MESSAGE_MAX_ARGS)
+        return false;
+
+    int pos = oscpkt::ceil4(end-data+1);
+    for (int i=0; i<argsNum; i++){
+        argOffsets[i] = pos;
+        int len;
+        switch (tags[i+1]){
+            case 'i': case 'f': case 'c': case 'r': case 'm':
+                len = 4;
+                break;
+            case 'h': case 'd': case 't':
+                len = 8;
+                break;
+            case 'T': case 'F': case 'N': case 'I':
+                len = 0;
+                break;
+            case 's': case 'S': {
+                const char *strEnd = (pos < size) ? (const char *)memchr(data+pos, 0, size-pos) : NULL;
+                if (strEnd == NULL)
+                    return false;
+                len = oscpkt::ceil4(strEnd-(data+pos)+1);
+                break;
+            }
+            case 'b':
+                if (pos+4 > size)
+                    return false;
+                len = oscpkt::bytes2pod<int32_t>(data+pos);
+                if (len < 0 || len > size)
+                    return false;
+                len = 4 + oscpkt::ceil4(len);
+                break;
+            default:
+                return false; // arrays and unknown types
+        }
+        if (pos+len > size)
+            return false;
+        pos += len;
+    }
+    return true;
+}
@@ -70,8 +70,16 @@ void Oscillator::init(oscillator_type type, unsigned int rate, unsigned int peri
 }
 
 double **Oscillator::getFrameBuffer(int numOfSamples) {
-	for(int n=0; n<numOfSamples; n++)
-		framebuffer[out_chn_offset][n] =(this->*getSampleMethod) (); // methods referred to by getSample() are all inline
+	if(_type == osc_whiteNoise_) {
+		// noise can be generated as a whole block, with range already scaled as in getWhiteNoiseSample()
+		double min = level*(-1+_half_shift)/_half_denom;
+		double max = level*(1+_half_shift)/_half_denom;
+		_random.fillUniform(framebuffer[out_chn_offset], numOfSamples, min, max);
+	}
+	else {
+		for(int n=0; n<numOfSamples; n++)
+			framebuffer[out_chn_offset][n] =(this->*getSampleMethod) (); // methods referred to by getSample() are all inline
+	}
 
 	memset(framebuffer[out_chn_offset]+numOfSamples, 0, (period_size-numOfSamples)*sizeof(double)); // reset part of buffer that has been potentially left untouched
 
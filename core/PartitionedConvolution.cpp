@@ -0,0 +1,162 @@
+/*
+ * PartitionedConvolution.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: uniformly partitioned overlap-save convolution, with frequency domain delay line
+ *                as in F. Wefers, "Partitioned convolution algorithms for real-time auralization", 2015
+ */
+
+#include "PartitionedConvolution.h"
+
+#include <stdio.h>
+#include <cstring> // memcpy, memset
+
+static double *allocateSpectra(int num) {
+	double *spectra = fftw_alloc_real(num); // fftw alignment is fine for SIMD
+	memset(spectra, 0, num*sizeof(double));
+	return spectra;
+}
+
+
+
+PartitionedConvolution::PartitionedConvolution() {
+	blockSize = 0;
+	binsNum = 0;
+	partitionsNum = 0;
+	irRe = irIm = NULL;
+	fdlRe = fdlIm = NULL;
+	accRe = accIm = NULL;
+	fdlPos = 0;
+	inputWindow = NULL;
+}
+
+PartitionedConvolution::~PartitionedConvolution() {
+	deallocate();
+}
+
+int PartitionedConvolution::init(double *ir, int irLen, int blockSize, fft_planning planning) {
+	if(blockSize <= 0 || irLen <= 0) {
+		printf("PartitionedConvolution error! Block size %d and impulse response length %d must be positive\n", blockSize, irLen);
+		return -1;
+	}
+
+	deallocate();
+
+	this->blockSize = blockSize;
+	binsNum = blockSize+1; // fft size is 2*blockSize
+	partitionsNum = (irLen+blockSize-1)/blockSize;
+
+	if(fft.init(2*blockSize, planning) != 0)
+		return -1;
+
+	irRe  = allocateSpectra(partitionsNum*binsNum);
+	irIm  = allocateSpectra(partitionsNum*binsNum);
+	fdlRe = allocateSpectra(partitionsNum*binsNum);
+	fdlIm = allocateSpectra(partitionsNum*binsNum);
+	accRe = allocateSpectra(binsNum);
+	accIm = allocateSpectra(binsNum);
+	inputWindow = allocateSpectra(2*blockSize);
+
+	// each partition zero padded to fft size and transformed once
+	double *samples = fft.getSamples();
+	fftw_complex *bins = fft.getBins();
+	for(int p=0; p<partitionsNum; p++) {
+		int len = irLen - p*blockSize;
+		if(len > blockSize)
+			len = blockSize;
+
+		memset(samples, 0, 2*blockSize*sizeof(double));
+		memcpy(samples, ir+p*blockSize, len*sizeof(double));
+		fft.forward();
+
+		for(int k=0; k<binsNum; k++) {
+			irRe[p*binsNum+k] = bins[k][0];
+			irIm[p*binsNum+k] = bins[k][1];
+		}
+	}
+
+	fdlPos = 0;
+	return 0;
+}
+
+void PartitionedConvolution::process(double *in, double *out, int numOfSamples) {
+	if(numOfSamples > blockSize)
+		numOfSamples = blockSize;
+
+	// slide input, second half of window gets current block
+	memcpy(inputWindow, inputWindow+blockSize, blockSize*sizeof(double));
+	memcpy(inputWindow+blockSize, in, numOfSamples*sizeof(double));
+	memset(inputWindow+blockSize+numOfSamples, 0, (blockSize-numOfSamples)*sizeof(double));
+
+	double *samples = fft.getSamples();
+	fftw_complex *bins = fft.getBins();
+
+	memcpy(samples, inputWindow, 2*blockSize*sizeof(double));
+	fft.forward();
+
+	// newest spectrum enters delay line
+	double *xRe = fdlRe + fdlPos*binsNum;
+	double *xIm = fdlIm + fdlPos*binsNum;
+	for(int k=0; k<binsNum; k++) {
+		xRe[k] = bins[k][0];
+		xIm[k] = bins[k][1];
+	}
+
+	// partition p is paired with the input spectrum from p blocks ago
+	memset(accRe, 0, binsNum*sizeof(double));
+	memset(accIm, 0, binsNum*sizeof(double));
+	int slot = fdlPos;
+	for(int p=0; p<partitionsNum; p++) {
+		const double * __restrict__ hRe = irRe + p*binsNum;
+		const double * __restrict__ hIm = irIm + p*binsNum;
+		const double * __restrict__ sRe = fdlRe + slot*binsNum;
+		const double * __restrict__ sIm = fdlIm + slot*binsNum;
+		double * __restrict__ aRe = accRe;
+		double * __restrict__ aIm = accIm;
+		for(int k=0; k<binsNum; k++) {
+			aRe[k] += sRe[k]*hRe[k] - sIm[k]*hIm[k];
+			aIm[k] += sRe[k]*hIm[k] + sIm[k]*hRe[k];
+		}
+
+		if(--slot < 0)
+			slot = partitionsNum-1;
+	}
+
+	if(++fdlPos >= partitionsNum)
+		fdlPos = 0;
+
+	for(int k=0; k<binsNum; k++) {
+		bins[k][0] = accRe[k];
+		bins[k][1] = accIm[k];
+	}
+	fft.inverse();
+
+	// overlap-save, first half is circular convolution garbage
+	memcpy(out, samples+blockSize, numOfSamples*sizeof(double));
+}
+
+void PartitionedConvolution::reset() {
+	if(fdlRe == NULL)
+		return;
+
+	memset(fdlRe, 0, partitionsNum*binsNum*sizeof(double));
+	memset(fdlIm, 0, partitionsNum*binsNum*sizeof(double));
+	memset(inputWindow, 0, 2*blockSize*sizeof(double));
+	fdlPos = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+void PartitionedConvolution::deallocate() {
+	double *buffers[] = {irRe, irIm, fdlRe, fdlIm, accRe, accIm, inputWindow};
+	for(double *buff : buffers) {
+		if(buff != NULL)
+			fftw_free(buff);
+	}
+	irRe = irIm = NULL;
+	fdlRe = fdlIm = NULL;
+	accRe = accIm = NULL;
+	inputWindow = NULL;
+}
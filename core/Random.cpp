@@ -0,0 +1,127 @@
+/*
+ * Random.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: xoshiro256+ generator by David Blackman and Sebastiano Vigna [https://prng.di.unimi.it/, public domain]
+ *                seeded through splitmix64, from the same authors
+ */
+
+#include "Random.h"
+
+#include <math.h>
+#include <atomic>
+#include <chrono>
+
+// to make sure that instances created in the same instant still get different seeds
+static std::atomic<uint64_t> instanceCounter(0);
+
+
+Random::Random() {
+	uint64_t now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+	uint64_t count = instanceCounter.fetch_add(1);
+	setSeed(now ^ (count * 0x9e3779b97f4a7c15ULL));
+}
+
+Random::Random(uint64_t seed) {
+	setSeed(seed);
+}
+
+void Random::setSeed(uint64_t seed) {
+	this->seed = seed;
+
+	// splitmix64 spreads the seed over the whole state, each lane gets its own stream
+	uint64_t x = seed;
+	for(int l=0; l<RANDOM_LANES; l++) {
+		s0[l] = splitmix64(x);
+		s1[l] = splitmix64(x);
+		s2[l] = splitmix64(x);
+		s3[l] = splitmix64(x);
+	}
+
+	lane = 0;
+	gaussSpare = 0;
+	hasGaussSpare = false;
+}
+
+// Box-Muller
+double Random::gaussian() {
+	if(hasGaussSpare) {
+		hasGaussSpare = false;
+		return gaussSpare;
+	}
+
+	double u1 = 1.0 - uniform(); // (0, 1], cos log(0) is not an option
+	double u2 = uniform();
+	double r = sqrt(-2.0*log(u1));
+
+	gaussSpare = r*sin(2*M_PI*u2);
+	hasGaussSpare = true;
+	return r*cos(2*M_PI*u2);
+}
+
+void Random::fillUniform(double *buffer, int numOfSamples, double min, double max) {
+	uint64_t block[RANDOM_LANES];
+	double range = max-min;
+
+	int n = 0;
+	for(; n+RANDOM_LANES<=numOfSamples; n+=RANDOM_LANES) {
+		nextBlock(block);
+		for(int l=0; l<RANDOM_LANES; l++)
+			buffer[n+l] = min + toUnit(block[l])*range;
+	}
+	// leftovers
+	for(; n<numOfSamples; n++)
+		buffer[n] = min + uniform()*range;
+}
+
+void Random::fillUniform(float *buffer, int numOfSamples, float min, float max) {
+	uint64_t block[RANDOM_LANES];
+	float range = max-min;
+
+	int n = 0;
+	for(; n+RANDOM_LANES<=numOfSamples; n+=RANDOM_LANES) {
+		nextBlock(block);
+		for(int l=0; l<RANDOM_LANES; l++)
+			buffer[n+l] = min + (float)toUnit(block[l])*range;
+	}
+	// leftovers
+	for(; n<numOfSamples; n++)
+		buffer[n] = min + (float)uniform()*range;
+}
+
+// Box-Muller on pairs of lanes, so each block of uniform values gives as many gaussian values
+void Random::fillGaussian(double *buffer, int numOfSamples, double mean, double stdDev) {
+	uint64_t block[RANDOM_LANES];
+
+	int n = 0;
+	for(; n+RANDOM_LANES<=numOfSamples; n+=RANDOM_LANES) {
+		nextBlock(block);
+		for(int l=0; l<RANDOM_LANES; l+=2) {
+			double r = stdDev*sqrt(-2.0*log(1.0 - toUnit(block[l])));
+			double theta = 2*M_PI*toUnit(block[l+1]);
+			buffer[n+l]   = mean + r*cos(theta);
+			buffer[n+l+1] = mean + r*sin(theta);
+		}
+	}
+	// leftovers
+	for(; n<numOfSamples; n++)
+		buffer[n] = mean + stdDev*gaussian();
+}
+
+void Random::fillGaussian(float *buffer, int numOfSamples, float mean, float stdDev) {
+	uint64_t block[RANDOM_LANES];
+
+	int n = 0;
+	for(; n+RANDOM_LANES<=numOfSamples; n+=RANDOM_LANES) {
+		nextBlock(block);
+		for(int l=0; l<RANDOM_LANES; l+=2) {
+			float r = stdDev*sqrt(-2.0*log(1.0 - toUnit(block[l]))); // in double, (float)toUnit() may round up to 1
+			float theta = 2*M_PI*toUnit(block[l+1]);
+			buffer[n+l]   = mean + r*cosf(theta);
+			buffer[n+l+1] = mean + r*sinf(theta);
+		}
+	}
+	// leftovers
+	for(; n<numOfSamples; n++)
+		buffer[n] = mean + stdDev*gaussian();
+}
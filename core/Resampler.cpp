@@ -0,0 +1,206 @@
+/*
+ * Resampler.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: polyphase windowed sinc sample rate converter [Kaiser window], as in J. O. Smith's "Digital Audio Resampling Home Page"
+ *                [https://ccrma.stanford.edu/~jos/resample/]
+ */
+
+#include "Resampler.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <cstring> // memcpy, memset
+#include <thread>
+#include <vector>
+
+// zero crossings per side, Kaiser beta [stopband attenuation] and passband edge as fraction of the lowest Nyquist
+static const int qualityZeroCrossings[] = {8, 16, 32};
+static const double qualityBeta[] = {6.0, 8.6, 12.0};	   // ~ -60, -90, -120 dB
+static const double qualityRolloff[] = {0.85, 0.91, 0.945};
+
+static int gcd(int a, int b) {
+	while(b != 0) {
+		int t = a%b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+
+Resampler::Resampler() {
+	inRate = 0;
+	outRate = 0;
+	interpFactor = 1;
+	decimFactor = 1;
+	exact = true;
+	phasesNum = 0;
+	tapsNum = 0;
+	halfTaps = 0;
+	bank = NULL;
+}
+
+Resampler::~Resampler() {
+	if(bank != NULL)
+		delete[] bank;
+}
+
+int Resampler::init(int inRate, int outRate, resamplerQuality quality) {
+	if(inRate <= 0 || outRate <= 0) {
+		printf("Resampler error! Rates %d and %d must be positive\n", inRate, outRate);
+		return -1;
+	}
+
+	this->inRate = inRate;
+	this->outRate = outRate;
+	int g = gcd(inRate, outRate);
+	interpFactor = outRate/g;
+	decimFactor = inRate/g;
+
+	exact = (interpFactor <= RESAMPLER_MAX_PHASES);
+	phasesNum = exact ? interpFactor : RESAMPLER_ARBITRARY_PHASES;
+
+	// when decimating the cutoff goes down with the output rate and the filter gets longer, in input samples
+	double cutoff = 0.5*qualityRolloff[quality]; // cycles per input sample
+	if(outRate < inRate)
+		cutoff *= (double)outRate/inRate;
+	double support = qualityZeroCrossings[quality]/(2*cutoff); // input samples per side
+
+	halfTaps = (int)ceil(support)+1;
+	tapsNum = ((2*halfTaps+3)/4)*4; // padded to multiple of 4, for dot()
+
+	computeBank(cutoff, qualityBeta[quality]);
+
+	return 0;
+}
+
+int64_t Resampler::getOutputLength(int64_t numOfSamples) {
+	return (numOfSamples*interpFactor + decimFactor-1)/decimFactor;
+}
+
+int64_t Resampler::process(const double *in, int64_t numOfSamples, double *out, int numOfThreads) {
+	if(bank == NULL) {
+		printf("Resampler error! Not inited\n");
+		return -1;
+	}
+
+	int64_t outLen = getOutputLength(numOfSamples);
+
+	// zeros around the input, so that no tap ever needs a bounds check
+	int64_t paddedLen = numOfSamples + 2*tapsNum + 4;
+	double *padded = new double[paddedLen];
+	memset(padded, 0, paddedLen*sizeof(double));
+	memcpy(padded+halfTaps, in, numOfSamples*sizeof(double));
+
+	if(numOfThreads < 0)
+		numOfThreads = std::thread::hardware_concurrency();
+	int64_t maxThreads = outLen/RESAMPLER_MIN_SAMPLES_PER_THREAD;
+	if(numOfThreads > maxThreads)
+		numOfThreads = maxThreads;
+	if(numOfThreads < 1)
+		numOfThreads = 1;
+
+	// output samples are independent, each thread gets a contiguous range and this thread takes the first one
+	std::vector<std::thread> threads;
+	for(int t=1; t<numOfThreads; t++) {
+		int64_t first = (outLen*t)/numOfThreads;
+		int64_t last = (outLen*(t+1))/numOfThreads;
+		threads.push_back(std::thread(&Resampler::processRange, this, padded, first, last, out));
+	}
+	processRange(padded, 0, outLen/numOfThreads, out);
+	for(size_t t=0; t<threads.size(); t++)
+		threads[t].join();
+
+	delete[] padded;
+	return outLen;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// phase p holds the filter sampled at the input frames around position base+p/phasesNum
+void Resampler::computeBank(double cutoff, double beta) {
+	if(bank != NULL)
+		delete[] bank;
+
+	int rows = exact ? phasesNum : phasesNum+1; // extra row to interpolate past last phase
+	bank = new double[rows*tapsNum];
+
+	double support = (halfTaps-1);
+	double i0Beta = besselI0(beta);
+	for(int p=0; p<rows; p++) {
+		double frac = (double)p/phasesNum;
+		double *h = bank + p*tapsNum;
+		double sum = 0;
+		for(int k=0; k<tapsNum; k++) {
+			double x = k - (halfTaps-1) - frac; // distance from output position, in input frames
+			double r = x/support;
+			if(fabs(r) >= 1) {
+				h[k] = 0;
+				continue;
+			}
+			double arg = 2*cutoff*x;
+			double sinc = (arg == 0) ? 1 : sin(M_PI*arg)/(M_PI*arg);
+			double window = besselI0(beta*sqrt(1-r*r))/i0Beta;
+			h[k] = 2*cutoff*sinc*window;
+			sum += h[k];
+		}
+		// unity gain at DC on every phase
+		for(int k=0; k<tapsNum; k++)
+			h[k] /= sum;
+	}
+}
+
+void Resampler::processRange(const double *padded, int64_t first, int64_t last, double *out) {
+	if(exact) {
+		// output n sits at input position n*M/L, i.e., frame base and phase p
+		int64_t pos = first*decimFactor;
+		int64_t base = pos/interpFactor;
+		int p = pos%interpFactor;
+		int baseInc = decimFactor/interpFactor;
+		int phaseInc = decimFactor%interpFactor;
+
+		for(int64_t n=first; n<last; n++) {
+			out[n] = dot(padded+base+1, bank+p*tapsNum, tapsNum);
+
+			base += baseInc;
+			p += phaseInc;
+			if(p >= interpFactor) {
+				p -= interpFactor;
+				base++;
+			}
+		}
+	}
+	else {
+		double ratio = (double)decimFactor/interpFactor;
+		for(int64_t n=first; n<last; n++) {
+			double pos = n*ratio;
+			int64_t base = (int64_t)pos;
+			double phase = (pos-base)*phasesNum;
+			int p = (int)phase;
+			double frac = phase-p;
+
+			// linear interpolation between the two nearest phases
+			const double *x = padded+base+1;
+			double a = dot(x, bank+p*tapsNum, tapsNum);
+			double b = dot(x, bank+(p+1)*tapsNum, tapsNum);
+			out[n] = a + frac*(b-a);
+		}
+	}
+}
+
+// modified Bessel function of first kind, order 0, power series
+double Resampler::besselI0(double x) {
+	double sum = 1;
+	double term = 1;
+	double halfX = x/2;
+	for(int k=1; k<50; k++) {
+		term *= (halfX/k)*(halfX/k);
+		sum += term;
+		if(term < sum*1e-17)
+			break;
+	}
+	return sum;
+}
@@ -0,0 +1,172 @@
+/*
+ * STFTAnalyser.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: streaming short time Fourier transform, frames published to other threads through a triple buffer
+ */
+
+#include "STFTAnalyser.h"
+
+#include <stdio.h>
+
+
+STFTAnalyser::STFTAnalyser() {
+	fftSize = 0;
+	hopSize = 0;
+	binsNum = 0;
+	window = NULL;
+	magnitudeNorm = 1;
+	history = NULL;
+	historyPos = 0;
+	hopCounter = 0;
+	frameCount = 0;
+	for(int i=0; i<3; i++) {
+		frames.getSlot(i)->magnitude = NULL;
+		frames.getSlot(i)->phase = NULL;
+		frames.getSlot(i)->index = 0;
+	}
+}
+
+STFTAnalyser::~STFTAnalyser() {
+	deallocate();
+}
+
+int STFTAnalyser::init(unsigned int periodSize, int fftSize, int hopSize, windowType window, unsigned short inChannel, unsigned short outChannel) {
+	if(fftSize <= 0 || hopSize <= 0 || hopSize > fftSize) {
+		printf("STFTAnalyser error! FFT size %d and hop size %d are not valid\n", fftSize, hopSize);
+		return -1;
+	}
+
+	deallocate();
+
+	AudioModuleInOut::init(periodSize, 1, inChannel, 1, outChannel);
+
+	this->fftSize = fftSize;
+	this->hopSize = hopSize;
+	binsNum = fftSize/2+1;
+	if(fft.init(fftSize) != 0)
+		return -1;
+
+	// periodic windows, so that overlapped frames add up evenly
+	this->window = new double[fftSize];
+	double windowSum = 0;
+	for(int i=0; i<fftSize; i++) {
+		double phase = 2*M_PI*i/fftSize;
+		switch(window) {
+			case win_rect_:
+				this->window[i] = 1;
+				break;
+			case win_hann_:
+				this->window[i] = 0.5 - 0.5*cos(phase);
+				break;
+			case win_hamming_:
+				this->window[i] = 0.54 - 0.46*cos(phase);
+				break;
+			case win_blackman_:
+				this->window[i] = 0.42 - 0.5*cos(phase) + 0.08*cos(2*phase);
+				break;
+		}
+		windowSum += this->window[i];
+	}
+	magnitudeNorm = 2/windowSum;
+
+	history = new double[fftSize];
+	memset(history, 0, fftSize*sizeof(double));
+	historyPos = 0;
+	hopCounter = 0;
+	frameCount = 0;
+
+	for(int i=0; i<3; i++) {
+		SpectrumFrame *frame = frames.getSlot(i);
+		frame->magnitude = new double[binsNum];
+		frame->phase = new double[binsNum];
+		memset(frame->magnitude, 0, binsNum*sizeof(double));
+		memset(frame->phase, 0, binsNum*sizeof(double));
+		frame->index = 0;
+	}
+
+	return 0;
+}
+
+double **STFTAnalyser::getFrameBuffer(int numOfSamples, double **input) {
+	tap(input[in_chn_offset], numOfSamples);
+	memcpy(framebuffer[out_chn_offset], input[in_chn_offset], numOfSamples*sizeof(double));
+	return framebuffer;
+}
+
+void STFTAnalyser::tap(double *samples, int numOfSamples) {
+	if(hopSize <= 0)
+		return; // not inited
+	int done = 0;
+	while(done < numOfSamples) {
+		// up to next frame, or end of buffer
+		int len = hopSize - hopCounter;
+		if(len > numOfSamples-done)
+			len = numOfSamples-done;
+
+		for(int n=0; n<len; n++) {
+			history[historyPos] = samples[done+n];
+			if(++historyPos == fftSize)
+				historyPos = 0;
+		}
+		hopCounter += len;
+		done += len;
+
+		if(hopCounter == hopSize) {
+			computeFrame();
+			hopCounter = 0;
+		}
+	}
+}
+
+void STFTAnalyser::retrigger() {
+	memset(history, 0, fftSize*sizeof(double));
+	historyPos = 0;
+	hopCounter = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+void STFTAnalyser::computeFrame() {
+	// unwrap history, oldest sample first
+	double *samples = fft.getSamples();
+	int tail = fftSize-historyPos;
+	for(int i=0; i<tail; i++)
+		samples[i] = history[historyPos+i]*window[i];
+	for(int i=tail; i<fftSize; i++)
+		samples[i] = history[i-tail]*window[i];
+
+	fft.forward();
+
+	SpectrumFrame *frame = frames.getWriteSlot();
+	fftw_complex *bins = fft.getBins();
+	for(int k=0; k<binsNum; k++) {
+		frame->magnitude[k] = sqrt(bins[k][0]*bins[k][0] + bins[k][1]*bins[k][1])*magnitudeNorm;
+		frame->phase[k] = atan2(bins[k][1], bins[k][0]);
+	}
+	frame->index = frameCount++;
+
+	frames.publish();
+}
+
+void STFTAnalyser::deallocate() {
+	if(window != NULL) {
+		delete[] window;
+		window = NULL;
+	}
+	if(history != NULL) {
+		delete[] history;
+		history = NULL;
+	}
+	for(int i=0; i<3; i++) {
+		SpectrumFrame *frame = frames.getSlot(i);
+		if(frame->magnitude != NULL) {
+			delete[] frame->magnitude;
+			delete[] frame->phase;
+			frame->magnitude = NULL;
+			frame->phase = NULL;
+		}
+	}
+}
@@ -0,0 +1,118 @@
+/*
+ * SVF.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: topology preserving transform state variable filter, as in Andrew Simper's "Linear Trapezoidal Integrated SVF"
+ *                [https://cytomic.com/files/dsp/SvfLinearTrapOptimised2.pdf]
+ */
+
+#include <math.h>
+#include "SVF.h"
+
+SVF::SVF() {
+	lookup = false;
+	setSVF(svf_type_lowpass, 0.5, 0.707);
+}
+
+SVF::SVF(int type, double Fc, double Q) {
+	lookup = false;
+	setSVF(type, Fc, Q);
+}
+
+void SVF::setType(int type) {
+	this->type = type;
+	computeMix();
+}
+
+void SVF::setFc(double Fc) {
+	this->Fc = Fc;
+	targetG = computeG(Fc);
+}
+
+void SVF::setQ(double Q) {
+	this->Q = Q;
+	targetK = 1/Q;
+}
+
+void SVF::setSVF(int type, double Fc, double Q) {
+	this->type = type;
+	setFc(Fc);
+	setQ(Q);
+	g = targetG;
+	k = targetK;
+	computeMix();
+	reset();
+}
+
+void SVF::useLookupTable(bool use) {
+	lookup = use;
+	targetG = computeG(Fc);
+}
+
+void SVF::reset() {
+	ic1eq = ic2eq = 0;
+}
+
+// coefficients ramp from current to target values, so that block rate changes do not click
+void SVF::process(double *inout, int numOfSamples) {
+	if(g == targetG && k == targetK) {
+		for(int i=0; i<numOfSamples; i++)
+			inout[i] = tick(inout[i]);
+		return;
+	}
+
+	double gInc = (targetG-g)/numOfSamples;
+	double kInc = (targetK-k)/numOfSamples;
+	bool mixFollowsK = (type != svf_type_lowpass && type != svf_type_bandpass); // the other types use k in the output mix
+
+	for(int i=0; i<numOfSamples; i++) {
+		g += gInc;
+		k += kInc;
+		if(mixFollowsK)
+			computeMix();
+		inout[i] = tick(inout[i]);
+	}
+
+	// no accumulated rounding
+	g = targetG;
+	k = targetK;
+	computeMix();
+}
+
+void SVF::process(double *inout, int numOfSamples, double *fcBuffer) {
+	if(numOfSamples <= 0)
+		return;
+
+	double kInc = (targetK-k)/numOfSamples;
+
+	for(int i=0; i<numOfSamples; i++) {
+		g = computeG(fcBuffer[i]);
+		k += kInc;
+		if(kInc != 0)
+			computeMix();
+		inout[i] = tick(inout[i]);
+	}
+
+	Fc = fcBuffer[numOfSamples-1];
+	targetG = g;
+	k = targetK;
+	computeMix();
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// shared by all instances, filled on first use
+const double *SVF::getTable() {
+	struct GTable {
+		double g[SVF_TABLE_SIZE+1];
+		GTable() {
+			for(int i=0; i<SVF_TABLE_SIZE; i++)
+				g[i] = tan(M_PI*SVF_MAX_FC*i/(SVF_TABLE_SIZE-1));
+			g[SVF_TABLE_SIZE] = g[SVF_TABLE_SIZE-1]; // guard for interpolation at SVF_MAX_FC
+		}
+	};
+	static const GTable table; // thread safe initialization since C++11
+	return table.g;
+}
@@ -0,0 +1,293 @@
+/*
+ * SampleCache.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: process-wide cache of decoded audio files, shared by all the modules that play them
+ */
+
+#include "SampleCache.h"
+
+#include <stdio.h>
+#include <cstring> // memcpy, memcmp
+#include <map>
+#include <list>
+#include <tuple>
+#include <mutex>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h> // pthread_self
+
+static_assert(sizeof(SampleFileHeader) <= SAMPLE_CACHE_DATA_OFFSET, "sample cache file header does not fit");
+
+typedef std::tuple<std::string, int, int> SampleKey; // path, channel, rate
+
+struct CacheEntry {
+	SamplePtr data;
+	std::list<SampleKey>::iterator lruPos;
+};
+
+struct CacheState {
+	std::mutex cacheMutex;
+	std::map<SampleKey, CacheEntry> entries;
+	std::list<SampleKey> lru; // most recently used first
+	size_t memoryUsage; // heap samples, held against the ceiling
+	size_t memoryCeiling;
+	size_t mappedBytes; // samples mapped from disk cache, their pages can be dropped by the kernel anyway
+	bool lockMapped;
+	std::string diskDirectory; // empty if disk cache is off
+};
+
+// built on first use and never destroyed, loader threads may still be using it during static destruction
+static CacheState &getCache() {
+	static CacheState *cache = NULL;
+	static std::once_flag created;
+	std::call_once(created, [] {
+		cache = new CacheState();
+		cache->memoryUsage = 0;
+		cache->memoryCeiling = SAMPLE_CACHE_DEFAULT_CEILING;
+		cache->mappedBytes = 0;
+		cache->lockMapped = false;
+	});
+	return *cache;
+}
+
+
+// caller holds the lock
+static void evict() {
+	CacheState &cache = getCache();
+	if(cache.memoryCeiling == 0)
+		return;
+
+	// from the least recently used, skipping what modules still hold [that memory would not be freed anyway] and mapped samples [not on the heap]
+	auto it = cache.lru.end();
+	while(cache.memoryUsage > cache.memoryCeiling && it != cache.lru.begin()) {
+		--it;
+		auto entry = cache.entries.find(*it);
+		if(entry->second.data.use_count() > 1 || entry->second.data->mapping != NULL)
+			continue;
+		cache.memoryUsage -= entry->second.data->getBytes();
+		cache.entries.erase(entry);
+		it = cache.lru.erase(it);
+	}
+}
+
+SamplePtr SampleCache::find(std::string path, int chnIndex, int rate) {
+	CacheState &cache = getCache();
+	std::lock_guard<std::mutex> lock(cache.cacheMutex);
+
+	auto it = cache.entries.find(SampleKey(path, chnIndex, rate));
+	if(it == cache.entries.end())
+		return SamplePtr();
+
+	cache.lru.splice(cache.lru.begin(), cache.lru, it->second.lruPos); // now most recent
+	return it->second.data;
+}
+
+SamplePtr SampleCache::insert(std::string path, int chnIndex, int rate, SamplePtr data) {
+	CacheState &cache = getCache();
+	std::lock_guard<std::mutex> lock(cache.cacheMutex);
+
+	SampleKey key(path, chnIndex, rate);
+	auto it = cache.entries.find(key);
+	if(it != cache.entries.end()) {
+		cache.lru.splice(cache.lru.begin(), cache.lru, it->second.lruPos);
+		return it->second.data;
+	}
+
+	cache.lru.push_front(key);
+	CacheEntry entry;
+	entry.data = data;
+	entry.lruPos = cache.lru.begin();
+	cache.entries[key] = entry;
+	if(data->mapping != NULL)
+		cache.mappedBytes += data->getBytes();
+	else
+		cache.memoryUsage += data->getBytes();
+
+	evict();
+	return data;
+}
+
+void SampleCache::setMemoryCeiling(size_t bytes) {
+	CacheState &cache = getCache();
+	std::lock_guard<std::mutex> lock(cache.cacheMutex);
+	cache.memoryCeiling = bytes;
+	evict();
+}
+
+size_t SampleCache::getMemoryUsage() {
+	CacheState &cache = getCache();
+	std::lock_guard<std::mutex> lock(cache.cacheMutex);
+	return cache.memoryUsage;
+}
+
+size_t SampleCache::getMappedBytes() {
+	CacheState &cache = getCache();
+	std::lock_guard<std::mutex> lock(cache.cacheMutex);
+	return cache.mappedBytes;
+}
+
+int SampleCache::getEntriesNum() {
+	CacheState &cache = getCache();
+	std::lock_guard<std::mutex> lock(cache.cacheMutex);
+	return cache.entries.size();
+}
+
+void SampleCache::clear() {
+	CacheState &cache = getCache();
+	std::lock_guard<std::mutex> lock(cache.cacheMutex);
+	cache.entries.clear();
+	cache.lru.clear();
+	cache.memoryUsage = 0;
+	cache.mappedBytes = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// disk cache
+//----------------------------------------------------------------------------------------------------------------------------
+
+// FNV-1a, 64 bits
+static uint64_t hashString(std::string str, uint64_t hash=14695981039346656037ULL) {
+	for(size_t i=0; i<str.size(); i++) {
+		hash ^= (unsigned char)str[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// one file per key and processing variant
+static std::string getCacheFilename(std::string path, int chnIndex, int rate, int variant) {
+	CacheState &cache = getCache();
+	char name[64];
+	uint64_t hash = hashString(path + "|" + std::to_string(chnIndex) + "|" + std::to_string(rate) + "|" + std::to_string(variant));
+	snprintf(name, sizeof(name), "/%016llx" SAMPLE_CACHE_FILE_EXT, (unsigned long long)hash);
+	return cache.diskDirectory + name;
+}
+
+static int getSourceInfo(std::string path, int64_t &size, int64_t &mtime) {
+	struct stat st;
+	if(stat(path.c_str(), &st) != 0)
+		return -1;
+	size = st.st_size;
+	mtime = (int64_t)st.st_mtim.tv_sec*1000000000LL + st.st_mtim.tv_nsec;
+	return 0;
+}
+
+int SampleCache::setDiskDirectory(std::string dir) {
+	CacheState &cache = getCache();
+	if(!dir.empty() && mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+		printf("SampleCache error! Cannot create disk cache directory %s\n", dir.c_str());
+		return -1;
+	}
+	std::lock_guard<std::mutex> lock(cache.cacheMutex);
+	cache.diskDirectory = dir;
+	return 0;
+}
+
+// mappings are unlocked when unmapped, with the last SamplePtr that holds them
+void SampleCache::setLockMapped(bool lock) {
+	CacheState &cache = getCache();
+	std::lock_guard<std::mutex> guard(cache.cacheMutex);
+	cache.lockMapped = lock;
+}
+
+SamplePtr SampleCache::findOnDisk(std::string path, int chnIndex, int rate, int variant) {
+	CacheState &cache = getCache();
+	std::string cacheFile;
+	bool lockMapped;
+	{
+		std::lock_guard<std::mutex> lock(cache.cacheMutex);
+		if(cache.diskDirectory.empty())
+			return SamplePtr();
+		cacheFile = getCacheFilename(path, chnIndex, rate, variant);
+		lockMapped = cache.lockMapped;
+	}
+
+	int64_t sourceSize, sourceMtime;
+	if(getSourceInfo(path, sourceSize, sourceMtime) != 0)
+		return SamplePtr();
+
+	int fd = open(cacheFile.c_str(), O_RDONLY);
+	if(fd < 0)
+		return SamplePtr(); // not cached yet
+
+	struct stat st;
+	SampleFileHeader header;
+	if(fstat(fd, &st) != 0 || st.st_size < SAMPLE_CACHE_DATA_OFFSET || read(fd, &header, sizeof(header)) != sizeof(header)) {
+		close(fd);
+		return SamplePtr();
+	}
+
+	// anything that does not match means the file is stale, it will be overwritten
+	bool valid = memcmp(header.magic, "SMPC", 4) == 0 && header.version == SAMPLE_CACHE_FILE_VERSION && header.sampleSize == sizeof(double) &&
+				 header.chnIndex == chnIndex && header.rate == rate && header.variant == variant && header.sourceHash == hashString(path) &&
+				 header.sourceSize == sourceSize && header.sourceMtime == sourceMtime &&
+				 st.st_size == (off_t)(SAMPLE_CACHE_DATA_OFFSET + (header.frames+1)*sizeof(double));
+	if(!valid) {
+		close(fd);
+		return SamplePtr();
+	}
+
+	// pages are shared with any other process that maps the same file, read ahead now rather than faulted in by the audio thread
+	// unless locked, the kernel can still drop them under memory pressure
+	void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED | (lockMapped ? MAP_POPULATE : 0), fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED)
+		return SamplePtr();
+	madvise(mapping, st.st_size, MADV_WILLNEED);
+	if(lockMapped && mlock(mapping, st.st_size) != 0)
+		printf("SampleCache warning! Can't lock %s in memory, check RLIMIT_MEMLOCK\n", cacheFile.c_str()); // works anyway, but may page fault
+
+	return std::make_shared<SampleData>(mapping, st.st_size, SAMPLE_CACHE_DATA_OFFSET, header.frames, rate, header.fileRate, header.fileChannels);
+}
+
+int SampleCache::storeOnDisk(std::string path, int chnIndex, int rate, int variant, SamplePtr data) {
+	CacheState &cache = getCache();
+	std::string cacheFile;
+	{
+		std::lock_guard<std::mutex> lock(cache.cacheMutex);
+		if(cache.diskDirectory.empty())
+			return 0;
+		cacheFile = getCacheFilename(path, chnIndex, rate, variant);
+	}
+
+	SampleFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "SMPC", 4);
+	header.version = SAMPLE_CACHE_FILE_VERSION;
+	header.sampleSize = sizeof(double);
+	header.chnIndex = chnIndex;
+	header.rate = rate;
+	header.variant = variant;
+	header.fileRate = data->fileRate;
+	header.fileChannels = data->fileChannels;
+	header.sourceHash = hashString(path);
+	header.frames = data->frames;
+	if(getSourceInfo(path, header.sourceSize, header.sourceMtime) != 0)
+		return -1;
+
+	// written aside and then renamed, so that readers [also in other processes] never see a partial file
+	std::string tmpFile = cacheFile + "." + std::to_string(getpid()) + "." + std::to_string((unsigned long)pthread_self()) + ".tmp";
+	FILE *file = fopen(tmpFile.c_str(), "wb");
+	if(file == NULL) {
+		printf("SampleCache error! Cannot write disk cache file %s\n", tmpFile.c_str());
+		return -1;
+	}
+
+	char padded[SAMPLE_CACHE_DATA_OFFSET];
+	memset(padded, 0, sizeof(padded));
+	memcpy(padded, &header, sizeof(header));
+	bool ok = fwrite(padded, 1, sizeof(padded), file) == sizeof(padded);
+	ok = ok && fwrite(data->samples, sizeof(double), data->frames+1, file) == (size_t)(data->frames+1);
+	ok = (fclose(file) == 0) && ok;
+
+	if(!ok || rename(tmpFile.c_str(), cacheFile.c_str()) != 0) {
+		printf("SampleCache error! Cannot write disk cache file %s\n", cacheFile.c_str());
+		unlink(tmpFile.c_str());
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * SampleLoader.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: loads audio files in the background, on a pool of threads
+ */
+
+#include "SampleLoader.h"
+#include "Waveforms.h" // AudioFile
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+// workers pick jobs in submission order, jobs never throw
+struct LoaderPool {
+	std::mutex mtx;
+	std::condition_variable jobReady;
+	std::condition_variable allDone;
+	std::deque<std::function<void()>> jobs;
+	std::vector<std::thread> workers;
+	int pending; // queued plus running
+	int threadsNum;
+	bool stop;
+
+	LoaderPool();
+	void start();
+	void shutdown();
+	void submit(std::function<void()> job);
+	void workerLoop();
+};
+
+// built on first use and never destroyed, like the SampleCache its workers fill, so static destruction never waits for a load nor pulls state from under it
+static LoaderPool &getPool() {
+	static LoaderPool *pool = new LoaderPool();
+	return *pool;
+}
+
+static thread_local bool loaderThread = false;
+
+
+LoaderPool::LoaderPool() {
+	pending = 0;
+	threadsNum = -1;
+	stop = false;
+}
+
+// lets workers finish what they are doing, queued jobs are dropped
+void LoaderPool::shutdown() {
+	std::vector<std::thread> stopping;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stop = true;
+		pending -= jobs.size();
+		jobs.clear();
+		stopping.swap(workers);
+	}
+	jobReady.notify_all();
+	for(size_t i=0; i<stopping.size(); i++)
+		stopping[i].join();
+
+	std::lock_guard<std::mutex> lock(mtx);
+	stop = false; // next load starts new workers
+	allDone.notify_all();
+}
+
+// caller holds the lock
+void LoaderPool::start() {
+	int num = threadsNum;
+	if(num <= 0)
+		num = std::thread::hardware_concurrency();
+	if(num <= 0)
+		num = 1;
+	for(int i=0; i<num; i++)
+		workers.push_back(std::thread(&LoaderPool::workerLoop, this));
+}
+
+void LoaderPool::submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if(workers.empty())
+			start();
+		jobs.push_back(job);
+		pending++;
+	}
+	jobReady.notify_one();
+}
+
+void LoaderPool::workerLoop() {
+	loaderThread = true;
+	while(true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			jobReady.wait(lock, [this] { return stop || !jobs.empty(); });
+			if(stop)
+				return;
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if(--pending == 0)
+				allDone.notify_all();
+		}
+	}
+}
+
+
+std::shared_future<SamplePtr> SampleLoader::load(std::string path, int rate, int chnIndex, SampleCallback callback) {
+	auto promise = std::make_shared<std::promise<SamplePtr>>();
+	std::shared_future<SamplePtr> future = promise->get_future().share();
+
+	getPool().submit([path, rate, chnIndex, callback, promise]() {
+		SamplePtr data;
+		if(AudioFile::loadSamples(path, rate, chnIndex, data) != 0)
+			data.reset();
+		promise->set_value(data);
+		if(callback)
+			callback(data);
+	});
+
+	return future;
+}
+
+std::vector<std::shared_future<SamplePtr>> SampleLoader::load(const std::vector<std::string> &paths, int rate, std::function<void()> onComplete, int chnIndex) {
+	std::vector<std::shared_future<SamplePtr>> futures;
+	if(paths.empty()) {
+		if(onComplete)
+			onComplete();
+		return futures;
+	}
+
+	// last file to finish, whichever it is, calls onComplete
+	auto remaining = std::make_shared<std::atomic<int>>(paths.size());
+	SampleCallback countdown = [remaining, onComplete](SamplePtr) {
+		if(remaining->fetch_sub(1)==1 && onComplete)
+			onComplete();
+	};
+
+	for(size_t i=0; i<paths.size(); i++)
+		futures.push_back(load(paths[i], rate, chnIndex, countdown));
+	return futures;
+}
+
+void SampleLoader::waitAll() {
+	LoaderPool &pool = getPool();
+	std::unique_lock<std::mutex> lock(pool.mtx);
+	pool.allDone.wait(lock, [&pool] { return pool.pending == 0; });
+}
+
+int SampleLoader::getPendingNum() {
+	LoaderPool &pool = getPool();
+	std::lock_guard<std::mutex> lock(pool.mtx);
+	return pool.pending;
+}
+
+void SampleLoader::shutdown() {
+	getPool().shutdown();
+}
+
+bool SampleLoader::isLoaderThread() {
+	return loaderThread;
+}
+
+void SampleLoader::setThreadsNum(int numOfThreads) {
+	LoaderPool &pool = getPool();
+	std::lock_guard<std::mutex> lock(pool.mtx);
+	if(!pool.workers.empty()) {
+		printf("SampleLoader error! Number of threads must be set before first load\n");
+		return;
+	}
+	pool.threadsNum = numOfThreads;
+}
@@ -0,0 +1,406 @@
+/*
+ * StreamingAudioFile.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: audio file player that streams from disk, only the head of the file and a read-ahead window are kept in memory
+ */
+
+#include "StreamingAudioFile.h"
+#include "priority_utils.h"
+
+#include <stdio.h>
+#include <algorithm> // reverse
+
+
+// below the audio thread, the read-ahead covers for its latency
+int StreamingAudioFile::prioReader = 4;
+
+StreamingAudioFile::StreamingAudioFile() : MultichannelOutUtils(this) {
+	sndfile = NULL;
+	memset(&sfinfo, 0, sizeof(sfinfo));
+	chnIndex = -1;
+	frameNum = 0;
+	isPlaying = false;
+	pendingCommand = STREAM_CMD_NONE;
+	head = NULL;
+	headFrames = 0;
+	inHead = false;
+	currentFrame = 0;
+	direction = 1;
+	serial = 0;
+	chunk = NULL;
+	chunkPos = 0;
+	chunkMemory = NULL;
+	advType = adv_oneShot_;
+	loopStart = 0;
+	loopEnd = 0;
+	underruns = 0;
+	stopReader = false;
+	readBuffer = NULL;
+	readerFrame = 0;
+	readerDirection = 1;
+	readerSerial = 0;
+	readerDone = true;
+	filePos = 0;
+	readerStarted = false;
+}
+
+StreamingAudioFile::StreamingAudioFile(advanceType adv) : StreamingAudioFile() {
+	advType = adv;
+}
+
+StreamingAudioFile::~StreamingAudioFile() {
+	closeFile();
+}
+
+int StreamingAudioFile::init(std::string filename, int rate, unsigned int periodSize, double level, int chnIndex, unsigned short outChannels, unsigned short outChnOffset,
+							 double headSeconds, double readAheadSeconds) {
+	closeFile();
+
+	memset(&sfinfo, 0, sizeof(sfinfo));
+	if( !(sndfile = sf_open((const char*)(filename.c_str()), SFM_READ, &sfinfo)) ) {
+		sf_perror(sndfile);
+		printf("StreamingAudioFile %s can't be loaded.../:\n", filename.c_str());
+		return -1;
+	}
+
+	if(sfinfo.channels !=1 && chnIndex>=sfinfo.channels) {
+		printf("StreamingAudioFile %s error! The requested channel (%d) cannot be extracted, since file only has %d channels\n", filename.c_str(), chnIndex, sfinfo.channels);
+		closeFile();
+		return -1;
+	}
+
+	// there is no room for the whole file, so no offline conversion either
+	if(sfinfo.samplerate != rate) {
+		printf("StreamingAudioFile %s error! File sample rate %d differs from audio rate %d, convert it or load it with AudioFile\n", filename.c_str(), sfinfo.samplerate, rate);
+		closeFile();
+		return -1;
+	}
+
+	this->chnIndex = (sfinfo.channels==1) ? 0 : chnIndex;
+	frameNum = sfinfo.frames;
+	filePos = 0;
+	readBuffer = new float[STREAM_CHUNK_FRAMES*sfinfo.channels];
+
+	// head is read once and stays in memory
+	headFrames = headSeconds*rate;
+	if(headFrames > frameNum)
+		headFrames = frameNum;
+	head = new double[headFrames];
+	float *chunkBuff = new float[STREAM_CHUNK_FRAMES];
+	for(long f=0; f<headFrames; f+=STREAM_CHUNK_FRAMES) {
+		int len = std::min((long)STREAM_CHUNK_FRAMES, headFrames-f);
+		readFrames(f, len, chunkBuff);
+		for(int n=0; n<len; n++)
+			head[f+n] = chunkBuff[n];
+	}
+	delete[] chunkBuff;
+
+	// read-ahead, all chunks in one block
+	int chunksNum = (readAheadSeconds*rate + STREAM_CHUNK_FRAMES-1)/STREAM_CHUNK_FRAMES;
+	if(chunksNum < 2)
+		chunksNum = 2;
+	chunksNum = ring.init(chunksNum);
+	chunkMemory = new float[chunksNum*STREAM_CHUNK_FRAMES];
+	for(int c=0; c<chunksNum; c++)
+		ring.getSlot(c)->samples = chunkMemory + c*STREAM_CHUNK_FRAMES;
+
+	loopStart = 0;
+	loopEnd = frameNum;
+
+	AudioModuleOut::init(periodSize, outChannels, outChnOffset);
+	setLevel(level);
+
+	underruns = 0;
+	request(0, 1);
+
+	stopReader = false;
+	sem_init(&readerSem, 0, 0);
+	pthread_create(&readerThread, NULL, readerLoop, this);
+	readerStarted = true;
+
+	pendingCommand = STREAM_CMD_NONE;
+	isPlaying = true; // starts playing
+	return 0;
+}
+
+double **StreamingAudioFile::getFrameBuffer(int numOfSamples) {
+	double *out = framebuffer[out_chn_offset];
+	int done = 0;
+
+	long command = pendingCommand.exchange(STREAM_CMD_NONE);
+	if(command != STREAM_CMD_NONE)
+		applyCommand(command);
+
+	if(isPlaying) {
+		bool consumed = false;
+		while(done < numOfSamples) {
+			// straight from memory
+			if(inHead) {
+				int len = std::min((long)(numOfSamples-done), headFrames-currentFrame);
+				memcpy(out+done, head+currentFrame, len*sizeof(double));
+				done += len;
+				currentFrame += len;
+				if(currentFrame == headFrames)
+					inHead = false;
+				continue;
+			}
+
+			// next chunk, skipping those queued before last retrigger
+			if(chunk == NULL) {
+				chunk = ring.getReadSlot();
+				while(chunk != NULL && chunk->serial != serial) {
+					ring.pop();
+					consumed = true;
+					chunk = ring.getReadSlot();
+				}
+				if(chunk == NULL) {
+					underruns++;
+					break;
+				}
+				chunkPos = 0;
+			}
+
+			int len = std::min(numOfSamples-done, chunk->len-chunkPos);
+			for(int n=0; n<len; n++)
+				out[done+n] = chunk->samples[chunkPos+n];
+			done += len;
+			chunkPos += len;
+			currentFrame = chunk->frame + chunkPos*chunk->direction;
+			direction = chunk->direction;
+
+			if(chunkPos == chunk->len) {
+				bool last = chunk->last;
+				ring.pop();
+				consumed = true;
+				chunk = NULL;
+				if(last) {
+					isPlaying = false;
+					break;
+				}
+			}
+		}
+		// wake up reader, there is room for more
+		if(consumed)
+			sem_post(&readerSem);
+
+		for(int n=0; n<done; n++)
+			out[n] *= level;
+	}
+	memset(out+done, 0, (period_size-done)*sizeof(double));
+
+	MultichannelOutUtils::cloneFrameChannels(numOfSamples);
+
+	return framebuffer;
+}
+
+void StreamingAudioFile::retrigger(unsigned long frameN) {
+	if(frameN >= (unsigned long)frameNum)
+		frameN = 0;
+	pendingCommand = (long)frameN;
+}
+
+void StreamingAudioFile::setLoopPoints(unsigned long start, unsigned long end) {
+	if(end == 0 || end > (unsigned long)frameNum)
+		end = frameNum;
+	if(start >= end) {
+		printf("StreamingAudioFile error! Loop start %lu must come before loop end %lu\n", start, end);
+		return;
+	}
+	loopStart = start;
+	loopEnd = end;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// audio thread side of transport calls, they touch the ring as its consumer
+void StreamingAudioFile::applyCommand(long command) {
+	if(command == STREAM_CMD_STOP)
+		isPlaying = false;
+	else if(command == STREAM_CMD_RESUME) {
+		isPlaying = true;
+		request(currentFrame, direction); // same direction as before stop
+	}
+	else {
+		isPlaying = true;
+		request(command, 1);
+	}
+}
+
+// audio thread side of a jump, the reader starts over from the new position while queued chunks become stale
+void StreamingAudioFile::request(long frame, char dir) {
+	serial++;
+	// drop what is queued now, so that the reader has room to start over right away
+	chunk = NULL;
+	while(ring.getReadSlot() != NULL)
+		ring.pop();
+	currentFrame = frame;
+	direction = dir;
+
+	// head is used only if playhead can get to its end going forward without wrapping
+	long end = (advType == adv_oneShot_) ? frameNum : loopEnd.load();
+	inHead = (dir == 1 && frame < headFrames && headFrames <= end);
+
+	StreamRequest *req = requests.getWriteSlot();
+	req->frame = inHead ? headFrames : frame;
+	req->direction = dir;
+	req->serial = serial;
+	requests.publish();
+
+	if(readerStarted)
+		sem_post(&readerSem);
+}
+
+// next chunk along the playback path, same turns that Waveform takes at the edges
+void StreamingAudioFile::readChunk(StreamChunk *out) {
+	int adv = advType;
+	long start = 0;
+	long end = frameNum;
+	if(adv != adv_oneShot_) {
+		start = loopStart;
+		end = loopEnd;
+		// points are not updated together, might be caught half way
+		if(start >= end) {
+			start = 0;
+			end = frameNum;
+		}
+	}
+	if(adv != adv_backAndForth_)
+		readerDirection = 1;
+
+	out->len = 0;
+	out->last = false;
+
+	// bring position back inside region
+	if(readerDirection == 1 && readerFrame >= end) {
+		if(adv == adv_oneShot_) {
+			out->frame = frameNum;
+			out->direction = 1;
+			out->last = true;
+			readerDone = true;
+			return;
+		}
+		else if(adv == adv_loop_)
+			readerFrame = start;
+		else {
+			readerDirection = -1;
+			readerFrame = std::max(start, end-2);
+		}
+	}
+	else if(readerDirection == -1 && readerFrame < start) {
+		readerDirection = 1;
+		readerFrame = std::min(start+1, end-1);
+	}
+
+	if(readerDirection == 1) {
+		int len = std::min((long)STREAM_CHUNK_FRAMES, end-readerFrame);
+		readFrames(readerFrame, len, out->samples);
+		out->frame = readerFrame;
+		out->len = len;
+		readerFrame += len;
+		if(adv == adv_oneShot_ && readerFrame >= end) {
+			out->last = true;
+			readerDone = true;
+		}
+	}
+	else {
+		if(readerFrame >= end)
+			readerFrame = end-1;
+		int len = std::min((long)STREAM_CHUNK_FRAMES, readerFrame-start+1);
+		readFrames(readerFrame-len+1, len, out->samples);
+		std::reverse(out->samples, out->samples+len);
+		out->frame = readerFrame;
+		out->len = len;
+		readerFrame -= len;
+	}
+	out->direction = readerDirection;
+}
+
+// one channel or average of all of them
+int StreamingAudioFile::readFrames(long start, int len, float *out) {
+	if(filePos != start)
+		sf_seek(sndfile, start, SEEK_SET);
+	int readcount = sf_readf_float(sndfile, readBuffer, len);
+	if(readcount < 0)
+		readcount = 0;
+	filePos = start + readcount;
+
+	int chns = sfinfo.channels;
+	if(chns == 1)
+		memcpy(out, readBuffer, readcount*sizeof(float));
+	else if(chnIndex == -1) {
+		for(int n=0; n<readcount; n++) {
+			float sum = 0;
+			for(int c=0; c<chns; c++)
+				sum += readBuffer[n*chns + c];
+			out[n] = sum/chns;
+		}
+	}
+	else {
+		for(int n=0; n<readcount; n++)
+			out[n] = readBuffer[n*chns + chnIndex];
+	}
+	memset(out+readcount, 0, (len-readcount)*sizeof(float)); // pad with zeros in case we couldn't read whole chunk
+
+	return readcount;
+}
+
+void StreamingAudioFile::closeFile() {
+	if(readerStarted) {
+		stopReader = true;
+		sem_post(&readerSem);
+		pthread_join(readerThread, NULL);
+		sem_destroy(&readerSem);
+		readerStarted = false;
+	}
+	isPlaying = false;
+	chunk = NULL;
+
+	if(sndfile != NULL) {
+		sf_close(sndfile);
+		sndfile = NULL;
+	}
+	if(head != NULL) {
+		delete[] head;
+		head = NULL;
+	}
+	if(chunkMemory != NULL) {
+		delete[] chunkMemory;
+		chunkMemory = NULL;
+	}
+	if(readBuffer != NULL) {
+		delete[] readBuffer;
+		readBuffer = NULL;
+	}
+}
+
+void *StreamingAudioFile::readerLoop(void *arg) {
+	StreamingAudioFile *that = (StreamingAudioFile *)arg;
+	if(prioReader >= 0)
+		set_priority(prioReader);
+
+	while(!that->stopReader) {
+		if(that->requests.update()) {
+			StreamRequest *req = that->requests.getReadSlot();
+			that->readerFrame = req->frame;
+			that->readerDirection = req->direction;
+			that->readerSerial = req->serial;
+			that->readerDone = false;
+		}
+
+		// sleep when done or when ring is full, audio thread wakes us up
+		StreamChunk *slot = that->readerDone ? NULL : that->ring.getWriteSlot();
+		if(slot == NULL) {
+			sem_wait(&that->readerSem);
+			continue;
+		}
+
+		that->readChunk(slot);
+		slot->serial = that->readerSerial;
+		that->ring.push();
+	}
+
+	return NULL;
+}
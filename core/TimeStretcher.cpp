@@ -0,0 +1,446 @@
+/*
+ * TimeStretcher.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: phase vocoder over shared samples, speed and pitch can be changed independently while playing
+ */
+
+#include "TimeStretcher.h"
+#include "priority_utils.h"
+
+#include <stdio.h>
+#include <string.h> // memcpy, memmove
+#include <math.h>
+
+
+// same as streaming reader, queued blocks cover for its latency
+int TimeStretcher::prioWorker = 4;
+
+TimeStretcher::TimeStretcher() : MultichannelOutUtils(this) {
+	advType = adv_loop_;
+	isPlaying = false;
+	pendingCommand = TIMESTRETCH_CMD_NONE;
+	speed = 1;
+	pitch = 1;
+	fftSize = 0;
+	hop = 0;
+	binsNum = 0;
+	analysisFrames = 0;
+	magnitudes = NULL;
+	phases = NULL;
+	window = NULL;
+	olaGain = 1;
+	playhead = 0;
+	phaseAcc = NULL;
+	ola = NULL;
+	stream = NULL;
+	streamLen = 0;
+	readPos = 0;
+	ending = false;
+	finished = false;
+	useWorker = false;
+	blockMemory = NULL;
+	block = NULL;
+	blockPos = 0;
+	serial = 0;
+	workerSerial = 0;
+	underruns = 0;
+	stopWorker = false;
+	workerStarted = false;
+}
+
+TimeStretcher::TimeStretcher(advanceType adv) : TimeStretcher() {
+	setAdvanceType(adv);
+}
+
+TimeStretcher::~TimeStretcher() {
+	deallocate();
+}
+
+int TimeStretcher::init(SamplePtr data, unsigned int periodSize, double level, unsigned short outChannels, unsigned short outChnOffset,
+						int fftSize, bool useWorker, double aheadSeconds) {
+	if(data == NULL || data->frames < 2) {
+		printf("TimeStretcher error! No samples to play\n");
+		return -1;
+	}
+	if(fftSize < 16*TIMESTRETCH_OVERLAP || (fftSize & (fftSize-1)) != 0) {
+		printf("TimeStretcher error! FFT size must be a power of 2 not smaller than %d, %d was passed\n", 16*TIMESTRETCH_OVERLAP, fftSize);
+		return -1;
+	}
+
+	deallocate();
+
+	if(fft.init(fftSize) != 0)
+		return -1;
+
+	this->data = data;
+	this->fftSize = fftSize;
+	hop = fftSize/TIMESTRETCH_OVERLAP;
+	binsNum = fft.getBinsNum();
+
+	// periodic hann, used for both analysis and synthesis
+	window = new double[fftSize];
+	double sum = 0;
+	for(int i=0; i<fftSize; i++) {
+		window[i] = 0.5 - 0.5*cos(2*M_PI*i/fftSize);
+		sum += window[i]*window[i];
+	}
+	olaGain = hop/sum;
+
+	analyse();
+
+	phaseAcc = new double[binsNum];
+	ola = new double[fftSize];
+	stream = new double[fftSize+8]; // lead-in hops at reset, at most two hops plus interpolation points afterwards
+
+	AudioModuleOut::init(periodSize, outChannels, outChnOffset);
+	setLevel(level);
+
+	reset(0);
+
+	this->useWorker = useWorker;
+	if(useWorker) {
+		// all blocks in one allocation
+		int blocksNum = (aheadSeconds*data->rate + TIMESTRETCH_BLOCK-1)/TIMESTRETCH_BLOCK;
+		if(blocksNum < 2)
+			blocksNum = 2;
+		blocksNum = ring.init(blocksNum);
+		blockMemory = new double[blocksNum*TIMESTRETCH_BLOCK];
+		for(int b=0; b<blocksNum; b++)
+			ring.getSlot(b)->samples = blockMemory + b*TIMESTRETCH_BLOCK;
+		block = NULL;
+		serial = 0;
+		workerSerial = 0;
+		underruns = 0;
+		requests.update(); // forgets requests sent to a previous worker
+
+		stopWorker = false;
+		sem_init(&workerSem, 0, 0);
+		pthread_create(&workerThread, NULL, workerLoop, this);
+		workerStarted = true;
+	}
+
+	pendingCommand = TIMESTRETCH_CMD_NONE;
+	isPlaying = true; // starts playing
+	return 0;
+}
+
+int TimeStretcher::init(std::string filename, int rate, unsigned int periodSize, double level, int chnIndex, unsigned short outChannels, unsigned short outChnOffset,
+						int fftSize, bool useWorker, double aheadSeconds) {
+	SamplePtr data;
+	int retval = AudioFile::loadSamples(filename, rate, chnIndex, data); // same samples as AudioFiles that play this file
+	if(retval != 0)
+		return retval;
+	return init(data, periodSize, level, outChannels, outChnOffset, fftSize, useWorker, aheadSeconds);
+}
+
+double **TimeStretcher::getFrameBuffer(int numOfSamples) {
+	double *out = framebuffer[out_chn_offset];
+	int done = 0;
+
+	long command = pendingCommand.exchange(TIMESTRETCH_CMD_NONE);
+	if(command != TIMESTRETCH_CMD_NONE)
+		applyCommand(command);
+
+	if(isPlaying && data != NULL) {
+		if(!useWorker) {
+			render(out, numOfSamples);
+			done = numOfSamples;
+			if(finished)
+				isPlaying = false;
+		}
+		else {
+			bool consumed = false;
+			while(done < numOfSamples) {
+				// next block, skipping those queued before last retrigger
+				if(block == NULL) {
+					block = ring.getReadSlot();
+					while(block != NULL && block->serial != serial) {
+						ring.pop();
+						consumed = true;
+						block = ring.getReadSlot();
+					}
+					if(block == NULL) {
+						underruns++;
+						break;
+					}
+					blockPos = 0;
+				}
+
+				int len = numOfSamples-done;
+				if(len > TIMESTRETCH_BLOCK-blockPos)
+					len = TIMESTRETCH_BLOCK-blockPos;
+				memcpy(out+done, block->samples+blockPos, len*sizeof(double));
+				done += len;
+				blockPos += len;
+
+				if(blockPos == TIMESTRETCH_BLOCK) {
+					bool last = block->last;
+					ring.pop();
+					consumed = true;
+					block = NULL;
+					if(last) {
+						isPlaying = false;
+						break;
+					}
+				}
+			}
+			// wake up worker, there is room for more
+			if(consumed)
+				sem_post(&workerSem);
+		}
+
+		for(int n=0; n<done; n++)
+			out[n] *= level;
+	}
+	memset(out+done, 0, (period_size-done)*sizeof(double));
+
+	MultichannelOutUtils::cloneFrameChannels(numOfSamples);
+
+	return framebuffer;
+}
+
+void TimeStretcher::retrigger(unsigned long frameN) {
+	if(data == NULL)
+		return;
+	if(frameN >= (unsigned long)data->frames)
+		frameN = 0;
+	pendingCommand = (long)frameN;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// magnitude and phase of all frames, the first ones lead into the samples so that their first hop is complete
+void TimeStretcher::analyse() {
+	const int lead = TIMESTRETCH_OVERLAP-1;
+	long frames = data->frames;
+	analysisFrames = (frames+hop-1)/hop + lead;
+	magnitudes = new float[analysisFrames*binsNum];
+	phases = new float[analysisFrames*binsNum];
+
+	double *samples = fft.getSamples();
+	fftw_complex *bins = fft.getBins();
+	for(long t=0; t<analysisFrames; t++) {
+		long start = (t-lead)*hop;
+		for(int i=0; i<fftSize; i++) {
+			long j = start+i;
+			samples[i] = (j >= 0 && j < frames) ? data->samples[j]*window[i] : 0;
+		}
+		fft.forward();
+
+		float *mag = magnitudes + t*binsNum;
+		float *ph = phases + t*binsNum;
+		for(int k=0; k<binsNum; k++) {
+			mag[k] = sqrt(bins[k][0]*bins[k][0] + bins[k][1]*bins[k][1]);
+			ph[k] = atan2(bins[k][1], bins[k][0]);
+		}
+	}
+}
+
+// synthesis state starts over at a sample
+// the lead-in hops are synthesized and thrown away, so that the first one that is played is complete
+void TimeStretcher::reset(long frame) {
+	const int lead = TIMESTRETCH_OVERLAP-1;
+	double step = speed.load(std::memory_order_relaxed)/pitch.load(std::memory_order_relaxed);
+	playhead = (double)frame/hop + lead - lead*step;
+	if(playhead < 0)
+		playhead = 0;
+
+	// phases of the frame we start from, so that at speed 1 the samples come back as they are
+	const float *ph = phases + ((long)playhead)*binsNum;
+	for(int k=0; k<binsNum; k++)
+		phaseAcc[k] = ph[k];
+
+	memset(ola, 0, fftSize*sizeof(double));
+	ending = false;
+	finished = false;
+	streamLen = 0;
+	for(int i=0; i<lead; i++)
+		synthesizeHop();
+
+	// last thrown away sample is kept for interpolation
+	stream[0] = stream[streamLen-1];
+	streamLen = 1;
+	readPos = 1;
+}
+
+// resamples synthesized stream by pitch, cost is at most TIMESTRETCH_MAX_PITCH hops per hop of output
+void TimeStretcher::render(double *out, int numOfSamples) {
+	double p = pitch.load(std::memory_order_relaxed);
+	for(int n=0; n<numOfSamples; n++) {
+		if(readPos >= hop+1) {
+			memmove(stream, stream+hop, (streamLen-hop)*sizeof(double));
+			streamLen -= hop;
+			readPos -= hop;
+		}
+		int i = (int)readPos;
+		while(i+2 >= streamLen)
+			synthesizeHop();
+
+		// 4 point hermite, exact when pitch is 1
+		const double *s = stream+i-1;
+		double frac = readPos-i;
+		double c1 = 0.5*(s[2]-s[0]);
+		double c2 = s[0] - 2.5*s[1] + 2*s[2] - 0.5*s[3];
+		double c3 = 0.5*(s[3]-s[0]) + 1.5*(s[1]-s[2]);
+		out[n] = ((c3*frac + c2)*frac + c1)*frac + s[1];
+
+		readPos += p;
+	}
+}
+
+// one frame at playhead into the accumulator, then one hop out of it
+void TimeStretcher::synthesizeHop() {
+	if(ending)
+		finished = true; // everything that was synthesized has been played
+	else if(!finished) {
+		long t = (long)playhead;
+		double frac = playhead-t;
+		long next = (t+1 < analysisFrames) ? t+1 : t;
+		const float *m0 = magnitudes + t*binsNum;
+		const float *m1 = magnitudes + next*binsNum;
+		const float *p0 = phases + t*binsNum;
+		const float *p1 = phases + next*binsNum;
+
+		fftw_complex *bins = fft.getBins();
+		double expectedStep = 2*M_PI*hop/fftSize;
+		for(int k=0; k<binsNum; k++) {
+			double mag = m0[k] + frac*(m1[k]-m0[k]);
+			bins[k][0] = mag*cos(phaseAcc[k]);
+			bins[k][1] = mag*sin(phaseAcc[k]);
+
+			// advance over a hop, with the frequency measured between the two frames around playhead
+			double expected = k*expectedStep;
+			double dev = p1[k]-p0[k]-expected;
+			dev -= 2*M_PI*rint(dev/(2*M_PI));
+			double ph = phaseAcc[k] + expected + dev;
+			phaseAcc[k] = ph - 2*M_PI*rint(ph/(2*M_PI));
+		}
+
+		fft.inverse();
+		const double *samples = fft.getSamples();
+		for(int i=0; i<fftSize; i++)
+			ola[i] += samples[i]*window[i]*olaGain;
+
+		// slower stream when pitch is higher, it is resampled faster
+		playhead += speed.load(std::memory_order_relaxed)/pitch.load(std::memory_order_relaxed);
+		if(advType == adv_loop_) {
+			const int lead = TIMESTRETCH_OVERLAP-1;
+			double loopLen = (double)data->frames/hop;
+			if(playhead >= lead+loopLen)
+				playhead = lead + fmod(playhead-lead, loopLen);
+		}
+		else if(playhead > analysisFrames-1)
+			ending = true;
+	}
+
+	memcpy(stream+streamLen, ola, hop*sizeof(double));
+	streamLen += hop;
+	memmove(ola, ola+hop, (fftSize-hop)*sizeof(double));
+	memset(ola+fftSize-hop, 0, hop*sizeof(double));
+}
+
+// audio thread side of transport calls, jumps touch the ring as its consumer or the synthesis state
+void TimeStretcher::applyCommand(long command) {
+	if(command == TIMESTRETCH_CMD_STOP)
+		isPlaying = false;
+	else if(command == TIMESTRETCH_CMD_RESUME)
+		isPlaying = true; // goes on from where it stopped
+	else {
+		isPlaying = true;
+		if(useWorker)
+			request(command);
+		else
+			reset(command);
+	}
+}
+
+// audio thread side of a jump, the worker starts over from the new position while queued blocks become stale
+void TimeStretcher::request(long frame) {
+	serial++;
+	// drop what is queued now, so that the worker has room to start over right away
+	block = NULL;
+	while(ring.getReadSlot() != NULL)
+		ring.pop();
+
+	StretchRequest *req = requests.getWriteSlot();
+	req->frame = frame;
+	req->serial = serial;
+	requests.publish();
+
+	if(workerStarted)
+		sem_post(&workerSem);
+}
+
+void TimeStretcher::deallocate() {
+	if(workerStarted) {
+		stopWorker = true;
+		sem_post(&workerSem);
+		pthread_join(workerThread, NULL);
+		sem_destroy(&workerSem);
+		workerStarted = false;
+	}
+	isPlaying = false;
+	useWorker = false;
+	block = NULL;
+
+	if(magnitudes != NULL) {
+		delete[] magnitudes;
+		magnitudes = NULL;
+	}
+	if(phases != NULL) {
+		delete[] phases;
+		phases = NULL;
+	}
+	if(window != NULL) {
+		delete[] window;
+		window = NULL;
+	}
+	if(phaseAcc != NULL) {
+		delete[] phaseAcc;
+		phaseAcc = NULL;
+	}
+	if(ola != NULL) {
+		delete[] ola;
+		ola = NULL;
+	}
+	if(stream != NULL) {
+		delete[] stream;
+		stream = NULL;
+	}
+	if(blockMemory != NULL) {
+		delete[] blockMemory;
+		blockMemory = NULL;
+	}
+	data.reset();
+}
+
+void *TimeStretcher::workerLoop(void *arg) {
+	TimeStretcher *that = (TimeStretcher *)arg;
+	if(prioWorker >= 0)
+		set_priority(prioWorker);
+
+	while(!that->stopWorker) {
+		if(that->requests.update()) {
+			StretchRequest *req = that->requests.getReadSlot();
+			that->reset(req->frame);
+			that->workerSerial = req->serial;
+		}
+
+		// sleep when done or when ring is full, audio thread wakes us up
+		StretchBlock *slot = that->finished ? NULL : that->ring.getWriteSlot();
+		if(slot == NULL) {
+			sem_wait(&that->workerSem);
+			continue;
+		}
+
+		that->render(slot->samples, TIMESTRETCH_BLOCK);
+		slot->last = that->finished;
+		slot->serial = that->workerSerial;
+		that->ring.push();
+	}
+
+	return NULL;
+}
@@ -69,6 +69,10 @@ bool UdpServer::bindToPort(int aPort){
 	return true;
 }
 
+int UdpServer::getSocket() const{
+	return inSocket;
+}
+
 void UdpServer::close(){
 	int ret=::close(inSocket);
 	if(ret != 0)
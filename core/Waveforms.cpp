@@ -6,9 +6,15 @@
  */
 
 #include "Waveforms.h"
+#include "FFT.h"
+#include "Random.h"
+#include "SampleLoader.h"
 
 #include <algorithm> // reverse_copy
 #include <limits> // for last frame
+#include <map>   // mip tables cache
+#include <tuple>
+#include <mutex>
 
 
 //----------------------------------------------------------------------------------------------------------------------------
@@ -19,9 +25,14 @@ Waveform::Waveform() : MultichannelOutUtils(this) {
 	currentFrame = -1;
 	direction	  = 0;
 	waveFormBuffer = NULL;
+	swapPending   = false;
 	frameNum      = -1;
 	lastFrame	  = std::numeric_limits<unsigned long>::max();
 	isPlaying     = false;
+	playbackRate  = 1;
+	rateInc       = 1LL<<WAVETABLE_FRAC_BITS;
+	frameFrac     = 0;
+	interpolation = interp_hermite_;
 
 	advanceSample   = NULL;
 	getBufferMethod = NULL;
@@ -32,8 +43,13 @@ Waveform::Waveform(advanceType adv) : MultichannelOutUtils(this) {
 	currentFrame = -1;
 	direction	  = 0;
 	waveFormBuffer = NULL;
+	swapPending   = false;
 	frameNum      = -1;
 	isPlaying     = false;
+	playbackRate  = 1;
+	rateInc       = 1LL<<WAVETABLE_FRAC_BITS;
+	frameFrac     = 0;
+	interpolation = interp_hermite_;
 
 	advanceSample   = NULL;
 	getBufferMethod = NULL;
@@ -44,8 +60,9 @@ void Waveform::init(double *samples, int len, unsigned int periodSize, double le
 
 	frameNum = len;
 
-	if(waveFormBuffer!=NULL)
-		delete waveFormBuffer;
+	if(waveFormBuffer!=NULL && sharedData==NULL)
+		delete[] waveFormBuffer;
+	sharedData.reset();
 	waveFormBuffer = new double[frameNum+1]; // +1 for silent frame
 	// copy samples
 	memcpy(waveFormBuffer, samples, sizeof(double)*frameNum);
@@ -53,6 +70,28 @@ void Waveform::init(double *samples, int len, unsigned int periodSize, double le
 
 	direction	  = 1; // go forward
 	currentFrame = 0;
+	frameFrac    = 0;
+
+	setAdvanceSampleMethod();
+
+	setLevel(level);
+
+	isPlaying = true; // starts playing
+}
+
+void Waveform::init(SamplePtr data, unsigned int periodSize, double level, unsigned short outChannels, unsigned short outChnOffset) {
+	AudioModuleOut::init(periodSize, outChannels, outChnOffset);
+
+	frameNum = data->frames;
+
+	if(waveFormBuffer!=NULL && sharedData==NULL)
+		delete[] waveFormBuffer;
+	sharedData = data; // keeps samples alive, even if evicted from cache
+	waveFormBuffer = data->samples; // already has silent frame
+
+	direction	  = 1; // go forward
+	currentFrame = 0;
+	frameFrac    = 0;
 
 	setAdvanceSampleMethod();
 
@@ -67,6 +106,13 @@ void Waveform::reverse() {
 		return;
 	}
 
+	// shared samples are read-only, so get a private copy first
+	if(sharedData!=NULL) {
+		waveFormBuffer = new double[frameNum+1];
+		memcpy(waveFormBuffer, sharedData->samples, sizeof(double)*(frameNum+1));
+		sharedData.reset();
+	}
+
 	double tmp;
 	// reverse frames, leaving silent frame at the end [full length would be frameNum+1]
 	for(unsigned int i=0; i<frameNum/2; i++) {
@@ -76,21 +122,51 @@ void Waveform::reverse() {
 	}
 }
 
+int Waveform::swapData(SamplePtr data) {
+	if(swapPending.load(std::memory_order_acquire)) {
+		printf("Waveform error! Previous samples have not been picked up yet\n");
+		return -1;
+	}
+	if(waveFormBuffer!=NULL && sharedData==NULL) {
+		printf("Waveform error! Only shared samples can be swapped\n");
+		return -1;
+	}
+
+	pendingData = data; // this also releases samples swapped out last time
+	swapPending.store(true, std::memory_order_release);
+	return 0;
+}
+
 double Waveform::getSample() {
-	if(!isPlaying)
+	if(swapPending.load(std::memory_order_acquire))
+		adoptPendingData();
+	if(!isPlaying || waveFormBuffer==NULL)
 		return 0;
 
-	double sample = waveFormBuffer[currentFrame];
-	(this->*advanceSample) (); // inline
+	double sample;
+	if(rateInc == (1LL<<WAVETABLE_FRAC_BITS) && frameFrac == 0) {
+		sample = waveFormBuffer[currentFrame];
+		(this->*advanceSample) (); // inline
+	}
+	else
+		renderVarispeed(&sample, 1);
 
 	return sample*level;
 }
 
 double **Waveform::getFrameBuffer(int numOfSamples){
-	if(!isPlaying)
+	if(swapPending.load(std::memory_order_acquire))
+		adoptPendingData();
+
+	if(!isPlaying || waveFormBuffer==NULL) // placeholders have no samples
 		memset(framebuffer[out_chn_offset], 0, numOfSamples*sizeof(double));
 	else {
-		(this->*getBufferMethod) (numOfSamples);
+		// straight copies when playhead moves one whole frame at a time
+		// they wrap at most once per period, so waveforms shorter than that go through interpolation too [exact on whole frames]
+		if(rateInc == (1LL<<WAVETABLE_FRAC_BITS) && frameFrac == 0 && frameNum >= (unsigned long)numOfSamples)
+			(this->*getBufferMethod) (numOfSamples);
+		else
+			renderVarispeed(framebuffer[out_chn_offset], numOfSamples);
 		for(int n=0; n<numOfSamples; n++)
 			framebuffer[out_chn_offset][n] *= level;
 
@@ -105,6 +181,20 @@ double **Waveform::getFrameBuffer(int numOfSamples){
 // protected methods
 //----------------------------------------------------------------------------------------------------------------------------
 
+// audio thread side of swapData(), only pointers change hands here
+void Waveform::adoptPendingData() {
+	sharedData.swap(pendingData); // previous samples are released by next swapData() or by destructor
+	waveFormBuffer = sharedData->samples;
+	frameNum = sharedData->frames;
+
+	direction	  = 1; // go forward
+	currentFrame = 0;
+	frameFrac    = 0;
+	isPlaying = true; // starts playing, as after init
+
+	swapPending.store(false, std::memory_order_release);
+}
+
 void Waveform::setAdvanceSampleMethod() {
 	switch(advType) {
 		case adv_oneShot_:
@@ -134,7 +224,7 @@ double *Waveform::getBufferOneShot(int numOfSamples) {
 			currentFrame += numOfSamples; // update
 		} else { // otherwise we have to pad with zeros
 			memcpy(framebuffer[out_chn_offset], waveFormBuffer+currentFrame, sizeof(double)*(frameNum-currentFrame)); // put at the beginning of framebuffer[out_chn_offset] all the file samples that are in a row
-			memset(framebuffer[out_chn_offset]+frameNum-currentFrame+1, 0, sizeof(double)*overflow); // then fill the rest of the sample buffer with zeros
+			memset(framebuffer[out_chn_offset]+frameNum-currentFrame, 0, sizeof(double)*overflow); // then fill the rest of the sample buffer with zeros
 			currentFrame = frameNum; // update
 		}
 	}
@@ -152,8 +242,8 @@ double *Waveform::getBufferLoop(int numOfSamples){
 		currentFrame += numOfSamples; // update
 	} else { // otherwise we have to start from beginning
 		memcpy(framebuffer[out_chn_offset], waveFormBuffer+currentFrame, sizeof(double)*(frameNum-currentFrame)); // put in beginning of framebuffer[out_chn_offset] all the file samples that are in a row
-		memcpy(framebuffer[out_chn_offset]+frameNum-currentFrame+1, waveFormBuffer, sizeof(double)*overflow); // then fill the rest of the sample buffer with the first file samples
-		currentFrame = overflow+1; // update
+		memcpy(framebuffer[out_chn_offset]+frameNum-currentFrame, waveFormBuffer, sizeof(double)*overflow); // then fill the rest of the sample buffer with the first file samples
+		currentFrame = overflow; // update
 	}
 	return framebuffer[out_chn_offset];
 }
@@ -168,19 +258,19 @@ double *Waveform::getBufferBackAndForth(int numOfSamples) {
 			currentFrame += numOfSamples; // update
 		} else { // otherwise we reach the end of the file and then go backwards
 			memcpy(framebuffer[out_chn_offset], waveFormBuffer+currentFrame, sizeof(double)*(frameNum-currentFrame)); // put at the beginning of framebuffer[out_chn_offset] all the file samples that are in a row
-			std::reverse_copy(waveFormBuffer+frameNum-1-overflow, waveFormBuffer+frameNum-1, framebuffer[out_chn_offset]+frameNum-currentFrame+1); // then fill the rest of the sample buffer with the reversed file samples [the last sample is skipped backwards]
+			std::reverse_copy(waveFormBuffer+frameNum-1-overflow, waveFormBuffer+frameNum-1, framebuffer[out_chn_offset]+frameNum-currentFrame); // then fill the rest of the sample buffer with the reversed file samples [the last sample is skipped backwards]
 			currentFrame = frameNum-2-overflow; // update
 			direction = -1;	// officially change direction
 		}
 	}
 	else { // backwards
-		int overflow = numOfSamples-currentFrame;
-		if(overflow<=0) { // if we pick frames that are all in a row within the buffer
+		int overflow = numOfSamples-(currentFrame+1); // frame 0 is played too
+		if(overflow<0) { // if we pick frames that are all in a row within the buffer
 			std::reverse_copy(waveFormBuffer+currentFrame+1-numOfSamples, waveFormBuffer+currentFrame+1, framebuffer[out_chn_offset]);// simply put at the beginning of framebuffer[out_chn_offset] all the file samples that are in a row from current position, in reverse order
 			currentFrame -= numOfSamples; // update
 		} else { // otherwise we go backwards
 			std::reverse_copy(waveFormBuffer, waveFormBuffer+currentFrame+1, framebuffer[out_chn_offset]); // put at the beginning of framebuffer[out_chn_offset] all the reversed file samples that are in a row
-			memcpy(framebuffer[out_chn_offset]+numOfSamples-overflow, waveFormBuffer+1,  sizeof(double)*overflow); // then fill the rest of the sample buffer with the first file samples [the first sample is skipped forward]
+			memcpy(framebuffer[out_chn_offset]+currentFrame+1, waveFormBuffer+1,  sizeof(double)*overflow); // then fill the rest of the sample buffer with the first file samples [the first sample is skipped forward]
 			currentFrame = overflow+1; // update
 			direction = 1; // officially change direction
 		}
@@ -188,6 +278,137 @@ double *Waveform::getBufferBackAndForth(int numOfSamples) {
 
 	return framebuffer[out_chn_offset];
 }
+
+// what the playhead finds past the edges, so that interpolation near them needs no guard frames
+double Waveform::getFrameOutside(long i) {
+	long len = frameNum;
+	if(i>=0 && i<len)
+		return waveFormBuffer[i];
+
+	if(advType == adv_loop_) {
+		i %= len;
+		return waveFormBuffer[(i<0) ? i+len : i];
+	}
+	else if(advType == adv_backAndForth_) {
+		if(len == 1)
+			return waveFormBuffer[0];
+		long period = 2*(len-1);
+		i %= period;
+		if(i < 0)
+			i += period;
+		return waveFormBuffer[(i<len) ? i : period-i];
+	}
+	return 0; // silence around one shot
+}
+
+// same turns that getBuffer methods take at the edges, but at fractional positions
+void Waveform::wrapPlayhead(int64_t &pos) {
+	int64_t len = (int64_t)frameNum << WAVETABLE_FRAC_BITS;
+	int64_t last = len - (1LL<<WAVETABLE_FRAC_BITS);
+
+	if(advType == adv_loop_) {
+		if(pos >= len)
+			pos %= len;
+	}
+	else if(advType == adv_backAndForth_) {
+		if(direction == 1 && pos > last) {
+			pos = 2*last - pos;
+			direction = -1;
+		}
+		else if(direction == -1 && pos < 0) {
+			pos = -pos;
+			direction = 1;
+		}
+		// steps longer than the waveform
+		if(pos < 0)
+			pos = 0;
+		else if(pos > last)
+			pos = last;
+	}
+	else if(pos > len)
+		pos = len; // one shot, parked on silent frame
+}
+
+void Waveform::renderVarispeed(double *out, int numOfSamples) {
+	switch(interpolation) {
+		case interp_lin_:
+			renderVarispeedBlock<interp_lin_>(out, numOfSamples);
+			break;
+		case interp_cubic_:
+			renderVarispeedBlock<interp_cubic_>(out, numOfSamples);
+			break;
+		case interp_hermite_:
+			renderVarispeedBlock<interp_hermite_>(out, numOfSamples);
+			break;
+		default:
+			renderVarispeedBlock<interp_no_>(out, numOfSamples);
+			break;
+	}
+}
+
+// playhead moves in runs that stay clear of the edges, within a run each position is computed independently, so 4 samples at a time can be unrolled and vectorized
+// only the few samples close to an edge take the slow path
+template<int interp>
+void Waveform::renderVarispeedBlock(double *out, int numOfSamples) {
+	const int64_t len = (int64_t)frameNum << WAVETABLE_FRAC_BITS;
+	const int before = (interp == interp_cubic_ || interp == interp_hermite_) ? 1 : 0; // neighbour frames read by interpolation
+	const int after  = (interp == interp_cubic_ || interp == interp_hermite_) ? 2 : (interp == interp_lin_) ? 1 : 0;
+	const int64_t safeStart = (int64_t)before << WAVETABLE_FRAC_BITS;
+	int64_t safeEnd = ((int64_t)frameNum-after) * (1LL<<WAVETABLE_FRAC_BITS); // excluded, negative if waveform is shorter than interpolation window
+	if(advType == adv_backAndForth_ && safeEnd > len-(1LL<<WAVETABLE_FRAC_BITS))
+		safeEnd = len-(1LL<<WAVETABLE_FRAC_BITS); // turns on last frame
+
+	int64_t pos = ((int64_t)currentFrame << WAVETABLE_FRAC_BITS) | frameFrac;
+	int n = 0;
+	while(n < numOfSamples) {
+		wrapPlayhead(pos);
+		if(advType == adv_oneShot_ && pos >= len) {
+			memset(out+n, 0, (numOfSamples-n)*sizeof(double));
+			if(n == 0)
+				isPlaying = false; // as in getBufferOneShot(), whole period after the end
+			break;
+		}
+
+		int64_t step = (advType == adv_backAndForth_ && direction == -1) ? -rateInc : rateInc;
+
+		int64_t run = 0;
+		if(pos >= safeStart && pos < safeEnd)
+			run = (step > 0) ? (safeEnd-1-pos)/step + 1 : (pos-safeStart)/(-step) + 1;
+		if(run > numOfSamples-n)
+			run = numOfSamples-n;
+
+		if(run > 0) {
+			int64_t step4 = 4*step;
+			int j = 0;
+			for(; j+4<=run; j+=4) {
+				int64_t p[4];
+				for(int k=0; k<4; k++)
+					p[k] = pos + k*step;
+				for(int k=0; k<4; k++)
+					out[n+j+k] = interpolate<interp>(waveFormBuffer, p[k]);
+				pos += step4;
+			}
+			for(; j<run; j++) {
+				out[n+j] = interpolate<interp>(waveFormBuffer, pos);
+				pos += step;
+			}
+			n += run;
+			continue;
+		}
+
+		// close to an edge, neighbours are fetched one by one
+		long i = (long)(pos >> WAVETABLE_FRAC_BITS);
+		double neighbours[4];
+		for(int k=0; k<4; k++)
+			neighbours[k] = getFrameOutside(i-1+k);
+		out[n++] = interpolate<interp>(neighbours+1, pos & WAVETABLE_FRAC_MASK);
+		pos += step;
+	}
+
+	wrapPlayhead(pos);
+	currentFrame = (unsigned long)(pos >> WAVETABLE_FRAC_BITS);
+	frameFrac = (uint32_t)(pos & WAVETABLE_FRAC_MASK);
+}
 //----------------------------------------------------------------------------------------------------------------------------
 //----------------------------------------------------------------------------------------------------------------------------
 
@@ -206,6 +427,9 @@ double *Waveform::getBufferBackAndForth(int numOfSamples) {
 //----------------------------------------------------------------------------------------------------------------------------
 // AudioFile
 //----------------------------------------------------------------------------------------------------------------------------
+resamplerQuality AudioFile::quality = resampler_medium_;
+int AudioFile::resamplerThreads = -1;
+
 
 AudioFile::AudioFile() : Waveform() {
 	samplerate = -1;
@@ -220,6 +444,148 @@ AudioFile::AudioFile(advanceType adv) : Waveform(adv){
 }
 
 int AudioFile::init(std::string filename, int rate, unsigned int periodSize, double level, int chnIndex, unsigned short outChannels, unsigned short outChnOffset){
+	detachAsyncLoad(); // a previous initAsync() must not override this
+
+	SamplePtr data;
+	int retval = loadSamples(filename, rate, chnIndex, data);
+	if(retval != 0)
+		return retval;
+
+	sfinfo.samplerate = data->fileRate;
+	sfinfo.channels = data->fileChannels;
+	samplerate = rate;
+
+	init(data, periodSize, level, outChannels, outChnOffset); // now we can use the file as waveform
+
+	return 0;
+}
+
+int AudioFile::initAsync(std::string filename, int rate, unsigned int periodSize, double level, int chnIndex, unsigned short outChannels, unsigned short outChnOffset) {
+	detachAsyncLoad();
+
+	// already there, nothing to wait for
+	SamplePtr data = SampleCache::find(filename, chnIndex, rate);
+	if(data != NULL) {
+		sfinfo.samplerate = data->fileRate;
+		sfinfo.channels = data->fileChannels;
+		samplerate = rate;
+		init(data, periodSize, level, outChannels, outChnOffset);
+		return 0;
+	}
+
+	// placeholder, silent with no samples
+	AudioModuleOut::init(periodSize, outChannels, outChnOffset);
+	setLevel(level);
+	if(waveFormBuffer!=NULL && sharedData==NULL)
+		delete[] waveFormBuffer;
+	waveFormBuffer = NULL;
+	sharedData.reset();
+	frameNum = 0;
+	isPlaying = false;
+	setAdvanceSampleMethod();
+	samplerate = rate;
+
+	asyncTarget = std::make_shared<AsyncLoadTarget>();
+	asyncTarget->file = this;
+	std::shared_ptr<AsyncLoadTarget> target = asyncTarget;
+	SampleLoader::load(filename, rate, chnIndex, [target](SamplePtr data) {
+		std::lock_guard<std::mutex> lock(target->mtx);
+		if(target->file == NULL || data == NULL)
+			return; // gone, or load failed [already printed]
+		target->file->sfinfo.samplerate = data->fileRate;
+		target->file->sfinfo.channels = data->fileChannels;
+		target->file->swapData(data);
+	});
+
+	return 0;
+}
+
+AudioFile::~AudioFile() {
+	detachAsyncLoad();
+}
+
+
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// all channels of the file, each one shared through the cache like a single channel loaded by loadSamples()
+int AudioFile::loadChannels(std::string filename, int rate, std::vector<SamplePtr> &channels) {
+	channels.clear();
+
+	// first channel tells how many there are, then all of them must be there
+	SamplePtr first = SampleCache::find(filename, 0, rate);
+	if(first == NULL)
+		first = SampleCache::findOnDisk(filename, 0, rate, quality);
+	if(first != NULL) {
+		channels.push_back(SampleCache::insert(filename, 0, rate, first));
+		for(int c=1; c<first->fileChannels; c++) {
+			SamplePtr data = SampleCache::find(filename, c, rate);
+			if(data == NULL)
+				data = SampleCache::findOnDisk(filename, c, rate, quality);
+			if(data == NULL)
+				break;
+			channels.push_back(SampleCache::insert(filename, c, rate, data));
+		}
+		if((int)channels.size() == first->fileChannels)
+			return 0;
+		channels.clear();
+	}
+
+	AudioFile decoder;
+	int retval = decoder.decodeChannels(filename, rate, channels);
+	if(retval != 0) {
+		channels.clear();
+		return retval;
+	}
+
+	for(size_t c=0; c<channels.size(); c++) {
+		SampleCache::storeOnDisk(filename, c, rate, quality, channels[c]);
+		channels[c] = SampleCache::insert(filename, c, rate, channels[c]);
+	}
+	return 0;
+}
+
+void AudioFile::detachAsyncLoad() {
+	if(asyncTarget != NULL) {
+		std::shared_ptr<AsyncLoadTarget> target = asyncTarget;
+		asyncTarget.reset();
+
+		std::lock_guard<std::mutex> lock(target->mtx);
+		target->file = NULL; // loader will find nobody
+	}
+
+	// a swap the loader already posted would replace whatever comes next [audio is not running here, as init requires]
+	pendingData.reset();
+	swapPending.store(false, std::memory_order_release);
+}
+
+// same file, channel and rate are decoded only once and then shared [and also saved, if disk cache is on]
+int AudioFile::loadSamples(std::string filename, int rate, int chnIndex, SamplePtr &data) {
+	data = SampleCache::find(filename, chnIndex, rate);
+	if(data != NULL)
+		return 0;
+
+	// processed in a previous run
+	data = SampleCache::findOnDisk(filename, chnIndex, rate, quality);
+	if(data != NULL) {
+		data = SampleCache::insert(filename, chnIndex, rate, data);
+		return 0;
+	}
+
+	AudioFile decoder; // own sndfile and sfinfo, so that many can decode at once
+	decoder.samplerate = rate;
+	int retval = decoder.decode(filename, rate, chnIndex, data);
+	if(retval != 0)
+		return retval;
+
+	SampleCache::storeOnDisk(filename, chnIndex, rate, quality, data);
+	data = SampleCache::insert(filename, chnIndex, rate, data);
+	return 0;
+}
+
+// whole file, all channels interleaved
+int AudioFile::readFile(std::string filename, int chnIndex, double *&frameBuff, int &numOfFrames) {
 	if( !(sndfile = sf_open((const char*)(filename.c_str()), SFM_READ, &sfinfo)) ) {
 		sf_perror(sndfile);
 		printf("Audiofile %s can't be loaded.../:\n", filename.c_str());
@@ -228,19 +594,20 @@ int AudioFile::init(std::string filename, int rate, unsigned int periodSize, dou
 
 	if(sfinfo.channels !=1 && chnIndex>=sfinfo.channels) {
 		printf("Audiofile %s error! The requested channel (%d) cannot be extracted, since file only has %d channels\n", filename.c_str(), chnIndex, sfinfo.channels);
+		sf_close(sndfile);
 		return 1;
 	}
 
-	int numOfSamples = sfinfo.frames/sfinfo.channels;
-
-	double *frameBuff = new double[sfinfo.frames]; // this contains all channels, interleaved [hopefully]
-	double *fileBuff = new double[numOfSamples]; // this will contain either one channel or the average of all channels
+	numOfFrames = sfinfo.frames;
+	long numOfSamples = sfinfo.frames*sfinfo.channels;
+	frameBuff = new double[numOfSamples]; // this contains all channels, interleaved [hopefully]
 
 	int subformat = sfinfo.format & SF_FORMAT_SUBMASK;
-	int readcount = sf_read_double(sndfile, frameBuff, sfinfo.frames);
+	int readcount = sf_readf_double(sndfile, frameBuff, sfinfo.frames);
+	if(readcount < 0)
+		readcount = 0;
 
-	memset(frameBuff+readcount, 0, sfinfo.frames-readcount); // pad with zeros in case we couldn't read whole file
-	memset(fileBuff, 0, numOfSamples); // silence file buffer
+	memset(frameBuff+readcount*sfinfo.channels, 0, (numOfSamples-readcount*sfinfo.channels)*sizeof(double)); // pad with zeros in case we couldn't read whole file
 
 
 	if (subformat == SF_FORMAT_FLOAT || subformat == SF_FORMAT_DOUBLE) {
@@ -253,11 +620,24 @@ int AudioFile::init(std::string filename, int rate, unsigned int periodSize, dou
 			scale = 32700.0 / scale ;
 		printf("Scale = %f\n", scale);
 
-		for (int f = 0; f < sfinfo.frames; f++)
+		for (long f = 0; f < numOfSamples; f++)
 			frameBuff[f] *= scale;
 	}
 	sf_close(sndfile);
 
+	return 0;
+}
+
+int AudioFile::decode(std::string filename, int rate, int chnIndex, SamplePtr &data) {
+	double *frameBuff = NULL;
+	int numOfSamples = 0;
+	int retval = readFile(filename, chnIndex, frameBuff, numOfSamples);
+	if(retval != 0)
+		return retval;
+
+	double *fileBuff = new double[numOfSamples+1]; // this will contain either one channel or the average of all channels, +1 for silent frame
+	fileBuff[numOfSamples] = 0; // silent frame
+
 	// if we are dealing with multi-channel files
 	if(sfinfo.channels!=1) {
 		// average of all channels
@@ -277,157 +657,75 @@ int AudioFile::init(std::string filename, int rate, unsigned int periodSize, dou
 
 	}
 	else // actually this extra case would be covered already in the code just above, but this way is faster
-		memcpy(fileBuff, frameBuff, sfinfo.frames*sizeof(double));
+		memcpy(fileBuff, frameBuff, numOfSamples*sizeof(double));
+
+	delete[] frameBuff;
 
+	return convert(fileBuff, numOfSamples, filename, rate, data);
+}
+
+// one pass on the file for all channels, each one is then converted on its own
+int AudioFile::decodeChannels(std::string filename, int rate, std::vector<SamplePtr> &channels) {
+	double *frameBuff = NULL;
+	int numOfSamples = 0;
+	int retval = readFile(filename, -1, frameBuff, numOfSamples);
+	if(retval != 0)
+		return retval;
+
+	int chns = sfinfo.channels;
+	channels.assign(chns, SamplePtr());
+	for(int c=0; c<chns; c++) {
+		double *fileBuff = new double[numOfSamples+1]; // +1 for silent frame
+		for(int i=0; i<numOfSamples; i++)
+			fileBuff[i] = frameBuff[i*chns + c];
+		fileBuff[numOfSamples] = 0;
+
+		retval = convert(fileBuff, numOfSamples, filename, rate, channels[c]);
+		if(retval != 0)
+			break;
+	}
+
+	delete[] frameBuff;
+	return retval;
+}
+
+// resamples if needed, then wraps buffer, which is taken over
+int AudioFile::convert(double *fileBuff, int numOfSamples, std::string filename, int rate, SamplePtr &data) {
 	samplerate = rate;
 	if(samplerate == sfinfo.samplerate)
-		init(fileBuff, numOfSamples, periodSize, level, outChannels, outChnOffset); // simply use file as waveform
+		data = std::make_shared<SampleData>(fileBuff, numOfSamples, rate, sfinfo.samplerate, sfinfo.channels); // simply use file as waveform, data owns buffer now
 	else {
 		double *interpBuff = NULL;
 		int newSampleNum = resample(fileBuff, numOfSamples, filename, interpBuff); // interpolated file buffer allocated and filled inside of here
+		delete[] fileBuff;
 		// if something went wrong with resampling
 		if(newSampleNum <= 0) {
-			if(interpBuff==NULL)
+			if(interpBuff!=NULL)
 				delete[] interpBuff;
-			return newSampleNum;
+			return -1;
 		}
-
-		init(interpBuff, newSampleNum, periodSize, level, outChannels, outChnOffset); // now we can use the file as waveform
-		delete[] interpBuff; // clear
+		data = std::make_shared<SampleData>(interpBuff, newSampleNum, rate, sfinfo.samplerate, sfinfo.channels);
 	}
 
-	delete[] fileBuff;
-	delete[] frameBuff;
-
 	return 0;
 }
 
-
-//----------------------------------------------------------------------------------------------------------------------------
-// protected methods
-//----------------------------------------------------------------------------------------------------------------------------
-
 int AudioFile::resample(double fileBuff[], int numOfSamples, std::string filename, double *& interpBuff) {
-	int newSampleNum = 0;
-
-	if(samplerate > sfinfo.samplerate) {
-		if(samplerate % sfinfo.samplerate==0) {
-			int mult = samplerate/sfinfo.samplerate;
-			newSampleNum = upsample(fileBuff, numOfSamples, mult, interpBuff);
-		} else
-			newSampleNum = -1;
-	}
-	else if(samplerate < sfinfo.samplerate) {
-		if(sfinfo.samplerate % samplerate==0) {
-			int fact = sfinfo.samplerate/samplerate;
-			newSampleNum = decimate(fileBuff, numOfSamples, fact, interpBuff);
-		} else
-			newSampleNum = -2;
-	}
-	else {
-		//TODO: more resampling of file:
-		// direct downsample
-		// up/downsample when file not direct integer multiple or submultiple
-
-		newSampleNum = 0;
-	}
-
-
-	if(newSampleNum <= 0)
+	Resampler resampler;
+	if(resampler.init(sfinfo.samplerate, samplerate, quality) != 0) {
 		printf("Audiofile %s's sample rate %d can't be converted to audio rate %d\n", filename.c_str(), sfinfo.samplerate, samplerate);
-
-	return newSampleNum;
-}
-
-int AudioFile::upsample(double fileBuff[], int numOfSamples, int mul, double *& interpBuff) {
-	int newSampleNum = numOfSamples*mul;
-
-	interpBuff = new double[newSampleNum+1]; // +1 for silent frame and frameNum has been properly sized in resample()
-	memset(interpBuff, 0, sizeof(double)*(newSampleNum+1)); // all zero, including last silent frame
-
-	// copy file samples, properly spaced...basically we do a zero padding
-	for(int i=0; i<numOfSamples; i++)
-		interpBuff[i*mul] = fileBuff[i];
-
-	// now we filter with low pass to prevent aliasing
-	double a[3] = {1, 0, 0};
-	double b[3] = {0, 0, 0};
-	double normCutFreq = 0.5; // frequency = half of file sample rate [samples can't contain freqs higher than that]
-	computeLowPass(normCutFreq, a, b);
-
-	// prepare previous i/o
-	double x0 = 0;
-	double x1 = 0;
-	double x2 = 0;
-	double y1 = 0;
-	double y2 = 0;
-
-	// filter
-	for(int i=0; i<newSampleNum; i++) {
-		x0 = interpBuff[i];
-		interpBuff[i] = b[0]*x0 + b[1]*x1 + b[2]*x2 - a[1]*y1 - a[2]*y2;
-
-		// prepare previous i/o
-		x2 = x1;
-		x1 = x0;
-		y2 = y1;
-		y1 = interpBuff[i];
+		return -1;
 	}
 
-	return newSampleNum;
-}
-
-int AudioFile::decimate(double fileBuff[], int numOfSamples, int fact, double *& interpBuff) {
-	int newSampleNum = 1 + numOfSamples/fact;
+	int newSampleNum = resampler.getOutputLength(numOfSamples);
 
-	interpBuff = new double[newSampleNum+1]; // +1 for silent frame and frameNum has been properly sized in resample()
+	interpBuff = new double[newSampleNum+1]; // +1 for silent frame
 	memset(interpBuff, 0, sizeof(double)*(newSampleNum+1)); // all zero, including last silent frame
 
-	// we filter original file with low pass to prevent aliasing
-	double a[3] = {1, 0, 0};
-	double b[3] = {0, 0, 0};
-	double cutFreq = 0.5; // frequency = half of the sample rate [samples can't contain freqs higher than that]
-	computeLowPass(cutFreq, a, b);
-
-	// prepare previous i/o
-	double x0 = 0;
-	double x1 = 0;
-	double x2 = 0;
-	double y1 = 0;
-	double y2 = 0;
-
-	// filter
-	for(long int i=0; i<sfinfo.frames; i++) {
-		x0 = fileBuff[i];
-		fileBuff[i] = b[0]*x0 + b[1]*x1 + b[2]*x2 - a[1]*y1 - a[2]*y2;
-
-		// prepare previous i/o
-		x2 = x1;
-		x1 = x0;
-		y2 = y1;
-		y1 = fileBuff[i];
-	}
-
-	// then we downsample
-	// copying file samples, properly spaced
-	for(int i=0; i<newSampleNum; i++)
-		interpBuff[i] = fileBuff[i*fact];
+	int threads = SampleLoader::isLoaderThread() ? 1 : resamplerThreads; // loader already keeps all cores busy, threads on top of its threads only oversubscribe
+	resampler.process(fileBuff, numOfSamples, interpBuff, threads);
 
 	return newSampleNum;
-
-	//TODO test this! done definitely on a rush...need a card that does 22050 or a file that is 88200 Hz
-}
-
-void AudioFile::computeLowPass(double normCutFreq, double *a, double *b) {
-	// second order low pass butterworth filter
-	// taken from Bela IIR filter example
-	double normCutOmega = 2*M_PI*normCutFreq; // normalized cut angular velocity
-	double denom = 4+2*sqrt(2.0)*normCutOmega+normCutOmega*normCutOmega;
-	b[0] = normCutOmega*normCutOmega/denom;
-	b[1] = 2*b[0];
-	b[2] = b[0];
-	a[1] = (2*normCutOmega*normCutOmega-8)/denom;
-	a[2] = (normCutOmega*normCutOmega+4-2*sqrt(2)*normCutOmega)/denom;
 }
 //----------------------------------------------------------------------------------------------------------------------------
 //----------------------------------------------------------------------------------------------------------------------------
@@ -441,18 +739,26 @@ void AudioFile::computeLowPass(double normCutFreq, double *a, double *b) {
 //----------------------------------------------------------------------------------------------------------------------------
 Wavetable::Wavetable() : AudioFile(adv_loop_) {
 	interpolation = interp_no_;
-	currentPos = -1;
+	phase = 0;
+	phaseInc = 0;
+	phaseLen = 0;
+	phaseMask = -1;
 	step = 0;
+	frequency = 440;
 	waveFrameNum = 0;
-	computeSample = NULL;
+	tableOffset = 0;
 }
 
 Wavetable::Wavetable(interpType interp) : AudioFile(adv_loop_) {
 	interpolation = interp;
-	currentPos = -1;
+	phase = 0;
+	phaseInc = 0;
+	phaseLen = 0;
+	phaseMask = -1;
 	step = 0;
+	frequency = 440;
 	waveFrameNum = 0;
-	computeSample = NULL;
+	tableOffset = 0;
 }
 
 void Wavetable::init(double *samples, int len, unsigned int rate, unsigned int periodSize, double level, unsigned short outChannels, unsigned short outChnOffset) {
@@ -470,11 +776,34 @@ double *Wavetable::getBuffer(int numOfSamples) {
 }
 */
 
+// copies samples into a table with guard frames, the audio thread only swaps pointers and resets phase
+int Wavetable::swapData(SamplePtr data) {
+	if(data==NULL || data->frames<=0) {
+		printf("Wavetable error! Can't swap in empty samples\n");
+		return -1;
+	}
+
+	int len = data->frames;
+	int guardedLen = len+getGuardFramesNum();
+	double *table = new double[guardedLen+1]; // +1 for silent frame, like any shared samples
+	fillGuardedTable(data->samples, len, table);
+	table[guardedLen] = 0;
+
+	SamplePtr guarded = std::make_shared<SampleData>(table, guardedLen, data->rate, data->fileRate, data->fileChannels);
+	return Waveform::swapData(guarded);
+}
+
 double **Wavetable::getFrameBuffer(int numOfSamples) {
-	for(int i=0; i<numOfSamples; i++)
-		framebuffer[out_chn_offset][i] = getSample(); // methods referred to by getSample() are all inline
+	if(swapPending.load(std::memory_order_acquire))
+		adoptPendingData();
 
-	memset(framebuffer[out_chn_offset]+numOfSamples, 0, (period_size-numOfSamples)*sizeof(double)); // reset part of buffer that has been potentially left untouched
+	if(waveFormBuffer==NULL) // placeholders have no table
+		memset(framebuffer[out_chn_offset], 0, period_size*sizeof(double));
+	else {
+		render(waveFormBuffer+tableOffset, NULL, 0, framebuffer[out_chn_offset], numOfSamples); // interpolation is chosen once per block
+
+		memset(framebuffer[out_chn_offset]+numOfSamples, 0, (period_size-numOfSamples)*sizeof(double)); // reset part of buffer that has been potentially left untouched
+	}
 
 	MultichannelOutUtils::cloneFrameChannels(numOfSamples);
 
@@ -485,39 +814,59 @@ double **Wavetable::getFrameBuffer(int numOfSamples) {
 // protected methods
 //----------------------------------------------------------------------------------------------------------------------------
 
+void Wavetable::init(SamplePtr data, unsigned int periodSize, double level, unsigned short outChannels, unsigned short outChnOffset) {
+	init(data->samples, data->frames, periodSize, level, outChannels, outChnOffset);
+}
+
 void Wavetable::init(double *samples, int len, unsigned int periodSize, double level, unsigned short outChannels, unsigned short outChnOffset) {
 	waveFrameNum = len;
 
-	double *buff;
-	if(interpolation == interp_lin_) {
-		buff = new double[len+1]; // need to add 1 guard frames at the beginning
-		memcpy(buff, samples, len*sizeof(double)); // copy with offset of one element, for guard frame
-		len = len+1; // new len! -> this will become frameNum
-		buff[len-1] = samples[0]; // guard frame is just a copy of the first original samples
-
-		AudioFile::init(buff, len, periodSize, level, outChannels, outChnOffset);
-		delete buff;
-	}
-	if(interpolation == interp_cubic_) {
-		buff = new double[len+3]; // need to add 3 guard frames, one at the beginning, the other two at the end
-		memcpy(&buff[1], samples, len*sizeof(double)); // copy with offset of one element, for first guard frame
-		len = len+3; // new len! -> this will become frameNum
-		buff[0] = samples[len-1]; // first guard frame: last of the original samples
-		buff[len-2] = samples[0]; // second guard frame: first of the original samples
-		buff[len-1] = samples[1]; // third guard frame: second of the original samples
+	if(getGuardFramesNum() > 0) {
+		int guardedLen = len+getGuardFramesNum(); // new len! -> this will become frameNum
+		double *buff = new double[guardedLen];
+		fillGuardedTable(samples, len, buff);
 
-		AudioFile::init(buff, len, periodSize, level, outChannels, outChnOffset);
-		delete buff;
+		AudioFile::init(buff, guardedLen, periodSize, level, outChannels, outChnOffset);
+		delete[] buff;
 	}
 	else
-		AudioFile::init(samples, len, periodSize, level, outChannels, outChnOffset);
-		//buff = samples; // no interpolation case -> nothing to change on samples passed
+		AudioFile::init(samples, len, periodSize, level, outChannels, outChnOffset); // no interpolation case -> nothing to change on samples passed
+
+	setTableLength(len);
+
+	setFrequency(440); // default 440 Hz -> sets the step
+}
 
+// audio thread side of swapData(), table already has guard frames
+void Wavetable::adoptPendingData() {
+	AudioFile::adoptPendingData();
+	waveFrameNum = frameNum-getGuardFramesNum();
+	setTableLength(waveFrameNum);
+	setFrequency(frequency); // step depends on length
+}
 
+void Wavetable::setTableLength(int len) {
+	tableOffset = getGuardFramesBefore();
 
-	currentPos = 0;
+	phase = 0;
+	phaseLen = (int64_t)len << WAVETABLE_FRAC_BITS;
+	phaseMask = ((len & (len-1)) == 0) ? phaseLen-1 : -1; // power of 2 lengths wrap with a mask
+}
 
-	setFrequency(440); // default 440 Hz -> sets the step
+// table must have room for len+getGuardFramesNum() frames
+void Wavetable::fillGuardedTable(double *samples, int len, double *table) {
+	if(interpolation == interp_lin_) {
+		memcpy(table, samples, len*sizeof(double));
+		table[len] = samples[0]; // guard frame at the end is just a copy of the first original sample
+	}
+	else if(interpolation == interp_cubic_ || interpolation == interp_hermite_) {
+		memcpy(&table[1], samples, len*sizeof(double)); // copy with offset of one element, for first guard frame
+		table[0] = samples[len-1]; // first guard frame: last of the original samples
+		table[len+1] = samples[0]; // second guard frame: first of the original samples
+		table[len+2] = samples[1%len]; // third guard frame: second of the original samples
+	}
+	else
+		memcpy(table, samples, len*sizeof(double));
 }
 
 void Wavetable::setAdvanceSampleMethod() {
@@ -527,20 +876,7 @@ void Wavetable::setAdvanceSampleMethod() {
 	// alternatively, instead of calling Waveform::setAdvanceSampleMethod() we could have done this:
 	//advanceSample = reinterpret_cast<void(Waveform::*)()>(&Wavetable::advanceSampleOneShot);
 
-	switch(interpolation) {
-		case interp_no_:
-			computeSample = &Wavetable::computeSampleInterpNone;
-			break;
-		case interp_lin_:
-			computeSample = &Wavetable::computeSampleInterpLin;
-			break;
-		case interp_cubic_:
-			computeSample = &Wavetable::computeSampleInterpCubic;
-			break;
-		default:
-			computeSample = &Wavetable::computeSampleInterpNone;
-			break;
-	}
+	// interpolation is not picked here anymore, but once per block in render()
 }
 
 
@@ -548,64 +884,194 @@ void Wavetable::setAdvanceSampleMethod() {
 //----------------------------------------------------------------------------------------------------------------------------
 // WavetableOsc
 //----------------------------------------------------------------------------------------------------------------------------
-WavetableOsc::WavetableOsc() : Wavetable() {
 
+// band-limited tables are expensive to compute, so they are computed once and shared by all the oscillators with same type, length and interpolation
+// they live as long as the application
+typedef std::tuple<int, unsigned int, int> mipTablesKey; // type, length, interpolation
+struct mipTablesEntry {
+	double **tables;
+	int num;
+};
+static std::map<mipTablesKey, mipTablesEntry> mipTablesCache;
+static std::mutex mipTablesCacheMutex;
+
+
+WavetableOsc::WavetableOsc() : Wavetable() {
+	mipTables = NULL;
+	mipNum = 0;
+	mipLow = 0;
+	mipHigh = 0;
+	mipFrac = 0;
+	ownMipTables = false;
 }
 
 WavetableOsc::WavetableOsc(interpType interp) : Wavetable(interp) {
+	mipTables = NULL;
+	mipNum = 0;
+	mipLow = 0;
+	mipHigh = 0;
+	mipFrac = 0;
+	ownMipTables = false;
+}
 
+WavetableOsc::~WavetableOsc() {
+	deleteMipTables();
 }
 
 void WavetableOsc::init(oscillator_type type, unsigned int rate, unsigned int periodSize, double level,
 						unsigned int numOfSamples, unsigned short outChannels, unsigned short outChnOffset) {
-	double *buff = new double[numOfSamples];
+	deleteMipTables(); // in case of re-init
 
-	switch(type) {
-			case osc_sin_:
-				for(unsigned int i=0; i<numOfSamples; i++)
-					buff[i] =sin(2*M_PI * i/double(numOfSamples-1));
-				break;
-			case osc_square_:
-				for(unsigned int i=0; i<numOfSamples/2; i++)
-					buff[i] = 1;
-				for(unsigned int i=numOfSamples/2; i<numOfSamples; i++)
-					buff[i] = 0;
-				break;
-			case osc_tri_:
-				for(unsigned int i=0; i<numOfSamples/2; i++)
-					buff[i] = i/double(numOfSamples/2);
-				for(unsigned int i=numOfSamples/2; i<numOfSamples; i++)
-					buff[i] = (numOfSamples-1-i)/double(numOfSamples/2);
-				break;
-			case osc_saw_:
-				for(unsigned int i=0; i<numOfSamples; i++)
-					buff[i] = i/double(numOfSamples-1);
-				break;
-			case osc_whiteNoise_:
-				for(unsigned int i=0; i<numOfSamples; i++)
-					buff[i] = 2*( (double) rand()/ ((double)RAND_MAX) ) - 1;
-				break;
-			case osc_impTrain_:
-				memset(buff, 0, numOfSamples*sizeof(double));
-				buff[0] = 1;
-				break;
-			case osc_const_:
-				for(unsigned int i=0; i<numOfSamples; i++)
-					buff[i] = 1;
-				break;
-			/*case osc_w_:
-				getSampleMethod = &Oscillator::getWSample;
-				break;*/
-			default:
-				for(unsigned int i=0; i<numOfSamples; i++)
-					buff[i] =sin(2*M_PI * i/double(numOfSamples-1));
-				printf("WaveteableOsc type %d not recognized! Falling back toi sin\n", type);
-				break;
+	mipTablesKey key(type, numOfSamples, interpolation);
+
+	// check if somebody already did the hard work
+	if(type != osc_whiteNoise_) {
+		std::lock_guard<std::mutex> lock(mipTablesCacheMutex);
+		auto entry = mipTablesCache.find(key);
+		if(entry != mipTablesCache.end()) {
+			mipTables = entry->second.tables;
+			mipNum = entry->second.num;
+		}
 	}
 
-	Wavetable::init(buff, numOfSamples, rate, periodSize, level, outChannels, outChnOffset);
+	if(mipTables == NULL) {
+		double *buff = new double[numOfSamples];
+
+		switch(type) {
+				case osc_sin_:
+					for(unsigned int i=0; i<numOfSamples; i++)
+						buff[i] =sin(2*M_PI * i/double(numOfSamples)); // exactly one period, otherwise band-limiting would add harmonics
+					break;
+				case osc_square_:
+					for(unsigned int i=0; i<numOfSamples/2; i++)
+						buff[i] = 1;
+					for(unsigned int i=numOfSamples/2; i<numOfSamples; i++)
+						buff[i] = 0;
+					break;
+				case osc_tri_:
+					for(unsigned int i=0; i<numOfSamples/2; i++)
+						buff[i] = i/double(numOfSamples/2);
+					for(unsigned int i=numOfSamples/2; i<numOfSamples; i++)
+						buff[i] = (numOfSamples-1-i)/double(numOfSamples/2);
+					break;
+				case osc_saw_:
+					for(unsigned int i=0; i<numOfSamples; i++)
+						buff[i] = i/double(numOfSamples-1);
+					break;
+				case osc_whiteNoise_: {
+					Random random;
+					random.fillUniform(buff, numOfSamples);
+					break;
+				}
+				case osc_impTrain_:
+					memset(buff, 0, numOfSamples*sizeof(double));
+					buff[0] = 1;
+					break;
+				case osc_const_:
+					for(unsigned int i=0; i<numOfSamples; i++)
+						buff[i] = 1;
+					break;
+				/*case osc_w_:
+					getSampleMethod = &Oscillator::getWSample;
+					break;*/
+				default:
+					for(unsigned int i=0; i<numOfSamples; i++)
+						buff[i] =sin(2*M_PI * i/double(numOfSamples));
+					printf("WaveteableOsc type %d not recognized! Falling back toi sin\n", type);
+					break;
+		}
+
+		computeMipTables(buff, numOfSamples);
+		ownMipTables = true; // each noise osc keeps its own tables
+		delete[] buff;
+
+		if(type != osc_whiteNoise_) {
+			std::lock_guard<std::mutex> lock(mipTablesCacheMutex);
+			auto entry = mipTablesCache.find(key);
+			// somebody else may have computed the same tables in the meantime, in that case we use those and drop ours
+			if(entry != mipTablesCache.end()) {
+				deleteMipTables();
+				mipTables = entry->second.tables;
+				mipNum = entry->second.num;
+			}
+			else {
+				mipTablesCache[key] = {mipTables, mipNum};
+				ownMipTables = false; // cache owns them now
+			}
+		}
+	}
+
+	// full band table becomes the waveform, all other tables are read directly from mipTables
+	Wavetable::init(mipTables[0]+getGuardFramesBefore(), numOfSamples, rate, periodSize, level, outChannels, outChnOffset);
+}
 
-	delete buff;
+int WavetableOsc::swapData(SamplePtr data) {
+	(void)data;
+	printf("WavetableOsc error! Tables are computed at init, samples can't be swapped in\n");
+	return -1;
+}
+
+double **WavetableOsc::getFrameBuffer(int numOfSamples) {
+	double *tableLow  = mipTables[mipLow]+tableOffset;
+	double *tableHigh = (mipFrac > 0) ? mipTables[mipHigh]+tableOffset : NULL; // no crossfade, no second read
+	render(tableLow, tableHigh, mipFrac, framebuffer[out_chn_offset], numOfSamples);
+
+	memset(framebuffer[out_chn_offset]+numOfSamples, 0, (period_size-numOfSamples)*sizeof(double)); // reset part of buffer that has been potentially left untouched
+
+	MultichannelOutUtils::cloneFrameChannels(numOfSamples);
+
+	return framebuffer;
 }
 
+//----------------------------------------------------------------------------------------------------------------------------
+// protected methods
+//----------------------------------------------------------------------------------------------------------------------------
+
+// one table per octave, each with half the harmonics of the previous one, down to a single sinusoid
+void WavetableOsc::computeMipTables(double *samples, int len) {
+	int numOfBins = len/2 + 1;
+	double (*spectrum)[2] = new double[numOfBins][2];
+	double (*bandLimited)[2] = new double[numOfBins][2];
+	double *buff = new double[len];
+
+	calculateFFT(samples, len, spectrum);
+
+	mipNum = 0;
+	for(int harmonics=len/2; harmonics>=1; harmonics/=2)
+		mipNum++;
+	if(mipNum == 0)
+		mipNum = 1; // degenerate tables, we keep at least the original one
+
+	mipTables = new double *[mipNum];
+
+	int harmonics = len/2;
+	for(int i=0; i<mipNum; i++) {
+		memcpy(bandLimited, spectrum, numOfBins*2*sizeof(double));
+		for(int k=harmonics+1; k<numOfBins; k++)
+			bandLimited[k][0] = bandLimited[k][1] = 0; // remove all harmonics that would fold back when playing above this table's octave
 
+		calculateIFFT(bandLimited, len, buff);
+
+		mipTables[i] = new double[len+getGuardFramesNum()];
+		fillGuardedTable(buff, len, mipTables[i]);
+
+		harmonics /= 2;
+	}
+
+	delete[] spectrum;
+	delete[] bandLimited;
+	delete[] buff;
+}
+
+void WavetableOsc::deleteMipTables() {
+	if(mipTables!=NULL && ownMipTables) {
+		for(int i=0; i<mipNum; i++)
+			delete[] mipTables[i];
+		delete[] mipTables;
+	}
+	mipTables = NULL;
+	mipNum = 0;
+	mipLow = mipHigh = 0;
+	mipFrac = 0;
+	ownMipTables = false;
+}
@@ -2,17 +2,14 @@
 
 //#define BOUNCE // Uncomment to save audio of each run
 #ifdef BOUNCE
-#include <sndfile.h>
+#include "DiskRecorder.h"
 #include <string>
 #include <dirent.h>  // To handle files in dirs
 #include <fstream>   // Read/write to file ifstream/ofstream
 #include <sstream>   // ostringstream
 using namespace std;
 
-float *outBuffer;
-
-SF_INFO sfinfo;
-SNDFILE *outfile;
+DiskRecorder recorder;
 string outfiledir = ".";
 string outfilename = "bounce_";
 
@@ -47,21 +44,14 @@ bool setup(EngineContext *context, void *userData) {
     (void)userData;
 
 #ifdef BOUNCE
-    // Allocate buffer for interleaved multichannel audio
-    outBuffer = new float[context->numOfSamples * context->numOutChannels];
-
     // Change output file name according to the number of WAV files in the dir
     int fileNum = getNumOfWavFiles(outfiledir);
     ostringstream convert;
     convert << fileNum;
     outfilename += convert.str() + ".wav";
 
-    // Save audio
-    sfinfo.channels = context->numOutChannels;
-    sfinfo.samplerate = context->sampleRate;
-    sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
-    outfile = sf_open(outfilename.c_str(), SFM_WRITE, &sfinfo);
-    if (!outfile) {
+    // Save audio, file is written by recorder's own thread
+    if (recorder.init(outfilename, context->sampleRate, context->numOutChannels, context->numOfSamples, rec_rf64_, SF_FORMAT_PCM_16) != 0) {
         printf("Failed to open output file: %s\n", outfilename.c_str());
         return false;
     }
@@ -84,20 +74,9 @@ void render(EngineContext *context, void *userData) {
     callReadAudioModulesBuffers(engine, context->numOfSamples);
 
 #ifdef BOUNCE
-    // Interleave multichannel audio into outBuffer
-    for (int sample = 0; sample < context->numOfSamples; ++sample) {
-        for (int channel = 0; channel < context->numOutChannels; ++channel) {
-            outBuffer[sample * context->numOutChannels + channel] = 
-                context->framebufferOut[channel][sample];
-        }
-    }
-
-    // Write interleaved buffer to file
-    sf_count_t count = sf_write_float(outfile, outBuffer, context->numOfSamples * context->numOutChannels);
-    if (count < context->numOfSamples * context->numOutChannels) {
-        printf("Failed to write all samples: wrote %ld of %ld\n",
-               count, context->numOfSamples * context->numOutChannels);
-    }
+    // Hand output to recorder, no disk access here
+    recorder.tap(context->framebufferOut, 0, context->numOutChannels, context->numOfSamples);
+    recorder.push(context->numOfSamples);
 #endif
 }
 
@@ -106,11 +85,9 @@ void cleanup(EngineContext *context, void *userData) {
     (void)userData;
 
 #ifdef BOUNCE
-    delete[] outBuffer;
     // Properly save audio and close file
-    if (outfile) {
-        sf_write_sync(outfile);
-        sf_close(outfile);
-    }
+    recorder.close();
+    if (recorder.getDroppedBlocks() > 0)
+        printf("Bounce is missing %u periods, disk could not keep up\n", recorder.getDroppedBlocks());
 #endif
 }
@@ -65,6 +65,8 @@ public:
 	void setPeriodSize(unsigned int period_size);
 	float process(void);
 	float *processBuffer(int numOfSamples);
+	void processBuffer(double *dest, int numOfSamples); // renders in place of dest, e.g., a module's frame buffer
+	void applyBuffer(double *inout, int numOfSamples); // multiplies inout by the envelope
     float getOutput(void);
     float *getOutputBuffer(void);
     int getState(void);
@@ -97,6 +99,10 @@ protected:
     float *buffer;
  
     float calcCoef(float rate, float targetRatio);
+
+    template<bool apply, typename T>
+    void renderSegments(T *dest, int numOfSamples);
+    int getSegmentLength(double base, double coef, double threshold);
 };
 
 inline float ADSR::process() {
@@ -79,6 +79,8 @@ public:
 	double getStartingFc();
 	double getStartingPeakGain();
 
+	void getCoefficients(double *coefs); // a0, a1, a2, b1, b2
+
 protected:
     void calcBiquad(void);
 
@@ -119,6 +121,15 @@ inline double Biquad::getStartingPeakGain()
 	return startPeakGain;
 }
 
+inline void Biquad::getCoefficients(double *coefs)
+{
+	coefs[0] = a0;
+	coefs[1] = a1;
+	coefs[2] = a2;
+	coefs[3] = b1;
+	coefs[4] = b2;
+}
+
 inline double Biquad::process(double in) {
     double out = in * a0 + z1;
     z1 = in * a1 + z2 - b1 * out;
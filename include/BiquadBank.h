@@ -0,0 +1,64 @@
+/*
+ * BiquadBank.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: same transposed direct form II sections as Biquad, laid out as structure of arrays
+ *                so that several sections run in parallel SIMD lanes [AVX, SSE2 or NEON, scalar fallback]
+ */
+
+#ifndef BIQUADBANK_H_
+#define BIQUADBANK_H_
+
+#include "Biquad.h"
+
+//----------------------------------------------------------------------------------
+// a grid of channels x sections biquads, e.g., a 4 band EQ on each of 16 outputs
+// process() runs all channels in parallel lanes, one section after the other
+// processCascade() runs all the sections of a single channel in parallel lanes, skewed by one sample each [wavefront],
+// which breaks the serial dependency between sections without adding any latency
+//----------------------------------------------------------------------------------
+class BiquadBank {
+public:
+	BiquadBank();
+	~BiquadBank();
+	int init(unsigned short channels, unsigned short sections, unsigned int maxNumOfSamples); // -1 if maxNumOfSamples is 0
+	void setBiquad(unsigned short channel, unsigned short section, int type, double Fc, double Q, double peakGainDB);
+	void setBiquad(unsigned short section, int type, double Fc, double Q, double peakGainDB); // same section on all channels
+	void reset();
+
+	void process(double **inout, int numOfSamples); // inout[i] is channel i, filtered in place
+	void processCascade(double *inout, int numOfSamples, unsigned short channel=0);
+
+	unsigned short getChannelsNum();
+	unsigned short getSectionsNum();
+
+protected:
+	unsigned short channels;
+	unsigned short sections;
+	unsigned int maxNumOfSamples;
+	int paddedChannels; // channels rounded up to SIMD width, extra lanes have null coefficients
+	int paddedSections; // same for sections, used in processCascade()
+
+	// coefficients and states, [section*paddedChannels + channel]
+	double *a0, *a1, *a2, *b1, *b2;
+	double *z1, *z2;
+
+	double *interleaved; // [sample*paddedChannels + channel], so that lanes are contiguous
+
+	// processCascade() work area, one channel's sections gathered in contiguous lanes
+	double *cascCoefs[5];
+	double *cascZ1, *cascZ2;
+	double *pipe; // pipe[s] is the input of section s, pipe[s+1] its output
+
+	void deallocate();
+};
+
+inline unsigned short BiquadBank::getChannelsNum() {
+	return channels;
+}
+
+inline unsigned short BiquadBank::getSectionsNum() {
+	return sections;
+}
+
+#endif /* BIQUADBANK_H_ */
@@ -0,0 +1,88 @@
+/*
+ * Convolver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: multichannel convolution module, for cabinet and room impulse responses
+ */
+
+#ifndef CONVOLVER_H_
+#define CONVOLVER_H_
+
+#include "AudioModules.h"
+#include "PartitionedConvolution.h"
+#include "NonUniformConvolution.h"
+
+#include <string>
+#include <pthread.h>
+#include <semaphore.h>
+
+class Convolver;
+
+struct ConvolverWorker {
+	Convolver *convolver;
+	unsigned short firstChn;
+	unsigned short lastChn; // excluded
+	pthread_t thread;
+	sem_t start;
+	sem_t done;
+};
+
+//----------------------------------------------------------------------------------
+// Convolves chns consecutive input channels with an impulse response, to as many consecutive output channels
+// partitions are as long as the period, so there is no added latency
+// channels can be split among worker threads, that run in parallel with the audio thread during each period and are joined before returning
+//----------------------------------------------------------------------------------
+class Convolver : public AudioModuleInOut {
+public:
+	Convolver();
+	~Convolver();
+	// if the file has as many channels as chns each channel gets its own response, otherwise all channels share the average of the file channels
+	// nonUniform moves all but the first partitions to background threads [see NonUniformConvolution], for very long responses
+	int init(std::string filename, int rate, unsigned int periodSize, unsigned short chns=1, unsigned short inChnOffset=0, unsigned short outChnOffset=0,
+			 unsigned short numOfThreads=0, bool normalize=true, bool nonUniform=false);
+	// same response for all channels
+	int init(double *ir, int irLen, unsigned int periodSize, unsigned short chns=1, unsigned short inChnOffset=0, unsigned short outChnOffset=0,
+			 unsigned short numOfThreads=0, bool normalize=true, bool nonUniform=false);
+	double **getFrameBuffer(int numOfSamples, double **input);
+	void retrigger(); // clears tails
+	unsigned int getMissedDeadlines(); // of non uniform tails, all channels
+
+	static void setWorkersPriority(int prio);
+
+protected:
+	unsigned short channels;
+	PartitionedConvolution *convolutions; // one per channel
+	NonUniformConvolution *nuConvolutions; // in place of the above, when non uniform
+
+	ConvolverWorker *workers;
+	unsigned short numOfWorkers;
+	bool stopWorkers;
+	static int prioWorkers;
+
+	// what workers need to know about current period
+	double **currentInput;
+	int currentNumOfSamples;
+
+	int initChannels(double **irs, int irLen, unsigned int periodSize, unsigned short chns, unsigned short inChnOffset, unsigned short outChnOffset,
+					 unsigned short numOfThreads, bool normalize, bool nonUniform);
+	void processChannels(unsigned short firstChn, unsigned short lastChn);
+	void startWorkers(unsigned short numOfThreads);
+	void stopAndDeleteWorkers();
+	void deallocate();
+	static void *workerLoop(void *arg);
+};
+
+inline unsigned int Convolver::getMissedDeadlines() {
+	unsigned int missed = 0;
+	if(nuConvolutions != NULL) {
+		for(int c=0; c<channels; c++)
+			missed += nuConvolutions[c].getMissedDeadlines();
+	}
+	return missed;
+}
+
+inline void Convolver::setWorkersPriority(int prio) {
+	prioWorkers = prio;
+}
+
+#endif /* CONVOLVER_H_ */
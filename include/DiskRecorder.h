@@ -0,0 +1,111 @@
+/*
+ * DiskRecorder.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: multitrack recorder, audio thread only copies blocks into a lock-free ring and a writer thread puts them on disk
+ */
+
+#ifndef DISKRECORDER_H_
+#define DISKRECORDER_H_
+
+#include "LockFree.h"
+
+#include <string>
+#include <atomic>
+#include <sndfile.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+enum recorderFormat {rec_wav_, rec_w64_, rec_caf_, rec_rf64_}; // wav files stop at 4 GB, the others do not [rf64 files that end up smaller are written as plain wav]
+
+#define RECORDER_DEFAULT_RING 2.0		  // seconds of audio the ring can hold while the disk is busy
+#define RECORDER_DEFAULT_PREALLOC 600.0	  // seconds of audio reserved on disk at init
+#define RECORDER_BATCH_FRAMES 16384		  // writer collects up to this many frames before each write
+
+// one period of all channels, planar
+struct RecorderBlock {
+	float *samples; // channel c starts at c*periodSize
+	int frames;
+};
+
+//----------------------------------------------------------------------------------
+// Records any set of buffers [engine outputs, inputs, single modules] as channels of one file
+// in render(), call tap() for each source and then push() once, they never block nor allocate
+// if the writer falls behind and the ring is full the block is dropped and counted, the audio thread does not wait for the disk
+// disk space is reserved in advance, so that the file system does not have to look for free blocks while recording
+//----------------------------------------------------------------------------------
+class DiskRecorder {
+public:
+	DiskRecorder();
+	~DiskRecorder();
+	int init(std::string filename, int rate, unsigned short channels, unsigned int periodSize, recorderFormat format=rec_rf64_, int subformat=SF_FORMAT_PCM_24,
+			 double ringSeconds=RECORDER_DEFAULT_RING, double preallocSeconds=RECORDER_DEFAULT_PREALLOC); // opens file and starts writer, not from audio thread
+	void close(); // writes whatever is left and closes file, not from audio thread
+
+	// audio thread
+	void tap(const double *buffer, unsigned short channel, int numOfSamples);
+	void tap(const double * const *buffers, unsigned short firstChannel, unsigned short numOfChannels, int numOfSamples);
+	void push(int numOfSamples); // hands current block to writer, channels not tapped are silent
+
+	unsigned int getDroppedBlocks();
+	long getWrittenFrames();
+
+	static void setWriterPriority(int prio);
+
+protected:
+	SNDFILE *sndfile;
+	std::string filename;
+	unsigned short channels;
+	unsigned int periodSize;
+
+	SpscRing<RecorderBlock> ring;
+	float *blockMemory;
+	RecorderBlock *current; // being tapped, NULL if ring was full
+	bool blockStarted;
+
+	float *batch; // interleaved, writer only
+	int batchFrames;
+	std::atomic<long> writtenFrames;
+	std::atomic<unsigned int> droppedBlocks;
+	std::atomic<bool> stopWriter;
+
+	pthread_t writerThread;
+	sem_t writerSem;
+	bool writerStarted;
+	static int prioWriter;
+
+	void startBlock();
+	void writeBlocks(bool flush);
+	void deallocate();
+	static void *writerLoop(void *arg);
+};
+
+inline void DiskRecorder::tap(const double *buffer, unsigned short channel, int numOfSamples) {
+	if(!blockStarted)
+		startBlock();
+	if(current == NULL || channel >= channels)
+		return;
+
+	float *dst = current->samples + channel*periodSize;
+	for(int n=0; n<numOfSamples; n++)
+		dst[n] = buffer[n];
+}
+
+inline void DiskRecorder::tap(const double * const *buffers, unsigned short firstChannel, unsigned short numOfChannels, int numOfSamples) {
+	for(int c=0; c<numOfChannels; c++)
+		tap(buffers[c], firstChannel+c, numOfSamples);
+}
+
+inline unsigned int DiskRecorder::getDroppedBlocks() {
+	return droppedBlocks.load();
+}
+
+inline long DiskRecorder::getWrittenFrames() {
+	return writtenFrames.load();
+}
+
+inline void DiskRecorder::setWriterPriority(int prio) {
+	prioWriter = prio;
+}
+
+#endif /* DISKRECORDER_H_ */
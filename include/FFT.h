@@ -33,9 +33,86 @@
 #ifndef FFT_H_
 #define FFT_H_
 
+#include <fftw3.h>
 
+#define FFT_WISDOM_FILE "fftw.wisdom"
+#define FFT_WISDOM_FILE_FLOAT "fftwf.wisdom"
+
+enum fft_planning {
+	fft_plan_estimate = 0,
+	fft_plan_measure,
+	fft_plan_patient
+};
+
+//----------------------------------------------------------------------------------
+// Reusable real FFT of fixed size, with aligned in-place buffer
+// init() looks for a plan of that size in a static cache and creates it if needed, so it must be called off the audio thread
+// forward() and inverse() do not allocate nor lock, so they are safe to call in render()
+// plans are kept for the whole life of the process, and shared among instances of same size
+//----------------------------------------------------------------------------------
+class FFT {
+public:
+	FFT();
+	~FFT();
+	int init(int size, fft_planning planning=fft_plan_measure);
+
+	void forward(); // real samples -> complex bins
+	void inverse(); // complex bins -> real samples, already normalized
+
+	double *getSamples();		 // size real samples, same memory as bins
+	fftw_complex *getBins();	 // size/2+1 complex bins
+	int getSize();
+	int getBinsNum();
+
+	// to avoid measuring plans at every startup
+	static int loadWisdom(const char *filename=FFT_WISDOM_FILE, const char *filenameFloat=FFT_WISDOM_FILE_FLOAT);
+	static int saveWisdom(const char *filename=FFT_WISDOM_FILE, const char *filenameFloat=FFT_WISDOM_FILE_FLOAT);
+
+protected:
+	int size;
+	fftw_complex *buffer; // in-place, real view needs 2*(size/2+1) doubles
+	fftw_plan forwardPlan;
+	fftw_plan inversePlan;
+	double norm;
+};
+
+inline double *FFT::getSamples() {
+	return (double *)buffer;
+}
+
+inline fftw_complex *FFT::getBins() {
+	return buffer;
+}
+
+inline int FFT::getSize() {
+	return size;
+}
+
+inline int FFT::getBinsNum() {
+	return size/2+1;
+}
+
+inline void FFT::forward() {
+	fftw_execute_dft_r2c(forwardPlan, (double *)buffer, buffer); // new array execute, thread safe
+}
+
+inline void FFT::inverse() {
+	fftw_execute_dft_c2r(inversePlan, buffer, (double *)buffer);
+
+	double *samples = (double *)buffer;
+	for(int i=0; i<size; i++)
+		samples[i] *= norm;
+}
+
+
+// one shot transforms, for analysis and table generation at init time
+// they use cached plans too, so no allocations after the first call with a given size [but they lock, do not use in render()]
 void calculateFFT(float samples[], int numOfFFTsamples, float outputSamples[][2]);
 void calculateFFT(double samples[], int numOfFFTsamples, double outputSamples[][2]);
 
+// inverse, takes numOfFFTsamples/2+1 complex bins and returns numOfFFTsamples real samples [already normalized]
+void calculateIFFT(float inputSamples[][2], int numOfFFTsamples, float outputSamples[]);
+void calculateIFFT(double inputSamples[][2], int numOfFFTsamples, double outputSamples[]);
+
 
 #endif /* FFT_H_ */
@@ -0,0 +1,159 @@
+/*
+ * Granulator.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: granular synthesis over shared samples, thousands of grains from a fixed pool
+ */
+
+#ifndef GRANULATOR_H_
+#define GRANULATOR_H_
+
+#include "AudioModules.h"
+#include "SampleCache.h"
+#include "Random.h"
+
+#include <string>
+#include <atomic>
+#include <stdint.h>
+
+enum grainWindow {grain_hann_, grain_gauss_, grain_tukey_, grain_triangle_, grain_windowsNum_};
+
+#define GRANULATOR_DEFAULT_GRAINS 2048
+#define GRANULATOR_WINDOW_LEN 1024			// samples per window table, plus one guard frame
+#define GRANULATOR_DEFAULT_SMOOTHING 0.05	// seconds it takes parameters to get close to new values [time constant]
+#define GRANULATOR_FRAC_BITS 32				// source and window positions are fixed point 32.32
+#define GRANULATOR_FRAC_MASK 0xFFFFFFFFLL
+#define GRANULATOR_FRAC_SCALE (1.0/4294967296.0)
+
+// everything a grain needs is computed at onset, then it only advances
+struct Grain {
+	int64_t pos;	  // in samples
+	int64_t inc;	  // pitch
+	int64_t winPos;	  // in window table
+	int64_t winInc;
+	double gainL;
+	double gainR;
+	int remaining;	  // samples left to play
+	int offset;		  // where it starts within current period, 0 after first period
+	const double *window;
+};
+
+// set from any thread, followed by the audio thread with a one-pole glide
+struct GranulatorParam {
+	std::atomic<double> target;
+	double current;
+
+	void reset(double value);
+	double getAt(double coeffPow); // value after some samples, coeffPow is coefficient raised to their number
+};
+
+//----------------------------------------------------------------------------------
+// Spawns grains from a single shared sample buffer, each grain with its own position, pitch, duration and pan
+// onsets are scheduled with sub-sample precision within the period, not once per period
+// all grains come from a pool allocated at init, when it is exhausted new grains are skipped and counted in one step, so cost never goes past what the pool allows
+// windows are tables computed once and shared by all Granulators
+// setters can be called from any thread, values glide towards new settings and are sampled by each grain at its onset
+//----------------------------------------------------------------------------------
+class Granulator : public AudioModuleOut {
+public:
+	Granulator();
+	~Granulator();
+	int init(SamplePtr data, int rate, unsigned int periodSize, double level=1, unsigned short outChannels=2, unsigned short outChnOffset=0, int maxGrains=GRANULATOR_DEFAULT_GRAINS);
+	int init(std::string filename, int rate, unsigned int periodSize, double level=1, int chnIndex=-1, unsigned short outChannels=2, unsigned short outChnOffset=0, int maxGrains=GRANULATOR_DEFAULT_GRAINS);
+	double **getFrameBuffer(int numOfSamples);
+	void retrigger(); // silences all grains and restarts scheduling, at next period [any thread]
+
+	void setDensity(double grainsPerSecond); // at most one grain per sample
+	void setPosition(double position); // 0 is start of samples, 1 end
+	void setPositionJitter(double jitter); // random offset of each grain around position, same unit
+	void setPitch(double ratio);		   // 1 is original pitch, must be positive
+	void setDuration(double seconds);
+	void setSpread(double spread);		   // 0 all grains in the center, 1 each grain panned randomly across whole stereo field
+	void setWindow(grainWindow window);
+	void setSmoothingTime(double seconds); // not from audio thread
+
+	int getActiveGrainsNum();
+	unsigned int getSkippedGrains(); // onsets that found the pool full
+
+protected:
+	SamplePtr data;
+	int rate;
+	Random random;
+
+	Grain *grains; // active ones are at the beginning
+	int maxGrains;
+	int activeGrains;
+	std::atomic<int> activeGrainsShared; // for getActiveGrainsNum() from other threads
+	std::atomic<unsigned int> skippedGrains;
+	std::atomic<bool> retriggerPending; // pool is only touched by audio thread
+
+	double nextOnset; // samples from beginning of current period, fractional [and down to -1, when an onset falls between two periods]
+
+	GranulatorParam density;
+	GranulatorParam position;
+	GranulatorParam jitter;
+	GranulatorParam pitch;
+	GranulatorParam duration;
+	GranulatorParam spread;
+	std::atomic<int> window;
+	double smoothTime;
+	double smoothCoeff;
+
+	void spawnGrain(int offset, double delay, double smoothPow);
+	void mixGrain(Grain &g, double *outL, double *outR, int numOfSamples);
+	void deallocate();
+
+	static const double *getWindowTable(grainWindow window);
+};
+
+inline void GranulatorParam::reset(double value) {
+	target = value;
+	current = value;
+}
+
+inline double GranulatorParam::getAt(double coeffPow) {
+	double t = target.load(std::memory_order_relaxed);
+	return t + (current-t)*coeffPow;
+}
+
+inline void Granulator::setDensity(double grainsPerSecond) {
+	density.target = (grainsPerSecond > 0) ? grainsPerSecond : 0;
+}
+
+inline void Granulator::setPosition(double position) {
+	this->position.target = position;
+}
+
+inline void Granulator::setPositionJitter(double jitter) {
+	this->jitter.target = jitter;
+}
+
+inline void Granulator::setPitch(double ratio) {
+	if(ratio <= 0) {
+		printf("Granulator error! Pitch ratio must be positive, %f was passed\n", ratio);
+		return;
+	}
+	pitch.target = ratio;
+}
+
+inline void Granulator::setDuration(double seconds) {
+	duration.target = seconds;
+}
+
+inline void Granulator::setSpread(double spread) {
+	this->spread.target = spread;
+}
+
+inline void Granulator::setWindow(grainWindow window) {
+	this->window = window;
+}
+
+inline int Granulator::getActiveGrainsNum() {
+	return activeGrainsShared.load();
+}
+
+inline unsigned int Granulator::getSkippedGrains() {
+	return skippedGrains.load();
+}
+
+#endif /* GRANULATOR_H_ */
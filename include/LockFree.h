@@ -0,0 +1,376 @@
+/*
+ * LockFree.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: wait free containers to pass data out of and into the audio thread
+ */
+
+#ifndef LOCKFREE_H_
+#define LOCKFREE_H_
+
+#include <atomic>
+#include <cstddef> // NULL
+
+//----------------------------------------------------------------------------------
+// Triple buffer, single producer and single consumer
+// producer always has a slot to write to and never waits, consumer always gets the latest published slot
+// intermediate slots can be skipped if the consumer is slower than the producer, which is what we want for GUIs and meters
+// slots are preallocated T objects, the owner can init them through getSlot() before use
+//----------------------------------------------------------------------------------
+template<typename T>
+class TripleBuffer {
+public:
+	TripleBuffer();
+	T *getSlot(int i); // for setup only, not thread safe
+
+	// producer side
+	T *getWriteSlot();
+	void publish();
+
+	// consumer side
+	bool update(); // true if a new slot was published since last call
+	T *getReadSlot();
+
+protected:
+	T slots[3];
+	int writeIndex; // producer only
+	int readIndex;	// consumer only
+	std::atomic<int> middle; // slot in between, plus flag that tells if it is fresh
+
+	static const int freshFlag = 4;
+};
+
+template<typename T>
+inline TripleBuffer<T>::TripleBuffer() {
+	writeIndex = 0;
+	middle = 1;
+	readIndex = 2;
+}
+
+template<typename T>
+inline T *TripleBuffer<T>::getSlot(int i) {
+	return &slots[i];
+}
+
+template<typename T>
+inline T *TripleBuffer<T>::getWriteSlot() {
+	return &slots[writeIndex];
+}
+
+// swaps written slot with middle one
+template<typename T>
+inline void TripleBuffer<T>::publish() {
+	int prev = middle.exchange(writeIndex | freshFlag, std::memory_order_acq_rel);
+	writeIndex = prev & (freshFlag-1);
+}
+
+// swaps read slot with middle one, only if middle has something new
+template<typename T>
+inline bool TripleBuffer<T>::update() {
+	if( (middle.load(std::memory_order_relaxed) & freshFlag) == 0 )
+		return false;
+	int prev = middle.exchange(readIndex, std::memory_order_acq_rel);
+	readIndex = prev & (freshFlag-1);
+	return true;
+}
+
+template<typename T>
+inline T *TripleBuffer<T>::getReadSlot() {
+	return &slots[readIndex];
+}
+
+
+
+
+//----------------------------------------------------------------------------------
+// Ring buffer of slots, single producer and single consumer
+// slots are preallocated T objects that are filled and read in place: getWriteSlot() then push(), getReadSlot() then pop()
+// neither side ever waits, a full ring returns NULL to the producer and an empty one returns NULL to the consumer
+// capacity is rounded up to a power of 2, indices are free running and wrap through a mask
+//----------------------------------------------------------------------------------
+template<typename T>
+class SpscRing {
+public:
+	SpscRing();
+	~SpscRing();
+	int init(unsigned int capacity); // not thread safe, returns actual capacity
+	T *getSlot(unsigned int i);		 // for setup only, not thread safe
+	unsigned int getCapacity();
+
+	// producer side
+	T *getWriteSlot(); // NULL if full
+	void push();
+	bool push(const T &item); // copy, false if full
+
+	// consumer side
+	T *getReadSlot(); // NULL if empty
+	void pop();
+	bool pop(T &item); // copy, false if empty
+	unsigned int getReadAvailable();
+
+protected:
+	T *slots;
+	unsigned int capacity;
+	unsigned int mask;
+
+	// each index on its own cache line, plus a cached copy of the other side's index
+	char pad0[64];
+	std::atomic<unsigned int> writeIndex;
+	unsigned int cachedRead; // producer only
+	char pad1[64];
+	std::atomic<unsigned int> readIndex;
+	unsigned int cachedWrite; // consumer only
+	char pad2[64];
+};
+
+template<typename T>
+inline SpscRing<T>::SpscRing() {
+	slots = NULL;
+	capacity = 0;
+	mask = 0;
+	writeIndex = 0;
+	cachedRead = 0;
+	readIndex = 0;
+	cachedWrite = 0;
+}
+
+template<typename T>
+inline SpscRing<T>::~SpscRing() {
+	if(slots != NULL)
+		delete[] slots;
+}
+
+template<typename T>
+inline int SpscRing<T>::init(unsigned int capacity) {
+	unsigned int size = 1;
+	while(size < capacity)
+		size <<= 1;
+
+	if(slots != NULL)
+		delete[] slots;
+	slots = new T[size];
+	this->capacity = size;
+	mask = size-1;
+	writeIndex = 0;
+	cachedRead = 0;
+	readIndex = 0;
+	cachedWrite = 0;
+	return size;
+}
+
+template<typename T>
+inline T *SpscRing<T>::getSlot(unsigned int i) {
+	return &slots[i];
+}
+
+template<typename T>
+inline unsigned int SpscRing<T>::getCapacity() {
+	return capacity;
+}
+
+template<typename T>
+inline T *SpscRing<T>::getWriteSlot() {
+	unsigned int w = writeIndex.load(std::memory_order_relaxed);
+	if(w-cachedRead == capacity) {
+		cachedRead = readIndex.load(std::memory_order_acquire);
+		if(w-cachedRead == capacity)
+			return NULL;
+	}
+	return &slots[w & mask];
+}
+
+template<typename T>
+inline void SpscRing<T>::push() {
+	writeIndex.store(writeIndex.load(std::memory_order_relaxed)+1, std::memory_order_release);
+}
+
+template<typename T>
+inline bool SpscRing<T>::push(const T &item) {
+	T *slot = getWriteSlot();
+	if(slot == NULL)
+		return false;
+	*slot = item;
+	push();
+	return true;
+}
+
+template<typename T>
+inline T *SpscRing<T>::getReadSlot() {
+	unsigned int r = readIndex.load(std::memory_order_relaxed);
+	if(r == cachedWrite) {
+		cachedWrite = writeIndex.load(std::memory_order_acquire);
+		if(r == cachedWrite)
+			return NULL;
+	}
+	return &slots[r & mask];
+}
+
+template<typename T>
+inline void SpscRing<T>::pop() {
+	readIndex.store(readIndex.load(std::memory_order_relaxed)+1, std::memory_order_release);
+}
+
+template<typename T>
+inline bool SpscRing<T>::pop(T &item) {
+	T *slot = getReadSlot();
+	if(slot == NULL)
+		return false;
+	item = *slot;
+	pop();
+	return true;
+}
+
+template<typename T>
+inline unsigned int SpscRing<T>::getReadAvailable() {
+	cachedWrite = writeIndex.load(std::memory_order_acquire);
+	return cachedWrite - readIndex.load(std::memory_order_relaxed);
+}
+
+
+
+
+//----------------------------------------------------------------------------------
+// Ring buffer of slots, many producers and a single consumer
+// producers claim a slot with getWriteSlot(), fill it and publish it with push(ticket), in any order among them
+// the consumer sees slots in claim order, a claimed slot that is not published yet holds back the ones after it
+// no one ever waits on a lock, a full ring returns NULL to the producer and an empty one returns NULL to the consumer
+// each slot carries a sequence number that tells whose turn it is [bounded queue by D. Vyukov]
+//----------------------------------------------------------------------------------
+template<typename T>
+class MpscRing {
+public:
+	MpscRing();
+	~MpscRing();
+	int init(unsigned int capacity); // not thread safe, returns actual capacity
+	unsigned int getCapacity();
+
+	// producers side, any thread
+	T *getWriteSlot(unsigned int &ticket); // NULL if full
+	void push(unsigned int ticket);
+	bool push(const T &item); // copy, false if full
+
+	// consumer side
+	T *getReadSlot(); // NULL if empty
+	void pop();
+	bool pop(T &item); // copy, false if empty
+
+protected:
+	struct Cell {
+		std::atomic<unsigned int> sequence;
+		T item;
+	};
+	Cell *cells;
+	unsigned int capacity;
+	unsigned int mask;
+
+	char pad0[64];
+	std::atomic<unsigned int> writeIndex; // shared by producers
+	char pad1[64];
+	unsigned int readIndex; // consumer only
+	char pad2[64];
+};
+
+template<typename T>
+inline MpscRing<T>::MpscRing() {
+	cells = NULL;
+	capacity = 0;
+	mask = 0;
+	writeIndex = 0;
+	readIndex = 0;
+}
+
+template<typename T>
+inline MpscRing<T>::~MpscRing() {
+	if(cells != NULL)
+		delete[] cells;
+}
+
+template<typename T>
+inline int MpscRing<T>::init(unsigned int capacity) {
+	unsigned int size = 1;
+	while(size < capacity)
+		size <<= 1;
+
+	if(cells != NULL)
+		delete[] cells;
+	cells = new Cell[size];
+	for(unsigned int i=0; i<size; i++)
+		cells[i].sequence = i;
+	this->capacity = size;
+	mask = size-1;
+	writeIndex = 0;
+	readIndex = 0;
+	return size;
+}
+
+template<typename T>
+inline unsigned int MpscRing<T>::getCapacity() {
+	return capacity;
+}
+
+// slot is free when its sequence equals the index that claims it
+template<typename T>
+inline T *MpscRing<T>::getWriteSlot(unsigned int &ticket) {
+	if(cells == NULL)
+		return NULL;
+	unsigned int w = writeIndex.load(std::memory_order_relaxed);
+	while(true) {
+		Cell *cell = &cells[w & mask];
+		int diff = (int)(cell->sequence.load(std::memory_order_acquire) - w);
+		if(diff == 0) {
+			if(writeIndex.compare_exchange_weak(w, w+1, std::memory_order_relaxed)) {
+				ticket = w;
+				return &cell->item;
+			}
+		}
+		else if(diff < 0)
+			return NULL; // consumer has not freed it yet
+		else
+			w = writeIndex.load(std::memory_order_relaxed); // another producer got it
+	}
+}
+
+template<typename T>
+inline void MpscRing<T>::push(unsigned int ticket) {
+	cells[ticket & mask].sequence.store(ticket+1, std::memory_order_release);
+}
+
+template<typename T>
+inline bool MpscRing<T>::push(const T &item) {
+	unsigned int ticket;
+	T *slot = getWriteSlot(ticket);
+	if(slot == NULL)
+		return false;
+	*slot = item;
+	push(ticket);
+	return true;
+}
+
+template<typename T>
+inline T *MpscRing<T>::getReadSlot() {
+	if(cells == NULL)
+		return NULL;
+	Cell *cell = &cells[readIndex & mask];
+	if(cell->sequence.load(std::memory_order_acquire) != readIndex+1)
+		return NULL;
+	return &cell->item;
+}
+
+// slot goes back to producers one lap later
+template<typename T>
+inline void MpscRing<T>::pop() {
+	cells[readIndex & mask].sequence.store(readIndex+capacity, std::memory_order_release);
+	readIndex++;
+}
+
+template<typename T>
+inline bool MpscRing<T>::pop(T &item) {
+	T *slot = getReadSlot();
+	if(slot == NULL)
+		return false;
+	item = *slot;
+	pop();
+	return true;
+}
+
+#endif /* LOCKFREE_H_ */
@@ -0,0 +1,136 @@
+/*
+ * Looper.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: live looper, records input into memory allocated and locked at init
+ */
+
+#ifndef LOOPER_H_
+#define LOOPER_H_
+
+#include "AudioModules.h"
+
+#include <atomic>
+#include <stdint.h>
+
+enum looperMode {looper_stop_, looper_record_, looper_overdub_, looper_play_, looper_multiply_};
+
+#define LOOPER_DEFAULT_CROSSFADE 0.01 // seconds
+#define LOOPER_NO_REQUEST -1
+#define LOOPER_RETRIGGER 0xFF		 // request code next to modes, sent by retrigger()
+#define LOOPER_MAX_OFFSET ((1<<23)-1) // offset shares request with mode, in its upper 23 bits
+
+//----------------------------------------------------------------------------------
+// Records consecutive input channels and plays them back on as many consecutive output channels, like a Waveform does with its samples
+// record:   starts a new loop, its length is set when recording ends
+// overdub:  adds input on top of the loop while it plays, the old content is scaled by feedback
+// play:     plays the loop
+// multiply: from next loop start, appends copies of the loop plus input, one whole cycle at a time, the loop grows until another mode is chosen and current cycle ends
+// modes can be changed from any thread and take effect at a chosen sample of the next period
+// overdub and multiply write input only between punch points, if set
+// audio that goes on after recording ends is kept and crossfaded into the loop start, so the wrap is seamless
+// all memory is allocated, locked in RAM and touched at init, nothing is allocated afterwards
+//----------------------------------------------------------------------------------
+class Looper : public AudioModuleInOut {
+public:
+	Looper();
+	~Looper();
+	int init(double maxSeconds, int rate, unsigned int periodSize, unsigned short channels=1, unsigned short inChnOffset=0, unsigned short outChnOffset=0,
+			 double level=1, double crossfadeSeconds=LOOPER_DEFAULT_CROSSFADE);
+	double **getFrameBuffer(int numOfSamples, double **input);
+	void retrigger(); // from any thread, at beginning of next period, it replaces a pending mode change
+
+	void setMode(looperMode mode, int offset=0); // offset is sample of next period where change happens, can be longer than a period [up to LOOPER_MAX_OFFSET]
+	looperMode getMode();
+	void setPunchPoints(long punchIn, long punchOut); // in loop frames [in multiply, frames of original loop], -1 to write everywhere
+	void setFeedback(double feedback);
+	long getLoopLength();
+	long getCurrentFramePos();
+	double *getWaveform(int chn=0); // first getLoopLength() frames are the loop
+	bool isLocked(); // false if memory could not be locked, it works anyway but may page fault
+
+protected:
+	unsigned short channels;
+	int rate;
+	double *memory;		 // loop and tail of all channels, in one block
+	size_t memoryBytes;
+	bool locked;
+	double **loop;		 // one per channel
+	double **tail;		 // audio right after end of recording, crossfaded into first frames of the loop
+	long capacity;		 // frames
+	int crossfadeMax;	 // frames, as set at init
+	int crossfadeLen;	 // frames, shorter for short loops
+	int tailFilled;
+
+	looperMode mode;
+	long loopLen;		 // 0 if there is no loop
+	long pos;			 // playhead, or record head
+	long baseLen;		 // loop length before multiply
+	bool multiplyArmed;	 // waits for next loop start
+	bool multiplyEnding; // finishes current cycle
+	looperMode afterMultiply;
+
+	std::atomic<int> request; // packed mode and offset, LOOPER_NO_REQUEST if none
+	std::atomic<int64_t> punch; // packed punch points
+	std::atomic<double> feedback;
+	std::atomic<int> modeShared;
+	std::atomic<long> loopLenShared;
+	std::atomic<long> posShared;
+
+	void applyMode(looperMode newMode);
+	void restart();
+	void finishRecording();
+	int processRun(double **input, int n, int len);
+	int runRecord(double **input, int n, int len);
+	int runLoop(double **input, int n, int len);
+	void captureTail(double **input, int n, int len);
+	int limitToPunch(long x, int len, bool &write);
+	void deallocate();
+};
+
+inline void Looper::setMode(looperMode mode, int offset) {
+	if(offset < 0)
+		offset = 0;
+	if(offset > LOOPER_MAX_OFFSET) {
+		printf("Looper error! Mode change offset can be at most %d frames, %d was passed\n", LOOPER_MAX_OFFSET, offset);
+		return;
+	}
+	request = (offset<<8) | (int)mode;
+}
+
+inline void Looper::retrigger() {
+	request = LOOPER_RETRIGGER;
+}
+
+inline looperMode Looper::getMode() {
+	return (looperMode)modeShared.load();
+}
+
+inline void Looper::setPunchPoints(long punchIn, long punchOut) {
+	if(punchIn < 0 || punchOut <= punchIn)
+		punch = -1;
+	else
+		punch = ((int64_t)punchIn<<32) | (uint32_t)punchOut;
+}
+
+inline void Looper::setFeedback(double feedback) {
+	this->feedback = feedback;
+}
+
+inline long Looper::getLoopLength() {
+	return loopLenShared.load();
+}
+
+inline long Looper::getCurrentFramePos() {
+	return posShared.load();
+}
+
+inline double *Looper::getWaveform(int chn) {
+	return loop[chn];
+}
+
+inline bool Looper::isLocked() {
+	return locked;
+}
+
+#endif /* LOOPER_H_ */
@@ -0,0 +1,104 @@
+/*
+ * MultiAudioFile.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: multichannel audio file player, each file channel goes to its own output
+ */
+
+#ifndef MULTIAUDIOFILE_H_
+#define MULTIAUDIOFILE_H_
+
+#include "AudioModules.h"
+#include "Waveforms.h" // advanceType, AudioFile::loadChannels()
+
+#include <string>
+#include <vector>
+
+// a run of consecutive frames to play within a period, backwards if direction is -1, silence if 0
+struct PlaybackSegment {
+	long start;
+	int len;
+	char direction;
+};
+
+//----------------------------------------------------------------------------------
+// Plays all channels of a file with one playhead, no downmix
+// channels are decoded once, kept planar and shared through the SampleCache [also with AudioFiles that play single channels of same file]
+// the playhead path of each period is computed once and then applied to all channels
+// output channel i plays file channel i, wrapping around if there are more outputs than file channels
+//----------------------------------------------------------------------------------
+class MultiAudioFile : public AudioModuleOut {
+public:
+	MultiAudioFile();
+	MultiAudioFile(advanceType adv);
+	~MultiAudioFile();
+	int init(std::string filename, int rate, unsigned int periodSize, double level=1, unsigned short outChannels=0, unsigned short outChnOffset=0); // 0 outChannels means as many as file
+	double **getFrameBuffer(int numOfSamples);
+	void retrigger();
+	void retrigger(unsigned long frameN);
+	void stop();
+	void resume();
+	void setAdvanceType(advanceType adv);
+
+	int getFileChannelsNum();
+	int getWaveformLen();
+	double *getWaveform(int chn);
+	int getCurrentFramePos();
+
+protected:
+	std::vector<SamplePtr> channels; // keeps planes alive
+	double **planes;
+	int fileChannels;
+	long frameNum;
+	advanceType advType;
+	long currentFrame;
+	char direction; // 1 forward, -1 backwards
+	bool isPlaying;
+
+	PlaybackSegment *segments; // path of current period
+	int segmentsNum;
+
+	void computeSegments(int numOfSamples);
+	void deallocate();
+};
+
+inline void MultiAudioFile::retrigger() {
+	retrigger(0);
+}
+
+inline void MultiAudioFile::retrigger(unsigned long frameN) {
+	currentFrame = (frameN < (unsigned long)frameNum) ? frameN : 0;
+	isPlaying = true;
+}
+
+inline void MultiAudioFile::stop() {
+	isPlaying = false;
+}
+
+inline void MultiAudioFile::resume() {
+	isPlaying = true;
+}
+
+inline void MultiAudioFile::setAdvanceType(advanceType adv) {
+	advType = adv;
+	if(advType != adv_backAndForth_)
+		direction = 1;
+}
+
+inline int MultiAudioFile::getFileChannelsNum() {
+	return fileChannels;
+}
+
+inline int MultiAudioFile::getWaveformLen() {
+	return frameNum;
+}
+
+inline double *MultiAudioFile::getWaveform(int chn) {
+	return planes[chn];
+}
+
+inline int MultiAudioFile::getCurrentFramePos() {
+	return currentFrame;
+}
+
+#endif /* MULTIAUDIOFILE_H_ */
@@ -0,0 +1,46 @@
+/*
+ * NetworkIO.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: one network thread for all receiving sockets, epoll plus batched reads
+ */
+
+#ifndef NETWORKIO_H_
+#define NETWORKIO_H_
+
+#define NETWORK_IO_BATCH 32				// datagrams read with a single system call
+#define NETWORK_IO_MAX_DATAGRAM 16384	// longer datagrams are dropped
+#define NETWORK_IO_MAX_BATCHES 8		// per socket per wake up, so that a busy socket does not starve the others
+#define NETWORK_IO_MAX_EVENTS 64
+
+//----------------------------------------------------------------------------------
+// Receives datagrams from a socket, called on the network thread
+//----------------------------------------------------------------------------------
+class NetworkHandler {
+public:
+	virtual ~NetworkHandler() {}
+	virtual void receivePacket(const char *data, int size) = 0;
+};
+
+//----------------------------------------------------------------------------------
+// Single thread that waits on all registered sockets with epoll, and drains each with recvmmsg in batches
+// datagrams are passed to the handler of their socket, in order, with no copies
+// the thread is started when the first socket is added and runs until shutdown() [e.g., in cleanup()], idle threads cost nothing
+// its state is built on first use and never destroyed, so servers that are destroyed at exit can still remove their sockets
+//----------------------------------------------------------------------------------
+class NetworkIO {
+public:
+	static int addSocket(int fd, NetworkHandler *handler); // not from audio thread
+	static void removeSocket(int fd); // not from audio thread, nor from a handler, when it returns the handler is not called anymore
+	static void setPriority(int prio); // used next time the thread starts, i.e., when first socket is added
+	static void shutdown(); // stops and joins thread, all sockets are forgotten, adding a new one starts it again
+	static unsigned int getDroppedPackets(); // too long for NETWORK_IO_MAX_DATAGRAM
+
+protected:
+	static int prioNetwork;
+	static int startThread();
+	static void drainSocket(int fd, NetworkHandler *handler);
+	static void *networkLoop(void *arg);
+};
+
+#endif /* NETWORKIO_H_ */
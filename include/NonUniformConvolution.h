@@ -0,0 +1,110 @@
+/*
+ * NonUniformConvolution.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: non uniformly partitioned convolution, head on the caller's thread and tail stages on background threads
+ *                partitioning follows the classic scheme by W. G. Gardner, "Efficient convolution without input-output delay", 1995
+ */
+
+#ifndef NONUNIFORMCONVOLUTION_H_
+#define NONUNIFORMCONVOLUTION_H_
+
+#include "PartitionedConvolution.h"
+
+#include <atomic>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define NUC_GROWTH 4		// each tail stage has partitions this many times longer than previous one
+#define NUC_MAX_BLOCK 8192	// longest partition, last stage covers the rest of the response with as many of these as needed
+#define NUC_SLOTS 4			// blocks in flight between audio thread and each stage's thread
+
+class NonUniformConvolution;
+
+// a stage with partitions of blockSize covers the response from offset 2*blockSize on
+// the result of each input block is needed only one block after it is handed off, which is the deadline for its thread
+struct NonUniformStage {
+	NonUniformConvolution *owner;
+	PartitionedConvolution convolution;
+	int blockSize;
+	int offset;
+
+	double *inSlots[NUC_SLOTS];
+	double *outSlots[NUC_SLOTS];
+	double *zeros;						// input of blocks that could not be handed off
+	std::atomic<long> slotBlock[NUC_SLOTS]; // which block each input slot holds
+	std::atomic<long> handedOff;			// blocks given to thread so far
+	std::atomic<long> completed;			// blocks whose output is ready
+	std::atomic<long> resetFrom;			// first block after last reset
+
+	// audio thread only
+	int fill;
+	bool writable;
+	long lastMissed;
+
+	pthread_t thread;
+	sem_t start;
+	int prio;
+};
+
+//----------------------------------------------------------------------------------
+// Single channel, same interface as PartitionedConvolution
+// head partitions are as long as the block and cover the first 2*NUC_GROWTH blocks of the response, computed in process()
+// all the rest is split in stages of growing partitions, each computed by its own lower priority thread
+// no latency is added: a stage's result is due only one of its blocks after its input is complete
+// a stage that misses its deadline is skipped for that block [and counted], process() never waits for the threads
+//----------------------------------------------------------------------------------
+class NonUniformConvolution {
+public:
+	NonUniformConvolution();
+	~NonUniformConvolution();
+	int init(double *ir, int irLen, int blockSize, fft_planning planning=fft_plan_measure); // allocates, plans and starts threads, not from audio thread
+	void process(double *in, double *out, int numOfSamples); // numOfSamples should be blockSize, but for a possible shorter last call
+	void reset();
+
+	int getBlockSize();
+	int getStagesNum();
+	unsigned int getMissedDeadlines(); // blocks of tail output that were not ready in time
+	unsigned int getDroppedBlocks();   // blocks of input that could not be handed off, because a thread was way too late
+
+	static void setTailPriority(int prio); // of first stage's thread, longer stages get lower priorities
+
+protected:
+	int blockSize;
+	PartitionedConvolution head;
+	NonUniformStage *stages;
+	int stagesNum;
+	long time; // samples processed so far
+
+	std::atomic<bool> stopStages; // also checked while catching up on late blocks
+	std::atomic<unsigned int> missedDeadlines;
+	std::atomic<unsigned int> droppedBlocks;
+	static int prioTail;
+
+	void feedStage(NonUniformStage *stage, double *in, int numOfSamples);
+	void readStage(NonUniformStage *stage, double *out, int numOfSamples);
+	void deallocate();
+	static void *stageLoop(void *arg);
+};
+
+inline int NonUniformConvolution::getBlockSize() {
+	return blockSize;
+}
+
+inline int NonUniformConvolution::getStagesNum() {
+	return stagesNum;
+}
+
+inline unsigned int NonUniformConvolution::getMissedDeadlines() {
+	return missedDeadlines.load();
+}
+
+inline unsigned int NonUniformConvolution::getDroppedBlocks() {
+	return droppedBlocks.load();
+}
+
+inline void NonUniformConvolution::setTailPriority(int prio) {
+	prioTail = prio;
+}
+
+#endif /* NONUNIFORMCONVOLUTION_H_ */
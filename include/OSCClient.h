@@ -29,7 +29,16 @@
 
 #include "UdpClient.h"
 #include "oscpkt.hh"
-#include <queue>
+#include "LockFree.h"
+#include <atomic>
+#include <stdint.h>
+
+#define OSC_OUT_MESSAGE_MAX_BYTES 512	// larger messages are not queued
+#define OSC_OUT_MAX_ARGS 32
+#define OSC_CLIENT_SLOTS 256				// messages that can wait for the send thread
+#define OSC_CLIENT_MTU 1472					// bundles fit in an ethernet frame, 1500 minus ip and udp headers
+#define OSC_CLIENT_DEFAULT_WINDOW 0.02		// seconds, each coalesced address is sent at most once per window
+#define OSC_CLIENT_MAX_ADDRESSES 512		// addresses that can be coalesced, others are sent as they come
 
 /**
  * \brief OSCMessageFactory provides functions for building OSC messages within Bela.
@@ -93,9 +102,75 @@ class OSCMessageFactory{
         oscpkt::Message msg;
 };
 
+/**
+ * \brief OSCOutMessage builds an OSC message in fixed size buffers, without allocating
+ *
+ * This class is safe to use on the audio thread, usually as a local variable:
+ *
+ * oscClient.queueMessage(OSCOutMessage().to("/meter/1").add(level));
+ *
+ * If the message grows past OSC_OUT_MESSAGE_MAX_BYTES or OSC_OUT_MAX_ARGS, it is marked as
+ * not valid and it will not be queued
+ */
+class OSCOutMessage{
+    public:
+        OSCOutMessage();
+
+        OSCOutMessage& to(const char *address);
+        OSCOutMessage& add(int);
+        OSCOutMessage& add(float);
+        OSCOutMessage& add(double); // sent as float, like most receivers expect
+        OSCOutMessage& add(bool);
+        OSCOutMessage& add(const char *string);
+
+        bool isOk() const;
+        int getSize() const; // in binary format, -1 if not valid
+
+        /**
+		 * \brief Writes the message in OSC binary format
+		 *
+		 * \return the number of bytes written, or -1 if the message is not valid or does not fit
+		 */
+        int serialize(char *dest, int maxSize) const;
+
+    private:
+        char address[OSC_OUT_MESSAGE_MAX_BYTES];
+        int addressLen;
+        char typeTags[OSC_OUT_MAX_ARGS+1];
+        int argsNum;
+        char args[OSC_OUT_MESSAGE_MAX_BYTES];
+        int argsSize;
+        bool ok;
+
+        bool reserve(int size);
+};
+
+// a queued message, already in binary form
+struct OSCOutSlot{
+    char data[OSC_OUT_MESSAGE_MAX_BYTES];
+    int size;
+    bool coalesce;
+};
+
+// latest message sent to an address, and when that address can be sent again
+struct OSCCoalescedAddress{
+    char data[OSC_OUT_MESSAGE_MAX_BYTES]; // starts with the address
+    int size;
+    bool used;
+    bool pending;
+    double nextSend;
+};
+
 /**
  * \brief OSCClient provides functions for sending OSC messages from Bela.
  *
+ * Messages queued from any thread, the audio thread included, are copied in binary form into a
+ * lock-free queue and a send thread wakes up to send them, packed into bundles that fit in a UDP
+ * datagram of OSC_CLIENT_MTU bytes.
+ * All queued messages are sent, unless they are queued with coalesce set to true: then, within a
+ * rate window, only the latest message to each address is sent, so that fast streams like meters
+ * do not flood the network. Discrete events [e.g., note ons] must not be coalesced.
+ *
  * Care must be taken to use the correct methods while running on the audio thread to
  * prevent Xenomai mode switches and audio glitches.
  *
@@ -123,20 +198,48 @@ class OSCClient{
 		 */
         ~OSCClient(); //Vic
 
-        void setup(int port, const char* address="127.0.0.1"/*, bool scheduleTask = true Vic, added: */, int prio=10 );
+        void setup(int port, const char* address="127.0.0.1"/*, bool scheduleTask = true Vic, added: */, int prio=10, int slots=OSC_CLIENT_SLOTS);
 
         /**
-		 * \brief Queue an OSC message to be sent at the end of the current audio block
+		 * \brief Queue an OSC message to be sent by the send thread
 		 *
-		 * This method is audio-thread safe, and can be used from render()
+		 * This method is audio-thread safe, and can be used from render() and from any other thread
 		 *
 		 * This is the function you would usually use to send OSC messages
 		 * The messages are sent over UDP to the IP and port specified in setup()
+		 * It never allocates nor locks, the send thread is woken up at most once until it runs
+		 *
+		 * @param msg the message
+		 * @param coalesce if true, only the latest message to this address within the rate window is sent [for streams, like meters]
+		 * \return false if the message is not valid or the queue is full
+		 *
+		 */
+        bool queueMessage(const OSCOutMessage &msg, bool coalesce=false);
+
+        /**
+		 * \brief Queue an oscpkt message to be sent by the send thread
+		 *
+		 * This method is *not* audio-thread safe, since it allocates while formatting the message
 		 *
 		 * @param oscpkt::Message an oscpkt Message object representing an OSC message
+		 * @param coalesce if true, only the latest message to this address within the rate window is sent [for streams, like meters]
+		 *
+		 */
+        bool queueMessage(oscpkt::Message, bool coalesce=false);
+
+        /**
+		 * \brief Sets how often each coalesced address can be sent, 0 to send all messages
+		 *
+		 * @param seconds the rate window
+		 *
+		 */
+        void setRateWindow(double seconds);
+
+        /**
+		 * \brief Returns the number of messages that were not queued because the queue was full
 		 *
 		 */
-        void queueMessage(oscpkt::Message);
+        unsigned int getDroppedMessages();
 
         /**
 		 * \brief Send an OSC message immediately *** do not use on audio thread! ***
@@ -171,19 +274,44 @@ class OSCClient{
         UdpClient socket;
         //AuxiliaryTask OSCSendTask; //VIC commented out and replaced with pthread
         pthread_t sendThread;
+        bool sendThreadStarted;
         //VIC
         static int prioSendThread;
-        static bool shouldStop;
+        std::atomic<bool> shouldStop;
 
-        std::queue<oscpkt::Message> outQueue;
+        MpscRing<OSCOutSlot> outQueue;
+        std::atomic<bool> wakePending; // send thread was already signalled
+        int wakeFd; // eventfd
+        std::atomic<double> rateWindow;
+        std::atomic<unsigned int> droppedMessages;
+        OSCCoalescedAddress *addresses; // open addressing table
+        char bundle[OSC_CLIENT_MTU];
+        int bundleSize;
         oscpkt::PacketWriter pw;
         char* outBuffer;
 
         static void *sendQueue(void*);
 
         //void createAuxTasks(); //Vic
-        void queueSend();
+        int queueSend(); // returns milliseconds until next coalesced message is due, -1 if none
+        bool queueBinary(const char *data, int size, bool coalesce);
+        void coalesce(const OSCOutSlot *slot, double now);
+        void addToBundle(const char *data, int size);
+        void sendBundle();
+        void wake();
 
 };
 
+inline void OSCClient::setRateWindow(double seconds){
+    rateWindow = (seconds > 0) ? seconds : 0;
+}
+
+inline unsigned int OSCClient::getDroppedMessages(){
+    return droppedMessages.load();
+}
+
+inline bool OSCOutMessage::isOk() const{
+    return ok;
+}
+
 #endif
@@ -0,0 +1,98 @@
+/*
+ * OSCDispatcher.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: routes received OSC messages to module parameters, off the audio thread
+ */
+
+#ifndef OSCDISPATCHER_H_
+#define OSCDISPATCHER_H_
+
+#include "OSCServer.h" // OSCMessageView
+#include "LockFree.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+#define OSC_PARAM_QUEUE_SLOTS 256 // events that can wait for the audio thread
+#define OSC_SEGMENT_MAX_LEN 128	  // longest part of an address between slashes
+
+// what the audio thread receives, already decoded
+struct OSCParamEvent {
+	int paramId;
+	double value;
+	uint64_t timeTag; // of the message, 1 means immediately
+};
+
+//----------------------------------------------------------------------------------
+// Parameter events for one module, filled by the network thread and drained by the audio thread with pop()
+// a single thread can push into it [all servers share the network thread, but receiveMessageNow() must not be used on servers that target it]
+//----------------------------------------------------------------------------------
+class OSCParamQueue {
+public:
+	OSCParamQueue();
+	int init(int slots=OSC_PARAM_QUEUE_SLOTS); // not from audio thread, nor while receiving
+	bool push(int paramId, double value, uint64_t timeTag); // receive thread, false if full
+	bool pop(OSCParamEvent &event); // audio thread, false if empty
+	unsigned int getDroppedEvents(); // pushes that found the queue full
+
+protected:
+	SpscRing<OSCParamEvent> ring;
+	std::atomic<unsigned int> droppedEvents;
+};
+
+struct OSCRoute {
+	OSCParamQueue *target;
+	int paramId;
+	int argIndex;
+};
+
+// one part of registered addresses, with the routes that end here and the parts that can follow
+struct OSCRouteNode {
+	std::string segment;
+	std::vector<OSCRouteNode *> literals; // sorted by segment, for binary search
+	std::vector<OSCRouteNode *> patterns; // segments with wildcards, checked one by one
+	std::vector<OSCRoute> routes;
+
+	~OSCRouteNode();
+};
+
+//----------------------------------------------------------------------------------
+// Turns OSC messages into parameter events, on the receive thread of the OSCServer it is attached to
+// registered addresses are split at slashes into a trie, so a message is matched walking its address once, part by part
+// both registered addresses and received ones can use OSC wildcards [? * [] {}], but not in the same part
+// the argument of a route is decoded as a number [int, float, double, bool], messages with no arguments give 1, as triggers
+// messages that reach at least one queue are consumed, the others are queued by the OSCServer as usual [also those whose arguments no route could use]
+//----------------------------------------------------------------------------------
+class OSCDispatcher {
+public:
+	OSCDispatcher();
+	~OSCDispatcher();
+	int addRoute(std::string address, OSCParamQueue *target, int paramId, int argIndex=0); // not from audio thread, -1 if address is not valid
+	void clearRoutes();
+	int dispatch(const OSCMessageView &message); // receive thread, returns number of events pushed by matching routes
+
+protected:
+	OSCRouteNode root;
+	std::mutex routesMutex; // routes can be added while receiving
+
+	int matchNode(const OSCRouteNode *node, const char *path, const OSCMessageView &message);
+	int matchChild(const OSCRouteNode *child, const char *rest, const OSCMessageView &message);
+	int deliver(const OSCRouteNode *node, const OSCMessageView &message);
+
+	static bool hasWildcards(const char *segment);
+	static bool segmentMatch(const char *pattern, const char *segment);
+};
+
+inline bool OSCParamQueue::pop(OSCParamEvent &event) {
+	return ring.pop(event);
+}
+
+inline unsigned int OSCParamQueue::getDroppedEvents() {
+	return droppedEvents.load();
+}
+
+#endif /* OSCDISPATCHER_H_ */
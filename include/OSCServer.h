@@ -28,29 +28,83 @@
 #define __OSCServer_H_INCLUDED__
 
 #include "UdpServer.h"
+#include "NetworkIO.h"
 #include "oscpkt.hh"
-#include <queue>
+#include "LockFree.h"
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
 
-#define UDP_RECEIVE_TIMEOUT_MS 20
 #define UDP_RECEIVE_MAX_LENGTH 16384
+#define OSC_RECEIVE_SLOTS 256		// messages that can wait for the audio thread
+#define OSC_MESSAGE_MAX_BYTES 512	// larger messages are dropped
+#define OSC_MESSAGE_MAX_ARGS 32
+
+/**
+ * \brief OSCMessageView gives access to a received OSC message, in the slot where it was received
+ *
+ * Nothing is copied nor allocated when reading it, address and strings point into the slot
+ * and stay valid until the slot is given back to the OSCServer
+ *
+ * Getters of the wrong type return 0, getNumber() converts any numeric type
+ */
+class OSCMessageView{
+    public:
+        const char *getAddress() const;
+        bool match(const char *address) const; // exact match
+        const char *getTypeTags() const; // without leading comma
+        int getArgsNum() const;
+        char getArgType(int i) const;
+
+        int32_t getInt(int i) const;
+        int64_t getInt64(int i) const;
+        float getFloat(int i) const;
+        double getDouble(int i) const;
+        double getNumber(int i) const; // int, float, double and bools
+        bool getBool(int i) const;
+        const char *getString(int i) const;
+        const void *getBlob(int i, int &size) const;
+
+        uint64_t getTimeTag() const; // of enclosing bundle, 1 means immediately
+
+        /**
+		 * \brief Copies a message into this slot and checks it, off the audio thread
+		 *
+		 * \return false if message is malformed, has too many arguments or does not fit in OSC_MESSAGE_MAX_BYTES
+		 */
+        bool parse(const char *message, int size, uint64_t timeTag);
+
+    private:
+        char data[OSC_MESSAGE_MAX_BYTES];
+        int size;
+        int typeTagsOffset;
+        int argsNum;
+        int argOffsets[OSC_MESSAGE_MAX_ARGS];
+        uint64_t timeTag;
+};
+
+class OSCDispatcher;
 
 /**
  * \brief OSCServer provides functions for receiving OSC messages in Bela.
  *
- * When an OSC message is received, the message is decoded by the OSCServer off the audio
- * thread and placed in an internal queue. This queue can be polled from the audio thread
- * using messageWaiting(), and if messages are present they can be accessed with popMessage().
+ * When an OSC packet is received, its messages are checked by the OSCServer on the network
+ * thread shared by all servers [see NetworkIO] and copied into preallocated slots of a lock-free ring, bundles are unpacked.
+ * The ring can be polled from the audio thread using messageWaiting(), and if messages are
+ * present they can be accessed with popMessage(), which hands out a view of the slot.
+ * When the ring is full, messages are dropped and counted.
  *
- * Parsing the OSC messages is left to the user
+ * Reading the arguments is left to the user
  *
  * Care must be taken to use the correct methods while running on the audio thread to
  * prevent Xenomai mode switches and audio glitches.
  *
  * Uses oscpkt (http://gruntthepeon.free.fr/oscpkt/) underneath
  */
-class OSCServer{
+class OSCServer : public NetworkHandler{
     public:
         OSCServer();
+        ~OSCServer();
 
         /**
 		 * \brief Sets the port used to receive OSC messages
@@ -58,9 +112,11 @@ class OSCServer{
 		 * Must be called once during setup()
 		 *
 		 * @param port the port used to send OSC messages
+		 * @param prio the priority of the shared network thread, used only if it is not running yet
+		 * @param slots the number of messages that can be queued, rounded up to a power of 2
 		 *
 		 */
-        void setup(int port, /*VIC added*/int prio=10);
+        void setup(int port, /*VIC added*/int prio=10, int slots=OSC_RECEIVE_SLOTS);
 
         /**
 		 * \brief Returns true if an OSC message has been received and queued
@@ -74,18 +130,37 @@ class OSCServer{
         bool messageWaiting();
 
         /**
-		 * \brief Removes and returns the oldest message from the queue
+		 * \brief Removes the oldest message from the queue and returns a view of it
 		 *
 		 * This method is audio-thread safe, and can be used from render()
 		 *
-		 * This function returns the oldest queued OSC message in the form of an oscpkt
-		 * Message object, which must then be parsed. It also removes that message from
-		 * the queue.
+		 * It never allocates nor locks. The view stays valid until the next call
+		 * to popMessage() or messageWaiting(), then its slot is given back to the receive thread.
+		 *
+		 * \return the oldest message, or NULL if there are none
+		 *
+		 */
+        const OSCMessageView *popMessage();
+
+        /**
+		 * \brief Routes messages to module parameters on the receive thread
+		 *
+		 * Must be called during setup(), before messages are received
 		 *
-		 * \return oscpkt::Message an oscpkt Message object representing an OSC message
+		 * Messages that match a route of the dispatcher are turned into parameter events
+		 * and are not queued, the others can be popped as usual
+		 *
+		 * @param dispatcher the OSCDispatcher with the routes, NULL to queue all messages
+		 *
+		 */
+        void setDispatcher(OSCDispatcher *dispatcher);
+
+        /**
+		 * \brief Returns the number of messages that were dropped because the queue was full,
+		 * they were too big or malformed
 		 *
 		 */
-        oscpkt::Message popMessage();
+        unsigned int getDroppedMessages();
 
         /**
 		 * \brief Blocks execution until an OSC message is received
@@ -101,6 +176,12 @@ class OSCServer{
 		 */
         void receiveMessageNow(int timeout);
 
+        /**
+		 * \brief Parses a received packet, called by the network thread
+		 *
+		 */
+        void receivePacket(const char *data, int size);
+
         //VIC
         int verbose;
 
@@ -108,22 +189,107 @@ class OSCServer{
         int port;
         UdpServer socket;
 
-        //AuxiliaryTask OSCReceiveTask; //VIC commented out and replaced with pthread
-        pthread_t receiveThread;
-        //VIC
-        static int prioReceiveThread;
-        static bool shouldStop;
+        //AuxiliaryTask OSCReceiveTask; //VIC commented out and replaced with pthread, now shared NetworkIO thread
+        bool registered; // socket is watched by network thread
 
         //void createAuxTasks(); //VIC
-        void messageCheck();
+        void receive(int timeout);
+        void parsePacket(const char *packet, int size, uint64_t timeTag, int depth);
 
-        static void *checkMessages(void*);
-
-        int inBuffer[UDP_RECEIVE_MAX_LENGTH];
-        std::queue<oscpkt::Message> inQueue;
-        oscpkt::Message poppedMessage;
-        oscpkt::PacketReader pr;
+        char inBuffer[UDP_RECEIVE_MAX_LENGTH];
+        SpscRing<OSCMessageView> inRing;
+        OSCMessageView scratchMessage; // for dispatcher, when ring is full
+        OSCDispatcher *dispatcher;
+        bool messagePopped; // slot at read end of ring is still in use by audio thread
+        std::atomic<unsigned int> droppedMessages;
+        std::mutex receiveMutex; // network thread and receiveMessageNow() both fill the ring
 };
 
+inline const char *OSCMessageView::getAddress() const {
+    return data;
+}
+
+inline bool OSCMessageView::match(const char *address) const {
+    return strcmp(data, address) == 0;
+}
+
+inline const char *OSCMessageView::getTypeTags() const {
+    return data+typeTagsOffset+1;
+}
+
+inline int OSCMessageView::getArgsNum() const {
+    return argsNum;
+}
+
+inline char OSCMessageView::getArgType(int i) const {
+    return (i >= 0 && i < argsNum) ? data[typeTagsOffset+1+i] : 0;
+}
+
+inline int32_t OSCMessageView::getInt(int i) const {
+    return (getArgType(i) == 'i') ? oscpkt::bytes2pod<int32_t>(data+argOffsets[i]) : 0;
+}
+
+inline int64_t OSCMessageView::getInt64(int i) const {
+    return (getArgType(i) == 'h') ? oscpkt::bytes2pod<int64_t>(data+argOffsets[i]) : 0;
+}
+
+inline float OSCMessageView::getFloat(int i) const {
+    return (getArgType(i) == 'f') ? oscpkt::bytes2pod<float>(data+argOffsets[i]) : 0;
+}
+
+inline double OSCMessageView::getDouble(int i) const {
+    return (getArgType(i) == 'd') ? oscpkt::bytes2pod<double>(data+argOffsets[i]) : 0;
+}
+
+inline double OSCMessageView::getNumber(int i) const {
+    switch(getArgType(i)) {
+        case 'i': return getInt(i);
+        case 'h': return getInt64(i);
+        case 'f': return getFloat(i);
+        case 'd': return getDouble(i);
+        case 'T': return 1;
+        default: return 0;
+    }
+}
+
+inline bool OSCMessageView::getBool(int i) const {
+    return getArgType(i) == 'T';
+}
+
+inline const char *OSCMessageView::getString(int i) const {
+    char type = getArgType(i);
+    return (type == 's' || type == 'S') ? data+argOffsets[i] : NULL;
+}
+
+inline const void *OSCMessageView::getBlob(int i, int &size) const {
+    if(getArgType(i) != 'b') {
+        size = 0;
+        return NULL;
+    }
+    size = oscpkt::bytes2pod<int32_t>(data+argOffsets[i]);
+    return data+argOffsets[i]+4;
+}
+
+inline uint64_t OSCMessageView::getTimeTag() const {
+    return timeTag;
+}
+
+inline bool OSCServer::messageWaiting(){
+    if (messagePopped){
+        // done with the last view
+        inRing.pop();
+        messagePopped = false;
+    }
+    return inRing.getReadSlot() != NULL;
+}
+
+inline void OSCServer::setDispatcher(OSCDispatcher *dispatcher){
+    this->dispatcher = dispatcher;
+}
+
+inline unsigned int OSCServer::getDroppedMessages(){
+    return droppedMessages.load();
+}
+
 
 #endif
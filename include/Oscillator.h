@@ -8,6 +8,7 @@
 #define OSCILLATOR_H_
 
 #include "AudioModules.h"
+#include "Random.h"
 
 //----------------------------------------------------------------------------------
 // Second level child class [sibling of Waveform]
@@ -37,6 +38,8 @@ public:
 	void setPhase(double ph);
 	double getPhase();
 
+	void setSeed(uint64_t seed); // for reproducible noise
+
 	inline ~Oscillator() {};
 
 protected:
@@ -52,6 +55,8 @@ protected:
 
 	double _step;
 
+	Random _random; // own generator, so that noise oscillators are decorrelated and never share state
+
 	static constexpr double max_phase = 2. * M_PI;
 
 	double (Oscillator::*getSampleMethod)();
@@ -117,6 +122,10 @@ inline double Oscillator::getPhase() {
 	return _phase;
 }
 
+inline void Oscillator::setSeed(uint64_t seed) {
+	_random.setSeed(seed);
+}
+
 //----------------------------------------------------------------------------------------------------------------------------
 // private methods
 //----------------------------------------------------------------------------------------------------------------------------
@@ -181,9 +190,7 @@ inline double Oscillator::getSawToothSample() {
 inline double Oscillator::getWhiteNoiseSample() {
 	double retval;
 
-	retval = (double) rand()/ ((double)RAND_MAX);
-
-	retval = (retval*2)-1;
+	retval = _random.uniformBipolar();
 
 	retval = (retval+_half_shift)/_half_denom;
 
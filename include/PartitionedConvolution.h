@@ -0,0 +1,57 @@
+/*
+ * PartitionedConvolution.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: uniformly partitioned overlap-save convolution, with frequency domain delay line
+ *                as in F. Wefers, "Partitioned convolution algorithms for real-time auralization", 2015
+ */
+
+#ifndef PARTITIONEDCONVOLUTION_H_
+#define PARTITIONEDCONVOLUTION_H_
+
+#include "FFT.h"
+
+//----------------------------------------------------------------------------------
+// Single channel convolution engine, not a module
+// the impulse response is cut in partitions of blockSize samples, each transformed once at init with FFTs of 2*blockSize
+// every block the input spectrum enters the delay line and is multiplied with all partitions, then a single inverse FFT gives the output
+// latency is just the block, cost is one FFT pair per block plus a complex multiply-accumulate per partition
+//----------------------------------------------------------------------------------
+class PartitionedConvolution {
+public:
+	PartitionedConvolution();
+	~PartitionedConvolution();
+	int init(double *ir, int irLen, int blockSize, fft_planning planning=fft_plan_measure); // allocates and plans, not from audio thread
+	void process(double *in, double *out, int numOfSamples); // up to blockSize samples, shorter blocks are zero padded
+	void reset();
+
+	int getBlockSize();
+	int getPartitionsNum();
+
+protected:
+	int blockSize;
+	int binsNum;
+	int partitionsNum;
+
+	FFT fft; // 2*blockSize, in-place
+
+	// spectra stored as separate real and imaginary parts, so that the multiply-accumulate vectorizes
+	double *irRe, *irIm;   // [partition*binsNum + bin]
+	double *fdlRe, *fdlIm; // frequency domain delay line, same layout, circular on partitions
+	double *accRe, *accIm; // [bin]
+	int fdlPos;			   // partition slot that gets the newest input spectrum
+
+	double *inputWindow; // last 2*blockSize input samples
+
+	void deallocate();
+};
+
+inline int PartitionedConvolution::getBlockSize() {
+	return blockSize;
+}
+
+inline int PartitionedConvolution::getPartitionsNum() {
+	return partitionsNum;
+}
+
+#endif /* PARTITIONEDCONVOLUTION_H_ */
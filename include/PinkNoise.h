@@ -37,39 +37,63 @@
 
 
 #include <cstdlib>
-#include <ctime>
-#include <stdlib.h>
+#include "Random.h"
 
 #define PINK_NOISE_NUM_STAGES 3
+#define PINK_NOISE_CHUNK 64 // samples generated per block of random values, in tickBuffer()
 
 class PinkNoise {
 public:
-  PinkNoise() {
-  srand ( time(NULL) ); // initialize random generator
+  PinkNoise() { // generator is automatically seeded, each instance is decorrelated from the others
     clear();
   }
 
+  PinkNoise(uint64_t seed) : random(seed) {
+    clear();
+  }
+
+  void setSeed(uint64_t seed) {
+    random.setSeed(seed);
+  }
+
   void clear() {
     for( size_t i=0; i< PINK_NOISE_NUM_STAGES; i++ )
       state[ i ] = 0.0;
     }
 
   float tick() {
-    static const float RMI2 = 2.0 / float(RAND_MAX); // + 1.0; // change for range [0,1)
     static const float offset = A[0] + A[1] + A[2];
 
   // unrolled loop
-    float temp = float( rand() );
+    float temp = float( random.uniform() );
     state[0] = P[0] * (state[0] - temp) + temp;
-    temp = float( rand() );
+    temp = float( random.uniform() );
     state[1] = P[1] * (state[1] - temp) + temp;
-    temp = float( rand() );
+    temp = float( random.uniform() );
     state[2] = P[2] * (state[2] - temp) + temp;
-    return ( A[0]*state[0] + A[1]*state[1] + A[2]*state[2] )*RMI2 - offset;
+    return ( A[0]*state[0] + A[1]*state[1] + A[2]*state[2] )*2 - offset;
+  }
+
+  // same as calling tick() numOfSamples times, but random values are generated in blocks
+  void tickBuffer(double *buffer, int numOfSamples) {
+    static const float offset = A[0] + A[1] + A[2];
+    float temp[PINK_NOISE_NUM_STAGES*PINK_NOISE_CHUNK];
+
+    for(int start=0; start<numOfSamples; start+=PINK_NOISE_CHUNK) {
+      int len = (numOfSamples-start < PINK_NOISE_CHUNK) ? numOfSamples-start : PINK_NOISE_CHUNK;
+      random.fillUniform(temp, PINK_NOISE_NUM_STAGES*len, 0.0f, 1.0f);
+      for(int n=0; n<len; n++) {
+        state[0] = P[0] * (state[0] - temp[3*n]) + temp[3*n];
+        state[1] = P[1] * (state[1] - temp[3*n+1]) + temp[3*n+1];
+        state[2] = P[2] * (state[2] - temp[3*n+2]) + temp[3*n+2];
+        buffer[start+n] = ( A[0]*state[0] + A[1]*state[1] + A[2]*state[2] )*2 - offset;
+      }
+    }
   }
 
 protected:
   float state[ PINK_NOISE_NUM_STAGES ];
+  Random random;
   static const float A[ PINK_NOISE_NUM_STAGES ];
   static const float P[ PINK_NOISE_NUM_STAGES ];
 };
@@ -0,0 +1,116 @@
+/*
+ * Random.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: xoshiro256+ generator by David Blackman and Sebastiano Vigna [https://prng.di.unimi.it/, public domain]
+ *                seeded through splitmix64, from the same authors
+ */
+
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include <stdint.h>
+
+#define RANDOM_LANES 4 // independent streams advanced together, so that block fills can be vectorized
+
+//----------------------------------------------------------------------------------
+// Fast per-instance pseudo random generator, to be used in place of rand()
+// no global state and no locks, so it is safe to have one in each noise source and to call it from the audio thread
+// same seed -> same sequence, to get reproducible renders
+//----------------------------------------------------------------------------------
+class Random {
+public:
+	Random(); // automatically seeded, different for each instance
+	Random(uint64_t seed);
+	void setSeed(uint64_t seed);
+	uint64_t getSeed();
+
+	uint64_t next();
+	double uniform();        // [0, 1)
+	double uniformBipolar(); // [-1, 1)
+	double gaussian();		 // mean 0, standard deviation 1
+
+	// block versions, way faster than calling the single value methods in a loop
+	void fillUniform(double *buffer, int numOfSamples, double min=-1, double max=1);
+	void fillUniform(float *buffer, int numOfSamples, float min=-1, float max=1);
+	void fillGaussian(double *buffer, int numOfSamples, double mean=0, double stdDev=1);
+	void fillGaussian(float *buffer, int numOfSamples, float mean=0, float stdDev=1);
+
+protected:
+	uint64_t seed;
+	// xoshiro256+ state, stored as structure of arrays [one column per lane]
+	uint64_t s0[RANDOM_LANES];
+	uint64_t s1[RANDOM_LANES];
+	uint64_t s2[RANDOM_LANES];
+	uint64_t s3[RANDOM_LANES];
+	int lane; // lane used by next call to single value methods
+
+	double gaussSpare; // Box-Muller gives 2 values per run
+	bool hasGaussSpare;
+
+	void nextBlock(uint64_t *out); // advances all lanes at once, returns RANDOM_LANES values
+	static uint64_t splitmix64(uint64_t &x);
+	static uint64_t rotl(uint64_t x, int k);
+	static double toUnit(uint64_t x);
+};
+
+inline uint64_t Random::getSeed() {
+	return seed;
+}
+
+inline uint64_t Random::rotl(uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+// top 53 bits to double in [0, 1)
+inline double Random::toUnit(uint64_t x) {
+	return (x >> 11) * (1.0/9007199254740992.0);
+}
+
+inline uint64_t Random::splitmix64(uint64_t &x) {
+	uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// single lane step, lanes are used in turn
+inline uint64_t Random::next() {
+	int l = lane;
+	lane = (lane+1) & (RANDOM_LANES-1);
+
+	uint64_t result = s0[l] + s3[l];
+	uint64_t t = s1[l] << 17;
+	s2[l] ^= s0[l];
+	s3[l] ^= s1[l];
+	s1[l] ^= s2[l];
+	s0[l] ^= s3[l];
+	s2[l] ^= t;
+	s3[l] = rotl(s3[l], 45);
+
+	return result;
+}
+
+// all lanes in a single go, no dependencies between iterations
+inline void Random::nextBlock(uint64_t *out) {
+	for(int l=0; l<RANDOM_LANES; l++) {
+		out[l] = s0[l] + s3[l];
+		uint64_t t = s1[l] << 17;
+		s2[l] ^= s0[l];
+		s3[l] ^= s1[l];
+		s1[l] ^= s2[l];
+		s0[l] ^= s3[l];
+		s2[l] ^= t;
+		s3[l] = rotl(s3[l], 45);
+	}
+}
+
+inline double Random::uniform() {
+	return toUnit(next());
+}
+
+inline double Random::uniformBipolar() {
+	return 2*toUnit(next()) - 1;
+}
+
+#endif /* RANDOM_H_ */
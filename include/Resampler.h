@@ -0,0 +1,77 @@
+/*
+ * Resampler.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: polyphase windowed sinc sample rate converter [Kaiser window], as in J. O. Smith's "Digital Audio Resampling Home Page"
+ *                [https://ccrma.stanford.edu/~jos/resample/]
+ */
+
+#ifndef RESAMPLER_H_
+#define RESAMPLER_H_
+
+#include <stdint.h>
+
+enum resamplerQuality {resampler_fast_, resampler_medium_, resampler_best_};
+
+#define RESAMPLER_MAX_PHASES 1024		 // rational ratios that need more phases use an interpolated phase table
+#define RESAMPLER_ARBITRARY_PHASES 512
+#define RESAMPLER_MIN_SAMPLES_PER_THREAD (1<<17)
+
+//----------------------------------------------------------------------------------
+// Converts whole buffers from one sample rate to another, any pair of rates
+// each output sample is a dot product between the input and one of the precomputed phases of a low pass filter, there is no state
+// so large buffers are split among threads, each writing its own part of the output
+// when the reduced ratio outRate/inRate = L/M has few enough phases the conversion is exact, otherwise adjacent phases are interpolated
+//----------------------------------------------------------------------------------
+class Resampler {
+public:
+	Resampler();
+	~Resampler();
+	int init(int inRate, int outRate, resamplerQuality quality=resampler_medium_); // builds filter bank
+	int64_t getOutputLength(int64_t numOfSamples);
+	int64_t process(const double *in, int64_t numOfSamples, double *out, int numOfThreads=-1); // -1 picks number of cores, returns written samples
+
+	int getLatency(); // none, output is aligned with input [the filter is centered]
+	int getTapsNum();
+
+protected:
+	int inRate;
+	int outRate;
+	int interpFactor; // L
+	int decimFactor;  // M
+	bool exact;		  // rational polyphase, otherwise interpolated phases
+	int phasesNum;
+	int tapsNum;	  // per phase, multiple of 4
+	int halfTaps;	  // taps before center
+	double *bank;	  // [phase*tapsNum + tap], phasesNum+1 rows when not exact
+
+	void computeBank(double cutoff, double beta);
+	void processRange(const double *padded, int64_t first, int64_t last, double *out);
+	static double besselI0(double x);
+	static double dot(const double *x, const double *h, int n);
+};
+
+inline int Resampler::getLatency() {
+	return 0;
+}
+
+inline int Resampler::getTapsNum() {
+	return tapsNum;
+}
+
+// 4 independent accumulators, no dependency chain and easy to vectorize
+inline double Resampler::dot(const double *x, const double *h, int n) {
+	double acc0 = 0;
+	double acc1 = 0;
+	double acc2 = 0;
+	double acc3 = 0;
+	for(int i=0; i<n; i+=4) {
+		acc0 += x[i]*h[i];
+		acc1 += x[i+1]*h[i+1];
+		acc2 += x[i+2]*h[i+2];
+		acc3 += x[i+3]*h[i+3];
+	}
+	return (acc0+acc1) + (acc2+acc3);
+}
+
+#endif /* RESAMPLER_H_ */
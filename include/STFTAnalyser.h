@@ -0,0 +1,82 @@
+/*
+ * STFTAnalyser.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: streaming short time Fourier transform, frames published to other threads through a triple buffer
+ */
+
+#ifndef STFTANALYSER_H_
+#define STFTANALYSER_H_
+
+#include "AudioModules.h"
+#include "FFT.h"
+#include "LockFree.h"
+
+enum windowType {win_rect_, win_hann_, win_hamming_, win_blackman_};
+
+struct SpectrumFrame {
+	double *magnitude; // binsNum values, a sinusoid of amplitude A peaks at about A
+	double *phase;	   // binsNum values, radians
+	unsigned long index; // frames since init, one every hop
+};
+
+//----------------------------------------------------------------------------------
+// Windowed and overlapped FFT analysis, fftSize samples every hopSize samples
+// getFrameBuffer() analyses a single input channel and passes it through, tap() analyses any buffer [e.g., another module's frame buffer]
+// a GUI or OSC thread polls getLatestFrame(), audio thread never waits for it and frames that are not picked up in time are simply overwritten
+// all buffers are allocated in init(), nothing is allocated while running
+//----------------------------------------------------------------------------------
+class STFTAnalyser : public AudioModuleInOut {
+public:
+	STFTAnalyser();
+	~STFTAnalyser();
+	int init(unsigned int periodSize, int fftSize, int hopSize, windowType window=win_hann_, unsigned short inChannel=0, unsigned short outChannel=0);
+	double **getFrameBuffer(int numOfSamples, double **input);
+	void tap(double *samples, int numOfSamples);
+	void retrigger(); // clears history, audio thread only
+
+	// consumer side, one thread only
+	bool getLatestFrame(SpectrumFrame *&frame); // true if frame is new, frame stays valid until next call
+
+	int getFFTSize();
+	int getHopSize();
+	int getBinsNum();
+
+protected:
+	FFT fft;
+	int fftSize;
+	int hopSize;
+	int binsNum;
+	double *window;
+	double magnitudeNorm;
+
+	double *history; // circular, last fftSize samples
+	int historyPos;	 // oldest sample, next to be overwritten
+	int hopCounter;	 // samples since last frame
+	unsigned long frameCount;
+
+	TripleBuffer<SpectrumFrame> frames;
+
+	void computeFrame();
+	void deallocate();
+};
+
+inline bool STFTAnalyser::getLatestFrame(SpectrumFrame *&frame) {
+	bool fresh = frames.update();
+	frame = frames.getReadSlot();
+	return fresh;
+}
+
+inline int STFTAnalyser::getFFTSize() {
+	return fftSize;
+}
+
+inline int STFTAnalyser::getHopSize() {
+	return hopSize;
+}
+
+inline int STFTAnalyser::getBinsNum() {
+	return binsNum;
+}
+
+#endif /* STFTANALYSER_H_ */
@@ -0,0 +1,151 @@
+/*
+ * SVF.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: topology preserving transform state variable filter, as in Andrew Simper's "Linear Trapezoidal Integrated SVF"
+ *                [https://cytomic.com/files/dsp/SvfLinearTrapOptimised2.pdf]
+ */
+
+#ifndef SVF_H_
+#define SVF_H_
+
+#include <math.h> // M_PI
+
+enum {
+	svf_type_lowpass = 0,
+	svf_type_highpass,
+	svf_type_bandpass,
+	svf_type_notch,
+	svf_type_peak,
+	svf_type_allpass
+};
+
+#define SVF_TABLE_SIZE 4096 // cutoff->g lookup table, covers [0, SVF_MAX_FC]
+#define SVF_MAX_FC 0.49		// tan() goes to infinity at Nyquist
+
+//----------------------------------------------------------------------------------
+// Modulation friendly alternative to Biquad
+// same normalized cutoff [Fc/sampleRate] and Q as Biquad, but coefficients are cheap to recompute [no pow() nor sqrt(), approximated tan()]
+// and stay stable when changed on every sample, so this can follow envelopes and LFOs
+// setFc() and setQ() set targets, that process() reaches with a linear ramp across the block
+//----------------------------------------------------------------------------------
+class SVF {
+public:
+	SVF();
+	SVF(int type, double Fc, double Q);
+	void setType(int type);
+	void setFc(double Fc);
+	void setQ(double Q);
+	void setSVF(int type, double Fc, double Q); // jumps straight to values, no ramp
+	void useLookupTable(bool use);
+	void reset();
+
+	double process(double in);
+	void process(double *inout, int numOfSamples);
+	void process(double *inout, int numOfSamples, double *fcBuffer); // per sample cutoff, e.g., from an envelope
+
+	int getType();
+	double getFc();
+	double getQ();
+
+	static double fastTan(double x);
+
+protected:
+	int type;
+	double Fc, Q;
+	bool lookup;
+
+	double g, k; // current coefficients
+	double targetG, targetK;
+	double m0, m1, m2; // output mix of input, bandpass and lowpass, depends on type [and k]
+	double ic1eq, ic2eq; // states
+
+	double computeG(double Fc);
+	void computeMix();
+	double tick(double v0);
+
+	static const double *getTable();
+};
+
+inline int SVF::getType() {
+	return type;
+}
+
+inline double SVF::getFc() {
+	return Fc;
+}
+
+inline double SVF::getQ() {
+	return Q;
+}
+
+// [7/6] Pade approximant of tan(x), relative error below 1e-7 for x in [0, pi*SVF_MAX_FC]
+inline double SVF::fastTan(double x) {
+	double x2 = x*x;
+	return x*(135135 - x2*(17325 - x2*(378 - x2))) / (135135 - x2*(62370 - x2*(3150 - 28*x2)));
+}
+
+inline double SVF::computeG(double Fc) {
+	if(Fc < 0)
+		Fc = 0;
+	else if(Fc > SVF_MAX_FC)
+		Fc = SVF_MAX_FC;
+
+	if(!lookup)
+		return fastTan(M_PI*Fc);
+
+	const double *table = getTable();
+	double pos = Fc*(SVF_TABLE_SIZE-1)/SVF_MAX_FC;
+	int i = (int)pos;
+	double frac = pos-i;
+	return table[i] + frac*(table[i+1]-table[i]); // table has a guard point
+}
+
+inline void SVF::computeMix() {
+	switch(type) {
+		case svf_type_lowpass:
+			m0 = 0; m1 = 0; m2 = 1;
+			break;
+		case svf_type_highpass:
+			m0 = 1; m1 = -k; m2 = -1;
+			break;
+		case svf_type_bandpass:
+			m0 = 0; m1 = 1; m2 = 0;
+			break;
+		case svf_type_notch:
+			m0 = 1; m1 = -k; m2 = 0;
+			break;
+		case svf_type_peak:
+			m0 = 1; m1 = -k; m2 = -2;
+			break;
+		case svf_type_allpass:
+			m0 = 1; m1 = -2*k; m2 = 0;
+			break;
+	}
+}
+
+// one step with current g and k, only a division to get the coefficients
+inline double SVF::tick(double v0) {
+	double a1 = 1/(1 + g*(g + k));
+	double a2 = g*a1;
+	double a3 = g*a2;
+
+	double v3 = v0 - ic2eq;
+	double v1 = a1*ic1eq + a2*v3;
+	double v2 = ic2eq + a2*ic1eq + a3*v3;
+	ic1eq = 2*v1 - ic1eq;
+	ic2eq = 2*v2 - ic2eq;
+
+	return m0*v0 + m1*v1 + m2*v2;
+}
+
+inline double SVF::process(double in) {
+	g = targetG;
+	if(k != targetK) {
+		k = targetK;
+		computeMix();
+	}
+	return tick(in);
+}
+
+#endif /* SVF_H_ */
@@ -0,0 +1,117 @@
+/*
+ * SampleCache.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: process-wide cache of decoded audio files, shared by all the modules that play them
+ */
+
+#ifndef SAMPLECACHE_H_
+#define SAMPLECACHE_H_
+
+#include <string>
+#include <memory> // shared_ptr
+#include <cstddef> // size_t
+#include <stdint.h>
+#include <sys/mman.h> // munmap
+
+#define SAMPLE_CACHE_DEFAULT_CEILING ((size_t)256*1024*1024) // bytes
+#define SAMPLE_CACHE_FILE_EXT ".smp"
+#define SAMPLE_CACHE_FILE_VERSION 2
+#define SAMPLE_CACHE_DATA_OFFSET 128 // samples start here in cache files, after header
+
+//----------------------------------------------------------------------------------
+// A decoded, converted and resampled file, ready to be played
+// immutable once built: modules only read it, a module that needs to change it makes its own copy first
+// samples either live on the heap or are mapped read-only from the disk cache
+//----------------------------------------------------------------------------------
+struct SampleData {
+	double *samples; // frames+1, last one is silent
+	long frames;
+	int rate;		  // of samples, i.e., audio rate
+	int fileRate;	  // of original file
+	int fileChannels;
+	void *mapping;	  // whole cache file, if mapped
+	size_t mappingSize;
+
+	SampleData(double *samples, long frames, int rate, int fileRate, int fileChannels); // takes ownership of samples
+	SampleData(void *mapping, size_t mappingSize, size_t offset, long frames, int rate, int fileRate, int fileChannels); // takes ownership of mapping, samples start at offset
+	~SampleData();
+	size_t getBytes() const;
+};
+
+typedef std::shared_ptr<const SampleData> SamplePtr;
+
+//----------------------------------------------------------------------------------
+// Samples are keyed by path, channel selection and target rate, all methods are thread safe
+// each module holds a reference to the samples it plays, so evicting an entry never pulls data from under a playing voice
+// when cached data grows past the ceiling, least recently used entries that no module is holding anymore are dropped
+// samples mapped from the disk cache are backed by their file and not by the heap, so they are counted apart and not against the ceiling
+//
+// optionally, processed samples are also saved to a directory and mapped from there on later runs, skipping decode and conversion altogether
+// each cache file has a header with the source file's size and modification time, so edited sources are processed again
+//----------------------------------------------------------------------------------
+class SampleCache {
+public:
+	static SamplePtr find(std::string path, int chnIndex, int rate); // empty if not cached
+	static SamplePtr insert(std::string path, int chnIndex, int rate, SamplePtr data); // returns the cached one, in case someone else got there first
+	static void setMemoryCeiling(size_t bytes); // 0 means no limit, default is SAMPLE_CACHE_DEFAULT_CEILING
+	static size_t getMemoryUsage(); // heap only
+	static size_t getMappedBytes(); // samples mapped from disk cache
+	static int getEntriesNum();
+	static void clear(); // drops all entries, data that is still in use lives on in modules
+
+	// disk cache, off until a directory is set
+	static int setDiskDirectory(std::string dir); // created if needed, empty string turns disk cache off
+	static SamplePtr findOnDisk(std::string path, int chnIndex, int rate, int variant); // variant tells apart different processing of same file [e.g., resampler quality]
+	static int storeOnDisk(std::string path, int chnIndex, int rate, int variant, SamplePtr data);
+	static void setLockMapped(bool lock); // files mapped from now on are read in and locked in RAM, for sets that must never page fault on audio thread [off by default]
+};
+
+// layout of cache files, followed by frames+1 samples
+struct SampleFileHeader {
+	char magic[4];		// "SMPC"
+	uint32_t version;
+	uint32_t sampleSize; // sizeof(double), files are only read on machines like the one that wrote them
+	int32_t chnIndex;
+	int32_t rate;
+	int32_t variant;
+	int32_t fileRate;
+	int32_t fileChannels;
+	uint64_t sourceHash; // of path
+	int64_t sourceSize;
+	int64_t sourceMtime; // nanoseconds
+	int64_t frames;
+};
+
+inline SampleData::SampleData(double *samples, long frames, int rate, int fileRate, int fileChannels) {
+	this->samples = samples;
+	this->frames = frames;
+	this->rate = rate;
+	this->fileRate = fileRate;
+	this->fileChannels = fileChannels;
+	mapping = NULL;
+	mappingSize = 0;
+}
+
+inline SampleData::SampleData(void *mapping, size_t mappingSize, size_t offset, long frames, int rate, int fileRate, int fileChannels) {
+	this->samples = (double *)((char *)mapping + offset);
+	this->frames = frames;
+	this->rate = rate;
+	this->fileRate = fileRate;
+	this->fileChannels = fileChannels;
+	this->mapping = mapping;
+	this->mappingSize = mappingSize;
+}
+
+inline SampleData::~SampleData() {
+	if(mapping != NULL)
+		munmap(mapping, mappingSize);
+	else if(samples != NULL)
+		delete[] samples;
+}
+
+inline size_t SampleData::getBytes() const {
+	return (frames+1)*sizeof(double);
+}
+
+#endif /* SAMPLECACHE_H_ */
@@ -0,0 +1,37 @@
+/*
+ * SampleLoader.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: loads audio files in the background, on a pool of threads
+ */
+
+#ifndef SAMPLELOADER_H_
+#define SAMPLELOADER_H_
+
+#include "SampleCache.h"
+
+#include <string>
+#include <vector>
+#include <future>
+#include <functional>
+
+typedef std::function<void(SamplePtr)> SampleCallback; // runs on a loader thread, data is empty if file could not be loaded
+
+//----------------------------------------------------------------------------------
+// Decodes, converts and resamples files in parallel, exactly as AudioFile::init() does, and puts them in the SampleCache
+// files are handed out as futures and/or through callbacks, so that the engine can start right away with placeholders [see AudioFile::initAsync()]
+// the pool is started with the first request, one thread per core unless set otherwise, and it is not meant to be used from the audio thread
+// it runs until shutdown() [e.g., in cleanup()], its state is never destroyed so workers that are still busy at exit are harmless
+//----------------------------------------------------------------------------------
+class SampleLoader {
+public:
+	static std::shared_future<SamplePtr> load(std::string path, int rate, int chnIndex=-1, SampleCallback callback=SampleCallback());
+	static std::vector<std::shared_future<SamplePtr>> load(const std::vector<std::string> &paths, int rate, std::function<void()> onComplete=std::function<void()>(), int chnIndex=-1); // onComplete runs once after whole batch
+	static void waitAll(); // until every file submitted so far is done
+	static int getPendingNum();
+	static void setThreadsNum(int numOfThreads); // before first load, -1 picks number of cores
+	static void shutdown(); // drops queued files [their futures report a broken promise], waits for the ones being loaded and stops workers, next load starts them again
+	static bool isLoaderThread(); // true on workers, which already run in parallel
+};
+
+#endif /* SAMPLELOADER_H_ */
@@ -0,0 +1,159 @@
+/*
+ * StreamingAudioFile.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: audio file player that streams from disk, only the head of the file and a read-ahead window are kept in memory
+ */
+
+#ifndef STREAMINGAUDIOFILE_H_
+#define STREAMINGAUDIOFILE_H_
+
+#include "AudioModules.h"
+#include "Waveforms.h" // advanceType
+#include "LockFree.h"
+
+#include <string>
+#include <atomic>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define STREAM_CHUNK_FRAMES 4096
+#define STREAM_DEFAULT_HEAD 1.0		  // seconds preloaded at init
+#define STREAM_DEFAULT_READ_AHEAD 2.0 // seconds queued ahead of the playhead
+
+// transport commands, applied by the audio thread at next period [frames, to retrigger, are >= 0]
+#define STREAM_CMD_NONE -1
+#define STREAM_CMD_RESUME -2
+#define STREAM_CMD_STOP -3
+
+// frames in playback order, i.e., already reversed when playing backwards
+struct StreamChunk {
+	float *samples;
+	int len;
+	long frame;		 // file frame of first sample
+	char direction;	 // 1 forward, -1 backwards
+	bool last;		 // one shot playback ends with this chunk
+	unsigned int serial; // playback request this chunk belongs to
+};
+
+// where the reader has to start from, sent by the audio thread on retrigger
+struct StreamRequest {
+	long frame;
+	char direction;
+	unsigned int serial;
+};
+
+//----------------------------------------------------------------------------------
+// Plays files of any length with a fixed memory footprint, a single channel or the average of all channels, like AudioFile
+// a reader thread walks the same path as the playhead [direction, loop points, advance type] and queues chunks in a lock-free ring
+// so the audio thread simply consumes them in order and never touches the disk
+// retriggering inside the preloaded head starts instantly, anywhere else there is silence until the reader catches up [counted as underruns]
+// loop points and advance type are picked up by the reader, so they take effect after the queued read-ahead
+// transport [retrigger, stop, resume] can be called from any thread, only the latest call is applied at next period
+//----------------------------------------------------------------------------------
+class StreamingAudioFile : public AudioModuleOut, public MultichannelOutUtils {
+public:
+	StreamingAudioFile();
+	StreamingAudioFile(advanceType adv);
+	~StreamingAudioFile();
+	int init(std::string filename, int rate, unsigned int periodSize, double level=1, int chnIndex=-1, unsigned short outChannels=1, unsigned short outChnOffset=0,
+			 double headSeconds=STREAM_DEFAULT_HEAD, double readAheadSeconds=STREAM_DEFAULT_READ_AHEAD); // opens file and starts reader, not from audio thread
+	double **getFrameBuffer(int numOfSamples);
+	void retrigger(); // any thread, like stop() and resume()
+	void retrigger(unsigned long frameN);
+	void stop();
+	void resume(); // from where it stopped
+	void setAdvanceType(advanceType adv);
+	void setLoopPoints(unsigned long start, unsigned long end); // end excluded, 0 means end of file
+
+	long getFramesNum();
+	int getCurrentFramePos();
+	unsigned int getUnderruns(); // periods that were not filled in time
+
+	static void setReaderPriority(int prio);
+
+protected:
+	SNDFILE *sndfile;
+	SF_INFO sfinfo;
+	int chnIndex;
+	long frameNum;
+	bool isPlaying;
+	std::atomic<long> pendingCommand; // latest transport call, see STREAM_CMD_
+
+	// preloaded head, played straight from memory
+	double *head;
+	long headFrames;
+	bool inHead;
+
+	// audio thread state
+	long currentFrame;
+	char direction;
+	unsigned int serial;
+	StreamChunk *chunk; // being played, NULL if none
+	int chunkPos;
+
+	SpscRing<StreamChunk> ring;
+	float *chunkMemory;
+
+	// shared with reader
+	std::atomic<int> advType;
+	std::atomic<long> loopStart;
+	std::atomic<long> loopEnd;
+	TripleBuffer<StreamRequest> requests; // only latest one matters
+	std::atomic<unsigned int> underruns;
+	std::atomic<bool> stopReader;
+
+	// reader thread state
+	float *readBuffer; // interleaved, all file channels
+	long readerFrame;
+	char readerDirection;
+	unsigned int readerSerial;
+	bool readerDone;
+	long filePos;
+
+	pthread_t readerThread;
+	sem_t readerSem;
+	bool readerStarted;
+	static int prioReader;
+
+	void applyCommand(long command);
+	void request(long frame, char dir);
+	void readChunk(StreamChunk *out);
+	int readFrames(long start, int len, float *out);
+	void closeFile();
+	static void *readerLoop(void *arg);
+};
+
+inline void StreamingAudioFile::retrigger() {
+	retrigger(0);
+}
+
+inline void StreamingAudioFile::stop() {
+	pendingCommand = STREAM_CMD_STOP;
+}
+
+inline void StreamingAudioFile::resume() {
+	pendingCommand = STREAM_CMD_RESUME;
+}
+
+inline void StreamingAudioFile::setAdvanceType(advanceType adv) {
+	advType = adv;
+}
+
+inline long StreamingAudioFile::getFramesNum() {
+	return frameNum;
+}
+
+inline int StreamingAudioFile::getCurrentFramePos() {
+	return currentFrame;
+}
+
+inline unsigned int StreamingAudioFile::getUnderruns() {
+	return underruns.load();
+}
+
+inline void StreamingAudioFile::setReaderPriority(int prio) {
+	prioReader = prio;
+}
+
+#endif /* STREAMINGAUDIOFILE_H_ */
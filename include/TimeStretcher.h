@@ -0,0 +1,194 @@
+/*
+ * TimeStretcher.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Comments: phase vocoder over shared samples, speed and pitch can be changed independently while playing
+ */
+
+#ifndef TIMESTRETCHER_H_
+#define TIMESTRETCHER_H_
+
+#include "AudioModules.h"
+#include "SampleCache.h"
+#include "Waveforms.h" // advanceType
+#include "FFT.h"
+#include "LockFree.h"
+
+#include <string>
+#include <atomic>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define TIMESTRETCH_DEFAULT_FFT 2048
+#define TIMESTRETCH_OVERLAP 4				 // hop is fft size divided by this
+#define TIMESTRETCH_BLOCK 256				 // samples per block queued by the worker
+#define TIMESTRETCH_DEFAULT_AHEAD 0.1		 // seconds the worker computes ahead of the playhead
+#define TIMESTRETCH_MIN_PITCH 0.25
+#define TIMESTRETCH_MAX_PITCH 4.0			 // bounds resampling cost, at most this many frames are synthesized per hop of output
+
+// transport commands, applied by the audio thread at next period [frames, to retrigger, are >= 0]
+#define TIMESTRETCH_CMD_NONE -1
+#define TIMESTRETCH_CMD_RESUME -2
+#define TIMESTRETCH_CMD_STOP -3
+
+// output of the worker, in playback order
+struct StretchBlock {
+	double *samples;
+	bool last;			 // one shot playback ends with this block
+	unsigned int serial; // playback request this block belongs to
+};
+
+// where the worker has to start from, sent by the audio thread on retrigger
+struct StretchRequest {
+	long frame;
+	unsigned int serial;
+};
+
+//----------------------------------------------------------------------------------
+// Plays samples at any speed without changing pitch, or at any pitch without changing speed, a single channel or the average of all channels, like AudioFile
+// the whole file is analysed at init, magnitude and phase of every frame are kept, so playback only synthesizes [one inverse fft per hop]
+// the playhead moves across analysis frames at the chosen speed, phases are advanced with the frequency measured between neighbouring frames
+// pitch is changed by resampling the synthesized stream, which is produced faster or slower to keep the speed
+// speed and pitch can be set from any thread, and so can transport [retrigger, stop, resume], only the latest call is applied at next period
+// with the worker, synthesis runs ahead on its own thread and the audio thread only copies queued blocks, so its cost does not depend on speed, pitch or fft size
+// then settings and retriggers take effect after the queued blocks [TIMESTRETCH_DEFAULT_AHEAD by default]
+// only loop and one shot advance types are supported, loop points are the whole samples
+//----------------------------------------------------------------------------------
+class TimeStretcher : public AudioModuleOut, public MultichannelOutUtils {
+public:
+	TimeStretcher();
+	TimeStretcher(advanceType adv);
+	~TimeStretcher();
+	int init(SamplePtr data, unsigned int periodSize, double level=1, unsigned short outChannels=1, unsigned short outChnOffset=0,
+			 int fftSize=TIMESTRETCH_DEFAULT_FFT, bool useWorker=false, double aheadSeconds=TIMESTRETCH_DEFAULT_AHEAD); // not from audio thread
+	int init(std::string filename, int rate, unsigned int periodSize, double level=1, int chnIndex=-1, unsigned short outChannels=1, unsigned short outChnOffset=0,
+			 int fftSize=TIMESTRETCH_DEFAULT_FFT, bool useWorker=false, double aheadSeconds=TIMESTRETCH_DEFAULT_AHEAD);
+	double **getFrameBuffer(int numOfSamples);
+	void retrigger(); // any thread, like stop() and resume()
+	void retrigger(unsigned long frameN);
+	void stop();
+	void resume(); // from where it stopped
+	void setAdvanceType(advanceType adv);
+
+	void setSpeed(double ratio); // 1 is original tempo, 0.5 half, 0 freezes on current frame
+	void setPitch(double ratio); // 1 is original pitch, 2 one octave up
+	double getSpeed();
+	double getPitch();
+
+	long getFramesNum();
+	unsigned int getUnderruns(); // periods that were not filled in time by the worker
+
+	static void setWorkerPriority(int prio);
+
+protected:
+	SamplePtr data;
+	std::atomic<int> advType;
+	bool isPlaying;
+	std::atomic<long> pendingCommand; // latest transport call, see TIMESTRETCH_CMD_
+	std::atomic<double> speed;
+	std::atomic<double> pitch;
+
+	// analysis, computed at init
+	int fftSize;
+	int hop;
+	int binsNum;
+	long analysisFrames; // TIMESTRETCH_OVERLAP-1 lead-in frames, then one per hop of samples
+	float *magnitudes; // analysisFrames*binsNum
+	float *phases;
+	double *window;
+	double olaGain; // makes up for window overlap
+
+	// synthesis, owned by the worker if there is one, otherwise by the audio thread
+	FFT fft;
+	double playhead;   // in analysis frames
+	double *phaseAcc;  // per bin
+	double *ola;	   // overlap-add accumulator, fftSize samples
+	double *stream;	   // synthesized samples, before pitch resampling
+	int streamLen;
+	double readPos;	   // fractional index in stream
+	bool ending;	   // one shot playback synthesized last frame
+	bool finished;	   // and all of it has been played
+
+	// worker
+	bool useWorker;
+	SpscRing<StretchBlock> ring;
+	double *blockMemory;
+	StretchBlock *block; // being played by audio thread, NULL if none
+	int blockPos;
+	unsigned int serial;
+	TripleBuffer<StretchRequest> requests; // only latest one matters
+	unsigned int workerSerial;
+	std::atomic<unsigned int> underruns;
+	std::atomic<bool> stopWorker;
+	pthread_t workerThread;
+	sem_t workerSem;
+	bool workerStarted;
+	static int prioWorker;
+
+	void analyse();
+	void reset(long frame);
+	void render(double *out, int numOfSamples);
+	void synthesizeHop();
+	void applyCommand(long command);
+	void request(long frame);
+	void deallocate();
+	static void *workerLoop(void *arg);
+};
+
+inline void TimeStretcher::retrigger() {
+	retrigger(0);
+}
+
+inline void TimeStretcher::stop() {
+	pendingCommand = TIMESTRETCH_CMD_STOP;
+}
+
+inline void TimeStretcher::resume() {
+	pendingCommand = TIMESTRETCH_CMD_RESUME;
+}
+
+inline void TimeStretcher::setAdvanceType(advanceType adv) {
+	if(adv == adv_backAndForth_) {
+		printf("TimeStretcher error! Back and forth playback is not supported\n");
+		return;
+	}
+	advType = adv;
+}
+
+inline void TimeStretcher::setSpeed(double ratio) {
+	if(ratio < 0) {
+		printf("TimeStretcher error! Speed can't be negative, %f was passed\n", ratio);
+		return;
+	}
+	speed = ratio;
+}
+
+inline void TimeStretcher::setPitch(double ratio) {
+	if(ratio < TIMESTRETCH_MIN_PITCH || ratio > TIMESTRETCH_MAX_PITCH) {
+		printf("TimeStretcher error! Pitch ratio must be between %.2f and %.2f, %f was passed\n", TIMESTRETCH_MIN_PITCH, TIMESTRETCH_MAX_PITCH, ratio);
+		return;
+	}
+	pitch = ratio;
+}
+
+inline double TimeStretcher::getSpeed() {
+	return speed.load();
+}
+
+inline double TimeStretcher::getPitch() {
+	return pitch.load();
+}
+
+inline long TimeStretcher::getFramesNum() {
+	return (data != NULL) ? data->frames : 0;
+}
+
+inline unsigned int TimeStretcher::getUnderruns() {
+	return underruns.load();
+}
+
+inline void TimeStretcher::setWorkerPriority(int prio) {
+	prioWorker = prio;
+}
+
+#endif /* TIMESTRETCHER_H_ */
@@ -57,6 +57,7 @@ class UdpServer{
 		bool init(int aPort);
 		bool bindToPort(int aPort);
 		int getBoundPort() const;
+		int getSocket() const;
 		/*
 		 * Reads bytes from the socket.
 		 *
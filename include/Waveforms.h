@@ -8,18 +8,34 @@
 #define WAVEFORMS_H_
 
 #include "AudioModules.h"
+#include "Resampler.h"
+#include "SampleCache.h"
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 enum advanceType {adv_oneShot_, adv_loop_, adv_backAndForth_};
 
+enum interpType {interp_no_, interp_lin_, interp_cubic_, interp_hermite_};
+
+#define WAVETABLE_FRAC_BITS 32 // phase and playhead are fixed point 32.32, integer part is the frame, fractional part drives interpolation
+#define WAVETABLE_FRAC_MASK 0xFFFFFFFFLL
+#define WAVETABLE_FRAC_SCALE (1.0/4294967296.0)
+
 //----------------------------------------------------------------------------------
 // Second level child classes, these can be instantiated, used on their own in the engine or as components of a Generator
+// Waveform can play at any rate, the playhead then has a fractional part and samples are interpolated
+// at rate 1 and on a whole frame it goes back to copying blocks of samples
 //----------------------------------------------------------------------------------
 class Waveform : public AudioModuleOut, public MultichannelOutUtils {
 public:
 	Waveform();
 	Waveform(advanceType adv);
 	virtual void init(double *samples, int len, unsigned int periodSize, double level=1, unsigned short outChannels=1, unsigned short outChnOffset=0);
+	virtual void init(SamplePtr data, unsigned int periodSize, double level=1, unsigned short outChannels=1, unsigned short outChnOffset=0); // plays shared samples, no copy
 	virtual void reverse();
+	virtual int swapData(SamplePtr data); // not from audio thread, new samples are picked up at next period, -1 if previous swap is still pending
 	virtual void setAdvanceType(advanceType adv);
 	virtual void stop();
 	virtual void resume();
@@ -32,26 +48,45 @@ public:
 	virtual int getWaveform(double *&buff);
 	virtual int getWaveformLen();
 	virtual int getCurrentFramePos();
+	virtual void setRate(double rate); // 1 is original speed, 2 an octave up, must be positive
+	double getRate();
+	virtual void setInterpolation(interpType interp); // used when playhead is between frames
 	~Waveform();
 protected:
 	double *waveFormBuffer; // contains the whole waveform, different from samplebuffer that contains only period
+	SamplePtr sharedData;	// if set, waveFormBuffer points to its samples and must not be changed nor deleted
+	SamplePtr pendingData;	// handed over to audio thread by swapData(), then keeps previous samples until next swap [so they are not freed on audio thread]
+	std::atomic<bool> swapPending;
 	advanceType advType;
 	char direction; // 1 forward, -1 backwards. 0 NULL
 	long unsigned currentFrame;
 	long unsigned frameNum;
 	long unsigned lastFrame;
 	bool isPlaying;
+	double playbackRate;
+	int64_t rateInc;	 // fixed point step of playhead
+	uint32_t frameFrac; // fixed point fractional part of playhead, currentFrame is the integer part
+	interpType interpolation;
 
 	virtual void setAdvanceSampleMethod();
 	void (Waveform::*advanceSample)();
 	virtual void advanceSampleOneShot();
 	virtual void advanceSampleLoop();
 	virtual void advanceSampleBackAndForth();
+	virtual void adoptPendingData();
 
 	double *(Waveform::*getBufferMethod)(int numOfSamples);
 	double *getBufferOneShot(int numOfSamples);
 	double *getBufferLoop(int numOfSamples);
 	double *getBufferBackAndForth(int numOfSamples);
+
+	template<int interp>
+	static double interpolate(const double *table, int64_t pos);
+	double getFrameOutside(long i); // any index, wrapped, mirrored or silent according to advance type
+	void renderVarispeed(double *out, int numOfSamples);
+	template<int interp>
+	void renderVarispeedBlock(double *out, int numOfSamples);
+	void wrapPlayhead(int64_t &pos);
 };
 
 inline void Waveform::setAdvanceType(advanceType adv) {
@@ -74,6 +109,7 @@ inline void Waveform::retrigger() {
 
 inline void Waveform::retrigger(unsigned long frameN/*, char dir*/) {
 	currentFrame = frameN;
+	frameFrac = 0;
 	//direction     = dir; //VIC not useful and over-complicated to handle in getBuffer...()
 	isPlaying = true; // just in case
 }
@@ -82,6 +118,23 @@ inline int Waveform::getCurrentFramePos() {
 	return currentFrame;
 }
 
+inline void Waveform::setRate(double rate) {
+	if(rate <= 0) {
+		printf("Waveform error! Playback rate must be positive, %f was passed\n", rate);
+		return;
+	}
+	playbackRate = rate;
+	rateInc = (int64_t)llround(rate*(1LL<<WAVETABLE_FRAC_BITS));
+}
+
+inline double Waveform::getRate() {
+	return playbackRate;
+}
+
+inline void Waveform::setInterpolation(interpType interp) {
+	interpolation = interp;
+}
+
 inline double *Waveform::getWaveform() {
 	return waveFormBuffer;
 }
@@ -96,7 +149,7 @@ inline int Waveform::getWaveformLen() {
 }
 
 inline Waveform::~Waveform(){
-	if(waveFormBuffer!=NULL)
+	if(waveFormBuffer!=NULL && sharedData==NULL)
 		delete[] waveFormBuffer;
 }
 
@@ -127,6 +180,40 @@ inline void Waveform::advanceSampleBackAndForth() {
 		}
 	}
 }
+
+template<int interp>
+inline double Waveform::interpolate(const double *table, int64_t pos) {
+	int i = (int)(pos>>WAVETABLE_FRAC_BITS);
+	double frac = (pos & WAVETABLE_FRAC_MASK)*WAVETABLE_FRAC_SCALE;
+
+	if(interp == interp_lin_) {
+		double a = table[i];
+		return a + frac*(table[i+1]-a);
+	}
+	else if(interp == interp_cubic_) {
+		// taken from the source code of awesome Pure Data!
+		// https://sourceforge.net/p/pure-data/pure-data/ci/master/tree/src/d_array.c#l593
+		double a = table[i-1];
+		double b = table[i];
+		double c = table[i+1];
+		double d = table[i+2];
+		double cminusb = c-b;
+		return b + frac * ( cminusb - 0.1666667f * (1.-frac) * ( (d - a - 3.0f * cminusb) * frac + (d + 2.0f*a - 3.0f*b) ) );
+	}
+	else if(interp == interp_hermite_) {
+		// 4-point, 3rd-order Hermite [x-form], from Olli Niemitalo's "Polynomial Interpolators for High-Quality Resampling of Oversampled Audio"
+		double a = table[i-1];
+		double b = table[i];
+		double c = table[i+1];
+		double d = table[i+2];
+		double c0 = b;
+		double c1 = 0.5*(c-a);
+		double c2 = a - 2.5*b + 2*c - 0.5*d;
+		double c3 = 0.5*(d-a) + 1.5*(b-c);
+		return ((c3*frac + c2)*frac + c1)*frac + c0;
+	}
+	return table[i];
+}
 //----------------------------------------------------------------------------------
 
 
@@ -137,35 +224,77 @@ inline void Waveform::advanceSampleBackAndForth() {
 //----------------------------------------------------------------------------------
 // Third level child class
 //----------------------------------------------------------------------------------
+class AudioFile;
+
+// lets a loader thread reach an AudioFile only as long as it exists
+struct AsyncLoadTarget {
+	std::mutex mtx;
+	AudioFile *file;
+};
+
 class AudioFile : public Waveform {
 public:
 	AudioFile();
 	AudioFile(advanceType adv);
+	~AudioFile();
 	int init(std::string filename, int rate, unsigned int periodSize, double level=1, int chnIndex=-1, unsigned short outChannels=1, unsigned short outChnOffset=0);
+	int initAsync(std::string filename, int rate, unsigned int periodSize, double level=1, int chnIndex=-1, unsigned short outChannels=1, unsigned short outChnOffset=0); // silent until loaded by SampleLoader, then plays
+	bool isLoaded();
+	int getFileChannelsNum(); // once loaded
+	static int loadSamples(std::string filename, int rate, int chnIndex, SamplePtr &data); // from cache, or decoded and cached, thread safe
+	static int loadChannels(std::string filename, int rate, std::vector<SamplePtr> &channels); // same, but all channels and file decoded once
+	static void setResamplerQuality(resamplerQuality quality); // used by all files loaded afterwards
+	static void setResamplerThreads(int numOfThreads); // -1 picks number of cores, files loaded by SampleLoader always use 1
 
 protected:
 	void init(double *samples, int len, unsigned int periodSize, double level=1, unsigned short outChannels=1, unsigned short outChnOffset=0);
+	void init(SamplePtr data, unsigned int periodSize, double level=1, unsigned short outChannels=1, unsigned short outChnOffset=0);
+	int readFile(std::string filename, int chnIndex, double *&frameBuff, int &numOfFrames);
+	int decode(std::string filename, int rate, int chnIndex, SamplePtr &data);
+	int decodeChannels(std::string filename, int rate, std::vector<SamplePtr> &channels);
+	int convert(double *fileBuff, int numOfSamples, std::string filename, int rate, SamplePtr &data);
+	void detachAsyncLoad();
 	int resample(double buff[], int numOfSamples, std::string filename, double *& interpBuff);
-	int upsample(double buff[], int numOfSamples, int mul, double *& interpBuff);
-	int decimate(double buff[], int numOfSamples, int fact, double *& interpBuff);
-	void computeLowPass(double cuttFreq, double *a, double *b);
 	SNDFILE *sndfile;
 	SF_INFO sfinfo;
 	int samplerate;
+
+	std::shared_ptr<AsyncLoadTarget> asyncTarget;
+
+	static resamplerQuality quality;
+	static int resamplerThreads;
 };
 
 inline void AudioFile::init(double *samples, int len, unsigned int periodSize, double level, unsigned short outChannels, unsigned short outChnOffset) {
 	Waveform::init(samples, len, periodSize, level, outChannels, outChnOffset);
 }
-//----------------------------------------------------------------------------------
 
+inline void AudioFile::init(SamplePtr data, unsigned int periodSize, double level, unsigned short outChannels, unsigned short outChnOffset) {
+	Waveform::init(data, periodSize, level, outChannels, outChnOffset);
+}
+
+inline bool AudioFile::isLoaded() {
+	return waveFormBuffer!=NULL && !swapPending.load();
+}
+
+inline int AudioFile::getFileChannelsNum() {
+	return sfinfo.channels;
+}
+
+inline void AudioFile::setResamplerQuality(resamplerQuality quality) {
+	AudioFile::quality = quality;
+}
+
+inline void AudioFile::setResamplerThreads(int numOfThreads) {
+	resamplerThreads = numOfThreads;
+}
+//----------------------------------------------------------------------------------
 
 
 
 
 
 
-enum interpType {interp_no_, interp_lin_, interp_cubic_};
 
 //----------------------------------------------------------------------------------
 // further offspring, child of AudioFile
@@ -176,32 +305,50 @@ public:
 	Wavetable(interpType interp);
 	void init(double *samples, int len, unsigned int rate, unsigned int periodSize, double level=1, unsigned short outChannels=1, unsigned short outChnOffset=0);
 	int init(std::string filename, unsigned int rate, unsigned int periodSize, double level=1, int chnIndex=-1, unsigned short outChannels=1, unsigned short outChnOffset=0);
-	void setFrequency(double freq);
+	virtual void setFrequency(double freq);
 	double getFrequency();
+	int swapData(SamplePtr data); // not from audio thread, guarded table is built here and picked up with its phase at next period
 	double getSample();
 	double **getFrameBuffer(int numOfSamples);
 	double *getWaveform();
 	int getWaveform(double *&buff);
 	int getCurrentFramePos();
 	int getWaveformLen();
+	void setRate(double rate);
+	void setInterpolation(interpType interp);
 
 protected:
-	interpType interpolation;
-	double currentPos;
+	int64_t phase;	   // fixed point position in table
+	int64_t phaseInc;  // fixed point step
+	int64_t phaseLen;  // fixed point length of wave
+	int64_t phaseMask; // if wave length is a power of 2 wrapping is a mask, otherwise -1
 	double step;
+	double frequency; // as set, step is computed again when a new table is picked up
 	int waveFrameNum; // actual length of wave passed [as opposed to table's num of frames]
+	int tableOffset;  // num of guard frames before first actual frame of wave
 
 	void init(double *samples, int len, unsigned int periodSize, double level=1, unsigned short outChannels=1, unsigned short outChnOffset=0);
+	void init(SamplePtr data, unsigned int periodSize, double level=1, unsigned short outChannels=1, unsigned short outChnOffset=0); // copies, table has guard frames
 
 	//double *getBuffer(int numOfSamples);
 
+	int getGuardFramesNum();
+	int getGuardFramesBefore();
+	void fillGuardedTable(double *samples, int len, double *table);
+
 	void setAdvanceSampleMethod();
 	void advanceSampleLoop();
+	void wrapPhase();
+	void adoptPendingData();
+	void setTableLength(int len);
+
+	// all these take a pointer to the first actual frame of the table [guard frames are reached through negative or >=len indices]
+	double computeSample(double *table);
 
-	double (Wavetable::*computeSample)();
-	double computeSampleInterpNone();
-	double computeSampleInterpLin();
-	double computeSampleInterpCubic();
+	// whole block in one go, tableB is optional and crossfaded in by mix
+	template<int interp>
+	void renderBlock(const double *tableA, const double *tableB, double mix, double *out, int numOfSamples);
+	void render(const double *tableA, const double *tableB, double mix, double *out, int numOfSamples);
 };
 
 inline void Wavetable::setFrequency(double freq) {
@@ -210,9 +357,24 @@ inline void Wavetable::setFrequency(double freq) {
 		return;
 	}
 
+	frequency = freq;
 	step = waveFrameNum*(freq/samplerate); // with waveFrameNum we get a more precise value than with frameNum [if we use guard frames for interpolation -> see protected init(...)]
 	// a nice explanation can be found here:
 	// https://en.wikibooks.org/wiki/Sound_Synthesis_Theory/Oscillators_and_Wavetables#Wavetables
+	phaseInc = (int64_t)llround(step*(1LL<<WAVETABLE_FRAC_BITS)); // wrapped, so steps longer than the table play as aliases like before
+	if(phaseLen > 0)
+		phaseInc %= phaseLen;
+}
+
+// table pitch is set through frequency, and guard frames depend on interpolation
+inline void Wavetable::setRate(double rate) {
+	(void)rate;
+	printf("Wavetable error! Playback rate is not used, set frequency instead\n");
+}
+
+inline void Wavetable::setInterpolation(interpType interp) {
+	(void)interp;
+	printf("Wavetable error! Interpolation can be chosen only at construction\n");
 }
 
 inline double Wavetable::getFrequency() {
@@ -225,10 +387,9 @@ inline double Wavetable::getFrequency() {
 }
 
 inline double *Wavetable::getWaveform() {
-	if(interpolation == interp_cubic_)
-		return &waveFormBuffer[1]; // skip first guard frame
-	else
-		return waveFormBuffer;
+	if(waveFormBuffer==NULL)
+		return NULL; // still loading
+	return waveFormBuffer+tableOffset; // skip first guard frame, if any
 }
 
 inline int Wavetable::getWaveform(double *&buff) {
@@ -237,7 +398,7 @@ inline int Wavetable::getWaveform(double *&buff) {
 }
 
 inline int Wavetable::getCurrentFramePos() {
-	return int(currentPos);
+	return int(phase>>WAVETABLE_FRAC_BITS);
 }
 
 inline int Wavetable::getWaveformLen() {
@@ -248,40 +409,110 @@ inline int Wavetable::init(std::string filename, unsigned int rate, unsigned int
 	return AudioFile::init(filename, rate, periodSize, level, chnIndex, outChannels, outChnOffset);
 }
 
-inline void Wavetable::advanceSampleLoop() {
-	currentPos+=step;
-	if(currentPos >= frameNum)
-		currentPos = currentPos-frameNum; // pac-man effect
+inline int Wavetable::getGuardFramesNum() {
+	if(interpolation == interp_lin_)
+		return 1; // one at the end
+	else if(interpolation == interp_cubic_ || interpolation == interp_hermite_)
+		return 3; // one at the beginning, two at the end
+	return 0;
 }
 
-inline double Wavetable::getSample() {
-	double sample = (this->*computeSample) (); // inline
-	(this->*advanceSample) (); // inline
+inline int Wavetable::getGuardFramesBefore() {
+	return (interpolation == interp_cubic_ || interpolation == interp_hermite_) ? 1 : 0;
+}
 
-	return sample*level*isPlaying;
+inline void Wavetable::wrapPhase() {
+	if(phaseMask >= 0)
+		phase &= phaseMask;
+	else if(phase >= phaseLen) // guard frames are not part of the period!
+		phase -= phaseLen; // pac-man effect
+	else if(phase < 0)
+		phase += phaseLen; // negative frequencies
 }
 
-inline double Wavetable::computeSampleInterpNone() {
-	return waveFormBuffer[int(currentPos)];
+inline void Wavetable::advanceSampleLoop() {
+	phase += phaseInc;
+	wrapPhase();
 }
 
-inline double Wavetable::computeSampleInterpLin() {
-	return ( waveFormBuffer[int(currentPos)] + waveFormBuffer[int(currentPos+0.5)] )/2.0;
+inline double Wavetable::getSample() {
+	if(swapPending.load(std::memory_order_acquire))
+		adoptPendingData();
+	if(waveFormBuffer==NULL)
+		return 0; // placeholder, still loading
+
+	double sample = computeSample(waveFormBuffer+tableOffset);
+	advanceSampleLoop();
+
+	return sample*level*isPlaying;
 }
 
-// taken from the source code of awesome Pure Data!
-// https://sourceforge.net/p/pure-data/pure-data/ci/master/tree/src/d_array.c#l593
-inline double Wavetable::computeSampleInterpCubic() {
-	double a =  waveFormBuffer[int(currentPos)-1];
-	double b =  waveFormBuffer[int(currentPos)];
-	double c =  waveFormBuffer[int(currentPos)+1];
-	double d =  waveFormBuffer[int(currentPos)+2];
+inline double Wavetable::computeSample(double *table) {
+	switch(interpolation) {
+		case interp_lin_:
+			return interpolate<interp_lin_>(table, phase);
+		case interp_cubic_:
+			return interpolate<interp_cubic_>(table, phase);
+		case interp_hermite_:
+			return interpolate<interp_hermite_>(table, phase);
+		default:
+			return interpolate<interp_no_>(table, phase);
+	}
+}
 
-	double frac = currentPos-int(currentPos);
+// with power of 2 tables each phase is computed independently of the previous ones, so 4 samples at a time can be unrolled and vectorized
+template<int interp>
+inline void Wavetable::renderBlock(const double *tableA, const double *tableB, double mix, double *out, int numOfSamples) {
+	double gain = level*isPlaying;
+	int n = 0;
+
+	if(phaseMask >= 0) {
+		int64_t inc4 = 4*phaseInc;
+		for(; n+4<=numOfSamples; n+=4) {
+			int64_t pos[4];
+			for(int j=0; j<4; j++)
+				pos[j] = (phase + j*phaseInc) & phaseMask;
+
+			if(tableB == NULL) {
+				for(int j=0; j<4; j++)
+					out[n+j] = interpolate<interp>(tableA, pos[j])*gain;
+			}
+			else {
+				for(int j=0; j<4; j++) {
+					double a = interpolate<interp>(tableA, pos[j]);
+					double b = interpolate<interp>(tableB, pos[j]);
+					out[n+j] = (a + mix*(b-a))*gain;
+				}
+			}
+			phase = (phase + inc4) & phaseMask;
+		}
+	}
 
-	double cminusb = c-b;
+	// leftovers, or any table length
+	for(; n<numOfSamples; n++) {
+		double a = interpolate<interp>(tableA, phase);
+		if(tableB != NULL)
+			a += mix*(interpolate<interp>(tableB, phase)-a);
+		out[n] = a*gain;
+		advanceSampleLoop();
+	}
+}
 
-	return b + frac * ( cminusb - 0.1666667f * (1.-frac) * ( (d - a - 3.0f * cminusb) * frac + (d + 2.0f*a - 3.0f*b) ) );
+inline void Wavetable::render(const double *tableA, const double *tableB, double mix, double *out, int numOfSamples) {
+	switch(interpolation) {
+		case interp_lin_:
+			renderBlock<interp_lin_>(tableA, tableB, mix, out, numOfSamples);
+			break;
+		case interp_cubic_:
+			renderBlock<interp_cubic_>(tableA, tableB, mix, out, numOfSamples);
+			break;
+		case interp_hermite_:
+			renderBlock<interp_hermite_>(tableA, tableB, mix, out, numOfSamples);
+			break;
+		default:
+			renderBlock<interp_no_>(tableA, tableB, mix, out, numOfSamples);
+			break;
+	}
 }
 //----------------------------------------------------------------------------------
 
@@ -295,22 +526,76 @@ inline double Wavetable::computeSampleInterpCubic() {
 // WavetableOsc, child of Waveform
 //----------------------------------------------------------------------------------
 
+// band-limited, one table per octave [mip-mapping], so that square, saw and co. do not alias when played at high frequencies
+// tables are computed via FFT and are shared among all the oscillators of the same type, length and interpolation
 class WavetableOsc : public Wavetable {
 public:
 	WavetableOsc();
 	WavetableOsc(interpType interp);
+	~WavetableOsc();
 	void init(oscillator_type type, unsigned int rate, unsigned int periodSize, double level=1,
 			  unsigned int numOfSamples=1024, unsigned short outChannels=1, unsigned short outChnOffset=0);
+	void setFrequency(double freq);
+	double getSample();
+	double **getFrameBuffer(int numOfSamples);
 
 protected:
+	double **mipTables; // table i keeps only the first (len/2)/2^i harmonics, so it is alias-free as long as step <= 2^i
+	int mipNum;
+	int mipLow;         // the two nearest tables for the current frequency...
+	int mipHigh;
+	double mipFrac;     // ...and how much of the second one we mix in
+	bool ownMipTables;  // not cached, e.g., noise
+
 	void init(double *samples, int len, unsigned int rate, unsigned int periodSize, double level=1,
 			  unsigned short outChannels=1, unsigned short outChnOffset=0); // shadows to remove
 	int init(std::string filename, unsigned int rate, unsigned int periodSize, double level=1,
 			 int chnIndex=-1, unsigned short outChannels=1, unsigned short outChnOffset=0); // shadows to remove
+	int initAsync(std::string filename, int rate, unsigned int periodSize, double level=1, int chnIndex=-1,
+				  unsigned short outChannels=1, unsigned short outChnOffset=0); // shadows to remove
+	int swapData(SamplePtr data); // tables are computed, not loaded
+
+	void computeMipTables(double *samples, int len);
+	void deleteMipTables();
+	void selectMipTables();
 };
 
+inline double WavetableOsc::getSample() {
+	double *tableLow  = mipTables[mipLow]+tableOffset;
+	double *tableHigh = mipTables[mipHigh]+tableOffset;
 
+	double low  = computeSample(tableLow); // inline
+	double high = computeSample(tableHigh); // inline
+	advanceSampleLoop(); // inline
 
+	return (low + mipFrac*(high-low))*level*isPlaying;
+}
+
+inline void WavetableOsc::setFrequency(double freq) {
+	Wavetable::setFrequency(freq);
+	if(mipTables!=NULL)
+		selectMipTables();
+}
+
+// picks the two tables to crossfade, once per frequency change
+inline void WavetableOsc::selectMipTables() {
+	// table i is alias-free up to step = 2^i, so reading between tables floor(log2(step))+1 and the next one is always safe
+	double octave = log2(fabs(step)) + 1;
+
+	if(octave <= 0) {
+		mipLow  = 0;
+		mipFrac = 0;
+	}
+	else if(octave >= mipNum-1) {
+		mipLow  = mipNum-1;
+		mipFrac = 0;
+	}
+	else {
+		mipLow  = int(octave);
+		mipFrac = octave-mipLow;
+	}
+	mipHigh = (mipLow+1 < mipNum) ? mipLow+1 : mipLow;
+}
 
 
 